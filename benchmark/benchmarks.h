@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/// Runs f a number of times after one warm-up run and prints the best and average times in milliseconds
+template<typename F>
+void measure(const std::string& name, int iterations, F f)
+{
+	using clock = std::chrono::steady_clock;
+
+	f();
+
+	double best = 1e30;
+	double total = 0.;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto begin = clock::now();
+		f();
+		auto end = clock::now();
+
+		auto ms = std::chrono::duration<double, std::milli>(end - begin).count();
+		best = ms < best ? ms : best;
+		total += ms;
+	}
+
+	std::cout << name << " : best " << best << "ms, average " << total / iterations << "ms" << std::endl;
+}
+
+/// Culls a million random spheres against a frustum
+void cull_benchmark();
+
+/// Builds, refits and queries a BVH over a million random boxes
+void bvh_benchmark();
+
+/**
+ * Computes the world bounds of a million objects stored in a vector<object> and in a scene_store.
+ * Run them on their own to compare the cache misses, e.g. perf stat -e cache-references,cache-misses benchmark layout_objects
+ */
+void layout_objects_benchmark();
+void layout_store_benchmark();
+
+/// Updates the world matrices of a million node hierarchy when 1% and all of it moves
+void transform_benchmark();
+
+/// Computes the model view projection and normal matrices of 10K, 100K and 1M objects with scalar glm and with the batched kernel
+void matrix_benchmark();
+
+/// Writes 1700x1700 frames to PNG and YUV files on the capture thread pool and prints the frames per second
+void capture_benchmark();
+
+/// Generates scenes of a million objects with every distribution and animates their animated tenth
+void generate_benchmark();
+
+/// Prepares 64 meshes on the mesh streamer workers and takes them within the default upload budget
+void stream_benchmark();
+
+/// Gets a million cached descriptor sets and allocates a million transient ones on a headless device, and prints the pool count and the reuse rate
+void descriptor_benchmark();
\ No newline at end of file
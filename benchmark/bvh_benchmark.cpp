@@ -0,0 +1,67 @@
+#include "benchmarks.h"
+#include <bvh.h>
+#include <glm/gtx/transform.hpp>
+#include <random>
+
+using namespace std;
+
+void bvh_benchmark()
+{
+	const size_t count = 1000000;
+
+	mt19937 generator(42);
+	uniform_real_distribution<float> position(-500.f, 500.f);
+	uniform_real_distribution<float> extent(0.5f, 5.f);
+
+	vector<aabb> bounds(count);
+	for (auto& b : bounds)
+	{
+		glm::vec3 center(position(generator), position(generator), position(generator));
+		glm::vec3 half(extent(generator), extent(generator), extent(generator));
+		b = aabb{ center - half, center + half };
+	}
+
+	bvh tree;
+	measure("bvh build 1M boxes", 5, [&] { tree.build(bounds); });
+	cout << "nodes : " << size(tree.nodes()) << ", cost : " << tree.cost() << endl;
+
+	// 1% of the boxes move every frame
+	uniform_int_distribution<uint32_t> index(0, uint32_t(count - 1));
+	uniform_real_distribution<float> offset(-2.f, 2.f);
+	vector<uint32_t> moving(count / 100);
+	for (auto& m : moving)
+		m = index(generator);
+
+	measure("bvh refit 10K moving boxes", 50, [&]
+	{
+		for (auto m : moving)
+		{
+			glm::vec3 delta(offset(generator), offset(generator), offset(generator));
+			tree.update(m, aabb{ bounds[m].min + delta, bounds[m].max + delta });
+		}
+	});
+	cout << "degradation : " << tree.degradation() << endl;
+
+	auto projection = glm::perspective<float>(glm::radians<float>(70), 1.f, 0.1f, 1000.f);
+	auto view = glm::lookAt(glm::vec3(15, 15, 15), glm::vec3(), glm::vec3(0, 1, 0));
+	auto f = extract_frustum(projection * view);
+
+	vector<uint32_t> visible;
+	measure("bvh cull 1M boxes", 50, [&] { visible.clear(); tree.cull(f, visible); });
+	cout << "visible : " << size(visible) << " / " << count << endl;
+
+	const int ray_count = 100000;
+	uniform_real_distribution<float> direction(-1.f, 1.f);
+	vector<glm::vec3> directions(ray_count);
+	for (auto& d : directions)
+		d = glm::normalize(glm::vec3(direction(generator), direction(generator), direction(generator)));
+
+	int hits = 0;
+	measure("bvh 100K raycasts", 5, [&]
+	{
+		hits = 0;
+		for (auto& d : directions)
+			hits += tree.raycast(glm::vec3(), d).object != bvh::invalid;
+	});
+	cout << "hits : " << hits << " / " << ray_count << endl;
+}
\ No newline at end of file
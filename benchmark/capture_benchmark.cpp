@@ -0,0 +1,57 @@
+#include "benchmarks.h"
+#include <frame_capture.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+void capture_benchmark()
+{
+	using clock = chrono::steady_clock;
+
+	const uint32_t width = 1700;
+	const uint32_t height = 1700;
+	const int frames = 60;
+
+	mt19937 generator(42);
+	vector<uint8_t> image(size_t(width) * height * 4);
+	for (auto& b : image)
+		b = uint8_t(generator());
+
+	for (auto format : { capture_format::png, capture_format::yuv })
+	{
+		auto name = string(format == capture_format::png ? "png" : "yuv");
+		double add_ms = 0.;
+		size_t written;
+		double fps;
+		{
+			frame_capture capture("capture_benchmark", format, 8, true);
+			for (int i = 0; i < frames; i++)
+			{
+				frame_pixels pixels;
+				pixels.width = width;
+				pixels.height = height;
+				pixels.frame = i;
+				pixels.data = data(image);
+
+				auto begin = clock::now();
+				capture.add(pixels);
+				add_ms += chrono::duration<double, milli>(clock::now() - begin).count();
+			}
+			capture.finish();
+			written = capture.written();
+			fps = capture.frames_per_second();
+		}
+
+		// The time spent in add is what the render thread pays, it includes waiting for a free buffer
+		cout << "capture " << name << " 1700x1700 : " << fps << " FPS, " << add_ms / frames << "ms per add on the render thread" << endl;
+
+		for (size_t i = 0; i < written; i++)
+		{
+			char path[64];
+			snprintf(path, sizeof(path), "capture_benchmark_%06zu.%s", i, name.c_str());
+			remove(path);
+		}
+	}
+}
\ No newline at end of file
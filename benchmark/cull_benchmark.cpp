@@ -0,0 +1,29 @@
+#include "benchmarks.h"
+#include <culling.h>
+#include <glm/gtx/transform.hpp>
+#include <random>
+
+using namespace std;
+
+void cull_benchmark()
+{
+	const size_t count = 1000000;
+
+	culler c;
+	c.resize(count);
+
+	mt19937 generator(42);
+	uniform_real_distribution<float> position(-500.f, 500.f);
+	uniform_real_distribution<float> radius(0.5f, 5.f);
+
+	for (size_t i = 0; i < count; i++)
+		c.set(i, sphere{ glm::vec3(position(generator), position(generator), position(generator)), radius(generator) });
+
+	auto projection = glm::perspective<float>(glm::radians<float>(70), 1.f, 0.1f, 1000.f);
+	auto view = glm::lookAt(glm::vec3(15, 15, 15), glm::vec3(), glm::vec3(0, 1, 0));
+	auto f = extract_frustum(projection * view);
+
+	measure("cull 1M spheres", 50, [&] { c.cull(f); });
+
+	cout << "visible : " << size(c.visible()) << " / " << count << endl;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "benchmarks.h"
+#include <vulkan/vulkan_descriptor_allocator.h>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+void descriptor_benchmark()
+{
+	const uint32_t set_count = 1000000;
+	const uint32_t distinct_sets = 1024;
+	const uint32_t sets_per_frame = 1000;
+	const uint32_t slot_count = 3;
+
+	vulkan::env e(64, 64, slot_count, false);
+
+	vk::DescriptorSetLayoutBinding binding;
+	binding.binding = 0;
+	binding.descriptorType = vk::DescriptorType::eUniformBuffer;
+	binding.descriptorCount = 1;
+	binding.stageFlags = vk::ShaderStageFlagBits::eAllGraphics;
+
+	vk::DescriptorSetLayoutCreateInfo layout_create_info;
+	layout_create_info.bindingCount = 1;
+	layout_create_info.pBindings = &binding;
+
+	vk::DescriptorSetLayout layout;
+	if (e.device.createDescriptorSetLayout(&layout_create_info, nullptr, &layout) != vk::Result::eSuccess)
+		throw runtime_error("Failed to create descriptor set layout");
+
+	// The cached sets differ by the offset of their range in one uniform buffer
+	auto range = max<vk::DeviceSize>(256, e.physical_device.getProperties().limits.minUniformBufferOffsetAlignment);
+	vk::Buffer buffer;
+	vk::DeviceMemory memory;
+	e.create_buffer(size_t(range * distinct_sets), buffer, memory, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible);
+
+	{
+		vulkan::vulkan_descriptor_allocator allocator(e, slot_count);
+		measure("get 1M cached sets of " + to_string(distinct_sets) + " bindings", 3, [&]
+		{
+			for (uint32_t i = 0; i < set_count; i++)
+			{
+				vulkan::descriptor_buffer_binding b{ 0, vk::DescriptorType::eUniformBuffer, buffer, range * (i % distinct_sets), range };
+				allocator.get(layout, &b, 1);
+			}
+		});
+		cout << "cached : " << allocator.stats().pool_count << " pools, reuse rate " << allocator.stats().reuse_rate() << endl;
+	}
+
+	{
+		// Frames of transient sets in turn in the slots, as a renderer resets the slot of an image once its fence is signaled
+		vulkan::vulkan_descriptor_allocator allocator(e, slot_count);
+		measure("allocate 1M transient sets in frames of " + to_string(sets_per_frame), 3, [&]
+		{
+			for (uint32_t frame = 0; frame < set_count / sets_per_frame; frame++)
+			{
+				auto slot = frame % slot_count;
+				allocator.reset(slot);
+				for (uint32_t i = 0; i < sets_per_frame; i++)
+					allocator.allocate_transient(slot, layout);
+			}
+		});
+		cout << "transient : " << allocator.stats().pool_count << " pools, reuse rate " << allocator.stats().reuse_rate() << endl;
+	}
+
+	e.device.destroyBuffer(buffer);
+	e.device.freeMemory(memory);
+	e.device.destroyDescriptorSetLayout(layout);
+}
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "benchmarks.h"
+#include <scene_generator.h>
+
+using namespace std;
+
+void generate_benchmark()
+{
+	for (auto distribution : { spatial_distribution::grid, spatial_distribution::uniform, spatial_distribution::clusters })
+	{
+		scene_parameters params;
+		params.count = 1000000;
+		params.distribution = distribution;
+		params.extent = 300.f;
+		params.mesh_count = 6;
+		params.material_count = 64;
+		params.animated_fraction = 0.1f;
+
+		auto name = string(distribution == spatial_distribution::grid ? "grid" : distribution == spatial_distribution::uniform ? "uniform" : "clusters");
+		scene_generator generator(params);
+		unique_ptr<scene> sc;
+		measure("generate 1M objects " + name, 3, [&] { sc = generator.generate(); });
+		measure("animate 100K objects " + name, 10, [&] { generator.animate(*sc, 1.f / 60.f); });
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#include "benchmarks.h"
+#include <culling.h>
+#include <glm/gtx/transform.hpp>
+#include <random>
+
+using namespace std;
+
+static const size_t object_count = 1000000;
+
+/// Objects as the scene stored them before the scene_store, every one with its own shader names and model
+static vector<object> create_objects()
+{
+	mt19937 generator(42);
+	uniform_real_distribution<float> position(-500.f, 500.f);
+
+	vector<object> objects(object_count);
+	for (auto& obj : objects)
+	{
+		obj.model = make_shared<model>();
+		obj.model->bounding_sphere = sphere{ glm::vec3(), 1.f };
+		obj.model->box = aabb{ glm::vec3(-1.f), glm::vec3(1.f) };
+		obj.vertex_shader.filename = "shaders/sphere_opengl.vert";
+		obj.fragment_shader.filename = "shaders/sphere_opengl.frag";
+		obj.translate(glm::vec3(position(generator), position(generator), position(generator)));
+	}
+	return objects;
+}
+
+void layout_objects_benchmark()
+{
+	auto objects = create_objects();
+
+	culler c;
+	measure("world bounds of 1M objects in a vector<object>", 20, [&]
+	{
+		c.resize(size(objects));
+		for (size_t i = 0; i < size(objects); i++)
+			c.set(i, transform_sphere(objects[i].model->bounding_sphere, objects[i].trans));
+	});
+}
+
+void layout_store_benchmark()
+{
+	scene_store store;
+	for (auto& obj : create_objects())
+		store.add(obj);
+
+	culler c;
+	measure("world bounds of 1M objects in a scene_store", 20, [&] { c.update(store); });
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#include "benchmarks.h"
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+static const map<string, void(*)()> benchmarks =
+{
+	{ "cull", cull_benchmark },
+	{ "bvh", bvh_benchmark },
+	{ "layout_objects", layout_objects_benchmark },
+	{ "layout_store", layout_store_benchmark },
+	{ "transform", transform_benchmark },
+	{ "matrix", matrix_benchmark },
+	{ "capture", capture_benchmark },
+	{ "generate", generate_benchmark },
+	{ "stream", stream_benchmark },
+	{ "descriptor", descriptor_benchmark },
+};
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		for (auto& b : benchmarks)
+			b.second();
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		auto it = benchmarks.find(argv[i]);
+		if (it == end(benchmarks))
+			throw runtime_error("Unknown benchmark " + string(argv[i]));
+		it->second();
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "benchmarks.h"
+#include <matrix_batch.h>
+#include <aligned_allocator.h>
+#include <glm/gtx/transform.hpp>
+#include <random>
+
+using namespace std;
+
+void matrix_benchmark()
+{
+	mt19937 generator(42);
+	uniform_real_distribution<float> position(-500.f, 500.f);
+	uniform_real_distribution<float> angle(0.f, 6.28f);
+
+	auto projection = glm::perspective<float>(glm::radians<float>(70), 1.f, 0.1f, 1000.f);
+	auto view = glm::lookAt(glm::vec3(15, 15, 15), glm::vec3(), glm::vec3(0, 1, 0));
+	auto view_projection = projection * view;
+
+	for (size_t count : { 10000, 100000, 1000000 })
+	{
+		aligned_vector<glm::mat4> models(count);
+		vector<uint32_t> indices(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			models[i] = glm::translate(glm::vec3(position(generator), position(generator), position(generator))) * glm::rotate(angle(generator), glm::vec3(0, 1, 0));
+			indices[i] = uint32_t(i);
+		}
+
+		aligned_vector<object_uniforms> uniforms(count);
+		auto name = to_string(count) + " matrices";
+
+		measure("scalar glm " + name, 10, [&]
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				auto& model = models[indices[i]];
+				uniforms[i].model = model;
+				uniforms[i].model_view_projection = view_projection * model;
+				uniforms[i].normal = glm::transpose(glm::inverse(model));
+			}
+		});
+
+		measure("batched " + name, 10, [&] { write_object_transforms(view_projection, data(models), data(indices), count, data(uniforms), sizeof(object_uniforms)); });
+	}
+}
\ No newline at end of file
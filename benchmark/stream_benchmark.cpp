@@ -0,0 +1,32 @@
+#include "benchmarks.h"
+#include <mesh_streamer.h>
+
+using namespace std;
+
+void stream_benchmark()
+{
+	auto mesh = make_shared<model>(create_sphere(128, 256));
+	const uint32_t count = 64;
+
+	size_t bytes = 0;
+	size_t frames = 0;
+	measure("stream 64 meshes of " + to_string(size(mesh->indices) / 3) + " triangles", 3, [&]
+	{
+		mesh_streamer streamer;
+		for (uint32_t i = 0; i < count; i++)
+			streamer.request(resource_handle{ i, 0 }, mesh);
+
+		// Takes the meshes as a renderer would with the default budget, counting the frames that upload something
+		vector<streamed_mesh> ready;
+		bytes = 0;
+		frames = 0;
+		while (streamer.pending())
+		{
+			auto taken = streamer.take(default_upload_budget, ready);
+			ready.clear();
+			bytes += taken;
+			frames += taken ? 1 : 0;
+		}
+	});
+	cout << "streamed " << bytes / (1 << 20) << "MB in " << frames << " uploading frames" << endl;
+}
\ No newline at end of file
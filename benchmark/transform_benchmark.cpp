@@ -0,0 +1,53 @@
+#include "benchmarks.h"
+#include <transform_hierarchy.h>
+#include <random>
+
+using namespace std;
+
+void transform_benchmark()
+{
+	// 100 roots with 100 children with 100 children each
+	transform_hierarchy hierarchy;
+	vector<uint32_t> nodes;
+	for (int i = 0; i < 100; i++)
+	{
+		auto root = hierarchy.create();
+		nodes.push_back(root);
+		for (int j = 0; j < 100; j++)
+		{
+			auto child = hierarchy.create(root);
+			nodes.push_back(child);
+			for (int k = 0; k < 100; k++)
+				nodes.push_back(hierarchy.create(child));
+		}
+	}
+	hierarchy.update();
+
+	mt19937 generator(42);
+	uniform_int_distribution<size_t> index(0, size(nodes) - 1);
+	uniform_real_distribution<float> offset(-1.f, 1.f);
+
+	// 1% of the nodes move every frame
+	vector<uint32_t> moving(size(nodes) / 100);
+	for (auto& m : moving)
+		m = nodes[index(generator)];
+
+	measure("transform update of 1% of 1M nodes", 50, [&]
+	{
+		for (auto m : moving)
+			hierarchy.translate(m, glm::vec3(offset(generator), offset(generator), offset(generator)));
+		hierarchy.update();
+	});
+	cout << "updated : " << size(hierarchy.updated()) << endl;
+
+	measure("transform update of all 1M nodes", 10, [&]
+	{
+		for (uint32_t root = 0; root < hierarchy.capacity(); root++)
+		{
+			if (hierarchy.parent(root) == transform_hierarchy::invalid)
+				hierarchy.translate(root, glm::vec3(offset(generator), offset(generator), offset(generator)));
+		}
+		hierarchy.update();
+	});
+	cout << "updated : " << size(hierarchy.updated()) << endl;
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <xmmintrin.h>
+
+/**
+ * Allocator returning memory aligned on Alignment bytes, so the arrays can be read with aligned SIMD loads
+ */
+template<typename T, size_t Alignment = 64>
+struct aligned_allocator
+{
+	using value_type = T;
+
+	template<typename U>
+	struct rebind
+	{
+		using other = aligned_allocator<U, Alignment>;
+	};
+
+	aligned_allocator() = default;
+
+	template<typename U>
+	aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+	T* allocate(size_t n)
+	{
+		auto* p = _mm_malloc(n * sizeof(T), Alignment);
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		_mm_free(p);
+	}
+
+	template<typename U>
+	bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+};
+
+/// Vector whose data is aligned on Alignment bytes
+template<typename T, size_t Alignment = 64>
+using aligned_vector = std::vector<T, aligned_allocator<T, Alignment>>;
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "allocation_counter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+#ifdef COUNT_ALLOCATIONS
+
+static atomic<size_t> allocations(0);
+
+static void* counted_allocate(size_t size)
+{
+	allocations++;
+	if (auto* p = malloc(size ? size : 1))
+		return p;
+	throw bad_alloc();
+}
+
+void* operator new(size_t size)
+{
+	return counted_allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return counted_allocate(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+size_t allocation_count()
+{
+	return allocations;
+}
+
+#else
+
+size_t allocation_count()
+{
+	return 0;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Counts the calls to the global operator new when COUNT_ALLOCATIONS is defined, to check that a frame does not allocate
+ */
+
+/// Number of global operator new calls since the start of the program, always 0 without COUNT_ALLOCATIONS
+size_t allocation_count();
\ No newline at end of file
@@ -0,0 +1,352 @@
+#include "benchmark_driver.h"
+#include "profiler.h"
+#include "scene_generator.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static vector<string> parse_names(const string& value)
+{
+	vector<string> list;
+	stringstream stream(value);
+	string item;
+	while (getline(stream, item, ','))
+		list.push_back(item);
+	return list;
+}
+
+static vector<uint32_t> parse_list(const string& value)
+{
+	vector<uint32_t> list;
+	for (auto& item : parse_names(value))
+		list.push_back(uint32_t(stoul(item)));
+	return list;
+}
+
+benchmark_settings parse_benchmark_settings(int argc, char** argv, int first)
+{
+	benchmark_settings settings;
+	for (int i = first; i < argc; i++)
+	{
+		string arg = argv[i];
+		auto equal = arg.find('=');
+		if (equal == string::npos)
+			throw runtime_error("Invalid benchmark argument " + arg);
+		auto name = arg.substr(0, equal);
+		auto value = arg.substr(equal + 1);
+
+		if (name == "renderers")
+			settings.renderers = parse_names(value);
+		else if (name == "objects")
+			settings.objects = parse_list(value);
+		else if (name == "triangles")
+			settings.triangles = parse_list(value);
+		else if (name == "materials")
+			settings.materials = parse_list(value);
+		else if (name == "lights")
+			settings.lights = parse_list(value);
+		else if (name == "uniforms")
+		{
+			settings.uniforms = parse_names(value);
+			for (auto& uniforms : settings.uniforms)
+				if (uniforms != "ring" && uniforms != "subdata")
+					throw runtime_error("Invalid uniform upload " + uniforms);
+		}
+		else if (name == "present")
+		{
+			settings.present = parse_names(value);
+			for (auto& present : settings.present)
+				if (present != "immediate" && present != "mailbox" && present != "fifo" && present != "fifo_relaxed")
+					throw runtime_error("Invalid present mode " + present);
+		}
+		else if (name == "warmup")
+			settings.warm_up_frames = uint32_t(stoul(value));
+		else if (name == "frames")
+			settings.frames = uint32_t(stoul(value));
+		else if (name == "size")
+		{
+			auto x = value.find('x');
+			if (x == string::npos)
+				throw runtime_error("Invalid size " + value);
+			settings.width = uint32_t(stoul(value.substr(0, x)));
+			settings.height = uint32_t(stoul(value.substr(x + 1)));
+		}
+		else if (name == "out")
+			settings.output = value;
+		else
+			throw runtime_error("Invalid benchmark argument " + arg);
+	}
+
+	if (settings.frames == 0)
+		throw runtime_error("The benchmark needs at least one frame");
+	return settings;
+}
+
+benchmark_statistics compute_statistics(const vector<double>& samples)
+{
+	benchmark_statistics stats;
+	stats.samples = size(samples);
+	if (samples.empty())
+		return stats;
+
+	frame_times times(size(samples));
+	for (auto s : samples)
+		times.add(s);
+	stats.mean = times.mean();
+	stats.min = *min_element(begin(samples), end(samples));
+	stats.max = *max_element(begin(samples), end(samples));
+	stats.p50 = times.percentile(50);
+	stats.p95 = times.percentile(95);
+	stats.p99 = times.percentile(99);
+
+	// Consecutive frames are correlated, so the interval comes from the spread of the means of up to 10 contiguous batches,
+	// which are close to independent, with the Student t quantile of their degrees of freedom
+	static const double t_quantiles[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262 };
+	auto batch_count = min<size_t>(10, size(samples));
+	if (batch_count < 2)
+		return stats;
+
+	auto batch_size = size(samples) / batch_count;
+	vector<double> means(batch_count);
+	for (size_t b = 0; b < batch_count; b++)
+	{
+		double total = 0.;
+		for (size_t i = b * batch_size; i < (b + 1) * batch_size; i++)
+			total += samples[i];
+		means[b] = total / batch_size;
+	}
+
+	double mean = 0.;
+	for (auto m : means)
+		mean += m;
+	mean /= batch_count;
+	double variance = 0.;
+	for (auto m : means)
+		variance += (m - mean) * (m - mean);
+	variance /= batch_count - 1;
+
+	stats.ci95 = t_quantiles[batch_count - 2] * sqrt(variance / batch_count);
+	return stats;
+}
+
+unique_ptr<scene> create_benchmark_scene(const benchmark_scene& params, const string& renderer_name, float aspect)
+{
+	// Spheres of radius 1 on a cubic grid, spaced by 3
+	scene_parameters generated;
+	generated.count = params.objects;
+	generated.distribution = spatial_distribution::grid;
+	generated.extent = ceil(cbrt(float(params.objects))) * 1.5f;
+	generated.min_scale = 1.f;
+	generated.max_scale = 1.f;
+	generated.mesh_kinds = { mesh_kind::sphere };
+	generated.mesh_count = 1;
+	generated.triangles = params.triangles;
+	generated.material_count = params.materials;
+	generated.light_count = params.lights;
+	generated.renderer_name = renderer_name;
+	generated.aspect = aspect;
+	return scene_generator(generated).generate();
+}
+
+benchmark_driver::benchmark_driver(const benchmark_settings& settings)
+	: _settings(settings) {}
+
+void benchmark_driver::run(const benchmark_run& run, const function<unique_ptr<renderer>()>& create_renderer)
+{
+	auto aspect = float(_settings.width) / float(_settings.height);
+
+	for (auto objects : _settings.objects)
+	{
+		for (auto triangles : _settings.triangles)
+		{
+			for (auto materials : _settings.materials)
+			{
+				for (auto lights : _settings.lights)
+				{
+					benchmark_scene params;
+					params.objects = objects;
+					params.triangles = triangles;
+					params.materials = materials;
+					params.lights = lights;
+
+					auto sc = create_benchmark_scene(params, run.renderer, aspect);
+					auto rend = create_renderer();
+					if (run.window)
+						rend->init(run.window);
+					else
+						rend->init_headless(_settings.width, _settings.height);
+					rend->init_scene(*sc);
+
+					auto result = run_scene(*rend, *sc, run, params);
+					cout << run.renderer << " (" << run.uniforms << ", " << run.present << ") " << objects << " objects, " << result.triangles << " triangles, " << materials << " materials, " << lights << " lights : "
+						<< "CPU " << result.cpu.mean << " +- " << result.cpu.ci95 << "ms, "
+						<< "GPU " << result.gpu.mean << " +- " << result.gpu.ci95 << "ms, "
+						<< "frame " << result.frame.mean << " +- " << result.frame.ci95 << "ms, "
+						<< result.cpu_stalls << " CPU stalls";
+					if (run.window)
+						cout << ", present " << result.present_latency.mean << " +- " << result.present_latency.ci95 << "ms, interval " << result.present_interval.mean << "ms";
+					cout << endl;
+					_results.push_back(move(result));
+
+					rend->cleanup(*sc);
+				}
+			}
+		}
+	}
+}
+
+benchmark_result benchmark_driver::run_scene(renderer& rend, scene& sc, const benchmark_run& run, const benchmark_scene& params)
+{
+	using clock = chrono::steady_clock;
+	auto milliseconds = [](clock::duration d) { return chrono::duration<double, milli>(d).count(); };
+
+	vector<double> cpu, gpu, frame, present_latency, present_interval;
+	cpu.reserve(_settings.frames);
+	gpu.reserve(_settings.frames);
+	frame.reserve(_settings.frames);
+
+	// The warm-up lasts until the meshes are streamed in, the measured frames draw the full geometry
+	auto first_measured = UINT64_MAX;
+	auto last_gpu_frame = UINT64_MAX;
+	// The stall counter comes with the GPU statistics, the latest one before the measured frames is subtracted
+	uint64_t stalls = 0;
+	uint64_t stalls_before = 0;
+	uint64_t last_presents = 0;
+	for (uint64_t i = 0; size(frame) < _settings.frames; i++)
+	{
+		if (first_measured == UINT64_MAX && i >= _settings.warm_up_frames && !rend.pending_uploads())
+		{
+			first_measured = i;
+			stalls_before = stalls;
+		}
+
+		auto frame_begin = clock::now();
+		rend.render(sc);
+		auto render_end = clock::now();
+
+		// Reading the frames back paces the loop on the GPU like presenting does in a window
+		frame_pixels pixels;
+		while (rend.read_back(pixels)) {}
+		if (run.window)
+			glfwPollEvents();
+
+		// The GPU statistics arrive a few frames late and may skip frames whose queries were not ready
+		gpu_frame_stats stats;
+		if (rend.gpu_stats(stats))
+		{
+			stalls = stats.cpu_stalls;
+			if (stats.frame != last_gpu_frame && stats.frame >= first_measured)
+			{
+				gpu.push_back(stats.frame_ms);
+				last_gpu_frame = stats.frame;
+			}
+
+			// The present times are the ones of the latest frame, counted once per present
+			if (stats.presents != last_presents && i >= first_measured)
+			{
+				present_latency.push_back(stats.present_ms);
+				if (stats.present_interval_ms > 0.)
+					present_interval.push_back(stats.present_interval_ms);
+			}
+			last_presents = stats.presents;
+		}
+
+		if (i >= first_measured)
+		{
+			cpu.push_back(milliseconds(render_end - frame_begin));
+			frame.push_back(milliseconds(clock::now() - frame_begin));
+		}
+	}
+
+	benchmark_result result;
+	result.renderer = run.renderer;
+	result.uniforms = run.uniforms;
+	result.present = run.present;
+	result.scene = params;
+	result.triangles = uint32_t(size(sc.objects.meshes()[0]->indices) / 3);
+	result.cpu = compute_statistics(cpu);
+	result.gpu = compute_statistics(gpu);
+	result.frame = compute_statistics(frame);
+	result.present_latency = compute_statistics(present_latency);
+	result.present_interval = compute_statistics(present_interval);
+	result.cpu_stalls = stalls - stalls_before;
+	return result;
+}
+
+void benchmark_driver::write() const
+{
+	auto& path = _settings.output;
+	if (size(path) >= 4 && path.compare(size(path) - 4, 4, ".csv") == 0)
+		write_csv(path);
+	else
+		write_json(path);
+}
+
+void benchmark_driver::write_json(const string& path) const
+{
+	ofstream file(path);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+
+	auto write_statistics = [&](const char* name, const benchmark_statistics& s)
+	{
+		file << "\"" << name << "\":{\"samples\":" << s.samples << ",\"mean\":" << s.mean << ",\"ci95\":" << s.ci95
+			<< ",\"min\":" << s.min << ",\"p50\":" << s.p50 << ",\"p95\":" << s.p95 << ",\"p99\":" << s.p99 << ",\"max\":" << s.max << "}";
+	};
+
+	file.precision(4);
+	file << fixed;
+	file << "{\"width\":" << _settings.width << ",\"height\":" << _settings.height
+		<< ",\"warm_up_frames\":" << _settings.warm_up_frames << ",\"frames\":" << _settings.frames << ",\"results\":[\n";
+	for (size_t i = 0; i < size(_results); i++)
+	{
+		auto& r = _results[i];
+		file << "{\"renderer\":\"" << r.renderer << "\",\"uniforms\":\"" << r.uniforms << "\",\"present\":\"" << r.present << "\",\"objects\":" << r.scene.objects << ",\"triangles\":" << r.triangles
+			<< ",\"materials\":" << r.scene.materials << ",\"lights\":" << r.scene.lights << ",\"cpu_stalls\":" << r.cpu_stalls << ",";
+		write_statistics("cpu_ms", r.cpu);
+		file << ",";
+		write_statistics("gpu_ms", r.gpu);
+		file << ",";
+		write_statistics("frame_ms", r.frame);
+		file << ",";
+		write_statistics("present_ms", r.present_latency);
+		file << ",";
+		write_statistics("present_interval_ms", r.present_interval);
+		file << (i + 1 < size(_results) ? "},\n" : "}\n");
+	}
+	file << "]}\n";
+}
+
+void benchmark_driver::write_csv(const string& path) const
+{
+	ofstream file(path);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+
+	file.precision(4);
+	file << fixed;
+	file << "renderer,uniforms,present,objects,triangles,materials,lights,cpu_stalls,measure,samples,mean_ms,ci95_ms,min_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	for (auto& r : _results)
+	{
+		auto write_row = [&](const char* measure, const benchmark_statistics& s)
+		{
+			file << r.renderer << "," << r.uniforms << "," << r.present << "," << r.scene.objects << "," << r.triangles << "," << r.scene.materials << "," << r.scene.lights << "," << r.cpu_stalls << "," << measure << ","
+				<< s.samples << "," << s.mean << "," << s.ci95 << "," << s.min << "," << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.max << "\n";
+		};
+		write_row("cpu", r.cpu);
+		write_row("gpu", r.gpu);
+		write_row("frame", r.frame);
+		// The headless runs have no present rows
+		if (r.present_latency.samples)
+		{
+			write_row("present", r.present_latency);
+			write_row("present_interval", r.present_interval);
+		}
+	}
+}
\ No newline at end of file
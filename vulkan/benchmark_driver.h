@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "renderer.h"
+#include "scene.h"
+
+/// Parameters of a generated benchmark scene
+struct benchmark_scene
+{
+	uint32_t objects = 1;
+	/// Triangles of the sphere every object draws, rounded to the nearest sphere tessellation
+	uint32_t triangles = 512;
+	/// Number of distinct materials given to the objects in turn
+	uint32_t materials = 1;
+	/// Lights of the scene, the point light, then the sun, then the spot
+	uint32_t lights = 1;
+};
+
+/// Summary of the samples of one measure, in milliseconds
+struct benchmark_statistics
+{
+	size_t samples = 0;
+	double mean = 0.;
+	/// Half width of the 95% confidence interval of the mean
+	double ci95 = 0.;
+	double min = 0.;
+	double p50 = 0.;
+	double p95 = 0.;
+	double p99 = 0.;
+	double max = 0.;
+};
+
+/// Renderer of a run, with how it uploads and shows its frames
+struct benchmark_run
+{
+	std::string renderer;
+	/// How the renderer uploads the uniforms, ring or subdata
+	std::string uniforms = "ring";
+	/// Present mode the renderer was created with, headless when the frames are read back instead
+	std::string present = "headless";
+	/// Window the frames are presented to, null when headless
+	GLFWwindow* window = nullptr;
+};
+
+/// Measures of a renderer drawing a scene
+struct benchmark_result
+{
+	std::string renderer;
+	std::string uniforms;
+	std::string present;
+	benchmark_scene scene;
+	/// Triangles actually drawn per object
+	uint32_t triangles = 0;
+	/// Time spent in render on the CPU, recording and submitting
+	benchmark_statistics cpu;
+	/// Time of the frame commands measured with GPU timestamps
+	benchmark_statistics gpu;
+	/// Time from the start of a frame to the start of the next one, including the read back or the present
+	benchmark_statistics frame;
+	/// CPU time from the acquire to the return of the present, and between consecutive presents. No samples when headless
+	benchmark_statistics present_latency;
+	benchmark_statistics present_interval;
+	/// Times render waited for the GPU to release an earlier frame during the measured frames
+	uint64_t cpu_stalls = 0;
+};
+
+/// Matrix of renderers and scenes to run, with the frames of every run
+struct benchmark_settings
+{
+	std::vector<std::string> renderers = { "vulkan", "opengl" };
+	std::vector<uint32_t> objects = { 100, 1000, 10000 };
+	std::vector<uint32_t> triangles = { 512, 8192 };
+	std::vector<uint32_t> materials = { 1, 64 };
+	std::vector<uint32_t> lights = { 1, 3 };
+	/// OpenGL uniform uploads, through the persistently mapped ring or with glBufferSubData. Vulkan always uses its ring
+	std::vector<std::string> uniforms = { "ring", "subdata" };
+	/// Present modes of the Vulkan runs in a window, after the headless ones. None by default, so the matrix runs without a display
+	std::vector<std::string> present;
+	/// Frames rendered before measuring, the warm-up goes on while meshes are streamed in
+	uint32_t warm_up_frames = 60;
+	uint32_t frames = 300;
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	/// Results are written as CSV when the path ends with .csv, as JSON otherwise
+	std::string output = "benchmark.json";
+};
+
+/// Reads the name=value arguments of the benchmark, the lists are separated by commas
+benchmark_settings parse_benchmark_settings(int argc, char** argv, int first);
+
+/// Mean, percentiles and 95% confidence interval of the samples, the interval uses batch means since consecutive frames are correlated
+benchmark_statistics compute_statistics(const std::vector<double>& samples);
+
+/// Grid of generated spheres seen from one of its corners, lit by the lights of the generator
+std::unique_ptr<scene> create_benchmark_scene(const benchmark_scene& params, const std::string& renderer_name, float aspect);
+
+/**
+ * Runs every scene of the settings with the renderers of one API, all created in the current context, headless or in a window.
+ * Every run renders the warm-up frames, then measures a fixed number of frames
+ */
+class benchmark_driver
+{
+public:
+
+	explicit benchmark_driver(const benchmark_settings& settings);
+
+	/// Runs the scenes with a new renderer for each of them, created as described by the run
+	void run(const benchmark_run& run, const std::function<std::unique_ptr<renderer>()>& create_renderer);
+
+	const std::vector<benchmark_result>& results() const { return _results; }
+
+	/// Writes the results to the output of the settings
+	void write() const;
+
+private:
+
+	benchmark_result run_scene(renderer& rend, scene& sc, const benchmark_run& run, const benchmark_scene& params);
+
+	void write_json(const std::string& path) const;
+	void write_csv(const std::string& path) const;
+
+	benchmark_settings _settings;
+	std::vector<benchmark_result> _results;
+};
\ No newline at end of file
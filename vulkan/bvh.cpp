@@ -0,0 +1,490 @@
+#include "bvh.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+using namespace std;
+
+/// Number of bins evaluated per axis when looking for a split
+static const int bin_count = 16;
+/// Leaves are not split below this number of primitives
+static const uint32_t max_leaf_size = 4;
+/// Subtrees bigger than this are built on their own thread
+static const uint32_t parallel_threshold = 16384;
+/// Deeper nodes are split at the median to bound the depth of the traversal stacks
+static const int max_sah_depth = 48;
+/// Size of the traversal stacks
+static const int max_stack_size = 128;
+
+static float area(const aabb& box)
+{
+	auto d = box.max - box.min;
+	return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static aabb empty_box()
+{
+	return aabb{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+static void grow(aabb& box, const aabb& other)
+{
+	box.min = glm::min(box.min, other.min);
+	box.max = glm::max(box.max, other.max);
+}
+
+/// Cost of a node in the surface area heuristic, traversing an inner node and testing a primitive cost the same
+static float node_cost(const bvh::node& n)
+{
+	return area(n.box) * float(n.count ? n.count : 1);
+}
+
+bvh::~bvh()
+{
+	if (_rebuild.valid())
+		_rebuild.wait();
+}
+
+void bvh::build(scene_store& objects)
+{
+	auto& transforms = objects.transforms();
+	auto& boxes = objects.boxes();
+
+	vector<aabb> bounds(objects.count());
+	for (size_t i = 0; i < objects.count(); i++)
+		bounds[i] = transform_aabb(boxes[i], transforms[i]);
+
+	objects.clear_moved();
+	build(bounds);
+}
+
+void bvh::build(const vector<aabb>& bounds)
+{
+	if (_rebuild.valid())
+		_rebuild.wait();
+	_rebuild = future<unique_ptr<tree>>();
+	_pending.clear();
+
+	_bounds = bounds;
+	install(*build_tree(_bounds));
+}
+
+unique_ptr<bvh::tree> bvh::build_tree(const vector<aabb>& bounds)
+{
+	auto t = make_unique<tree>();
+	auto count = uint32_t(size(bounds));
+	if (count == 0)
+		return t;
+
+	vector<glm::vec3> centroids(count);
+	for (uint32_t i = 0; i < count; i++)
+		centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+
+	t->primitives.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+		t->primitives[i] = i;
+
+	// A binary tree with count leaves has 2 * count - 1 nodes
+	t->nodes.resize(2 * size_t(count) - 1);
+	t->parents.resize(size(t->nodes));
+	t->leaves.resize(count);
+
+	t->nodes[0].first = 0;
+	t->nodes[0].count = count;
+	t->parents[0] = invalid;
+
+	atomic<uint32_t> next(1);
+	build_node(*t, bounds, centroids, 0, next, 0);
+
+	t->nodes.resize(next);
+	t->parents.resize(next);
+	return t;
+}
+
+void bvh::build_node(tree& t, const vector<aabb>& bounds, const vector<glm::vec3>& centroids, uint32_t index, atomic<uint32_t>& next, int depth)
+{
+	auto& n = t.nodes[index];
+	auto first = n.first;
+	auto count = n.count;
+	auto* primitives = data(t.primitives) + first;
+
+	n.box = empty_box();
+	aabb centroid_box = empty_box();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		grow(n.box, bounds[primitives[i]]);
+		grow(centroid_box, aabb{ centroids[primitives[i]], centroids[primitives[i]] });
+	}
+
+	auto make_leaf = [&]
+	{
+		for (uint32_t i = 0; i < count; i++)
+			t.leaves[primitives[i]] = index;
+	};
+
+	if (count <= max_leaf_size)
+		return make_leaf();
+
+	// Binned SAH on every axis
+	int best_axis = -1;
+	int best_split = 0;
+	float best_cost = area(n.box) * float(count);
+	auto extent = centroid_box.max - centroid_box.min;
+
+	for (int axis = 0; axis < 3 && depth < max_sah_depth; axis++)
+	{
+		if (extent[axis] <= 0.f)
+			continue;
+
+		aabb bin_boxes[bin_count];
+		uint32_t bin_counts[bin_count] = {};
+		for (auto& b : bin_boxes)
+			b = empty_box();
+
+		auto scale = float(bin_count) / extent[axis];
+		for (uint32_t i = 0; i < count; i++)
+		{
+			auto b = min(bin_count - 1, int((centroids[primitives[i]][axis] - centroid_box.min[axis]) * scale));
+			bin_counts[b]++;
+			grow(bin_boxes[b], bounds[primitives[i]]);
+		}
+
+		// Sweep from the right to get the cost of every right side, then from the left
+		float right_costs[bin_count];
+		aabb right = empty_box();
+		uint32_t right_count = 0;
+		for (int b = bin_count - 1; b > 0; b--)
+		{
+			grow(right, bin_boxes[b]);
+			right_count += bin_counts[b];
+			right_costs[b] = right_count ? area(right) * float(right_count) : 0.f;
+		}
+
+		aabb left = empty_box();
+		uint32_t left_count = 0;
+		for (int b = 0; b < bin_count - 1; b++)
+		{
+			grow(left, bin_boxes[b]);
+			left_count += bin_counts[b];
+			if (left_count == 0 || left_count == count)
+				continue;
+
+			auto cost = area(n.box) + area(left) * float(left_count) + right_costs[b + 1];
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_split = b + 1;
+			}
+		}
+	}
+
+	uint32_t left_count;
+	if (best_axis >= 0)
+	{
+		auto scale = float(bin_count) / extent[best_axis];
+		auto middle = partition(primitives, primitives + count, [&](uint32_t p)
+		{
+			return min(bin_count - 1, int((centroids[p][best_axis] - centroid_box.min[best_axis]) * scale)) < best_split;
+		});
+		left_count = uint32_t(middle - primitives);
+	}
+	else if (count > 4 * max_leaf_size || depth >= max_sah_depth)
+	{
+		// Splitting does not pay off but the leaf would be too big, split at the median of the longest axis
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		left_count = count / 2;
+		nth_element(primitives, primitives + left_count, primitives + count, [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+	}
+	else
+		return make_leaf();
+
+	auto children = next.fetch_add(2);
+	t.nodes[children].first = first;
+	t.nodes[children].count = left_count;
+	t.nodes[children + 1].first = first + left_count;
+	t.nodes[children + 1].count = count - left_count;
+	t.parents[children] = index;
+	t.parents[children + 1] = index;
+
+	n.first = children;
+	n.count = 0;
+
+	// The children own disjoint ranges of primitives and nodes, so they can be built concurrently
+	static const int max_parallel_depth = int(log2(max(1u, thread::hardware_concurrency()))) + 1;
+	if (count > parallel_threshold && depth < max_parallel_depth)
+	{
+		auto left_task = async(launch::async, [&, children] { build_node(t, bounds, centroids, children, next, depth + 1); });
+		build_node(t, bounds, centroids, children + 1, next, depth + 1);
+		left_task.get();
+	}
+	else
+	{
+		build_node(t, bounds, centroids, children, next, depth + 1);
+		build_node(t, bounds, centroids, children + 1, next, depth + 1);
+	}
+}
+
+void bvh::install(tree& t)
+{
+	_nodes = move(t.nodes);
+	_primitives = move(t.primitives);
+	_parents = move(t.parents);
+	_leaves = move(t.leaves);
+
+	_cost = 0.f;
+	for (auto& n : _nodes)
+		_cost += node_cost(n);
+	_build_cost = cost();
+}
+
+float bvh::cost() const
+{
+	if (_nodes.empty())
+		return 0.f;
+	auto root = area(_nodes[0].box);
+	return root > 0.f ? _cost / root : 0.f;
+}
+
+void bvh::refit(scene_store& objects)
+{
+	// Removing an object changes the index of another one
+	if (objects.count() != size(_bounds))
+		return build(objects);
+
+	auto& transforms = objects.transforms();
+	auto& boxes = objects.boxes();
+
+	for (auto i : objects.moved())
+		update(i, transform_aabb(boxes[i], transforms[i]));
+
+	objects.clear_moved();
+}
+
+void bvh::update(uint32_t i, const aabb& box)
+{
+	_bounds[i] = box;
+	if (_rebuild.valid())
+		_pending.push_back(i);
+
+	// A node that keeps its box leaves its ancestors unchanged
+	for (auto n = _leaves[i]; n != invalid && refit_node(n); n = _parents[n]);
+}
+
+bool bvh::refit_node(uint32_t index)
+{
+	auto& n = _nodes[index];
+	auto box = empty_box();
+
+	if (n.count)
+	{
+		for (uint32_t i = 0; i < n.count; i++)
+			grow(box, _bounds[_primitives[n.first + i]]);
+	}
+	else
+	{
+		box = _nodes[n.first].box;
+		grow(box, _nodes[n.first + 1].box);
+	}
+
+	if (box.min == n.box.min && box.max == n.box.max)
+		return false;
+
+	_cost -= node_cost(n);
+	n.box = box;
+	_cost += node_cost(n);
+	return true;
+}
+
+void bvh::maintain(float max_degradation)
+{
+	if (_rebuild.valid())
+	{
+		if (_rebuild.wait_for(chrono::seconds(0)) != future_status::ready)
+			return;
+
+		auto t = _rebuild.get();
+		install(*t);
+
+		// The tree was built from the bounds at the start of the rebuild
+		auto pending = move(_pending);
+		_pending.clear();
+		for (auto i : pending)
+			for (auto n = _leaves[i]; n != invalid && refit_node(n); n = _parents[n]);
+		return;
+	}
+
+	if (degradation() > max_degradation)
+	{
+		auto bounds = _bounds;
+		_rebuild = async(launch::async, [bounds] { return build_tree(bounds); });
+	}
+}
+
+void bvh::cull(const frustum& f, vector<uint32_t>& visible) const
+{
+	if (_nodes.empty())
+		return;
+
+	auto first_visible = size(visible);
+
+	// Every entry carries the planes its node still has to be tested against
+	struct entry
+	{
+		uint32_t node;
+		uint32_t planes;
+	};
+	entry stack[max_stack_size];
+	int top = 0;
+	stack[top++] = entry{ 0, 0x3f };
+
+	// Tests a box against the planes left in the mask, clears the planes it is fully inside of
+	auto test = [&](const aabb& box, uint32_t& planes)
+	{
+		auto center = (box.min + box.max) * 0.5f;
+		auto half = (box.max - box.min) * 0.5f;
+
+		for (int p = 0; p < 6; p++)
+		{
+			if (!(planes & (1u << p)))
+				continue;
+
+			auto normal = glm::vec3(f.planes[p]);
+			auto d = glm::dot(normal, center) + f.planes[p].w;
+			auto r = glm::dot(glm::abs(normal), half);
+
+			if (d + r < 0.f)
+				return false;
+			if (d - r >= 0.f)
+				planes &= ~(1u << p);
+		}
+		return true;
+	};
+
+	while (top)
+	{
+		auto e = stack[--top];
+		auto& n = _nodes[e.node];
+
+		auto planes = e.planes;
+		if (planes && !test(n.box, planes))
+			continue;
+
+		if (n.count)
+		{
+			for (uint32_t i = 0; i < n.count; i++)
+			{
+				auto p = _primitives[n.first + i];
+				auto primitive_planes = planes;
+				if (!planes || test(_bounds[p], primitive_planes))
+					visible.push_back(p);
+			}
+			continue;
+		}
+
+		stack[top++] = entry{ n.first + 1, planes };
+		stack[top++] = entry{ n.first, planes };
+	}
+
+	sort(begin(visible) + first_visible, end(visible));
+}
+
+/// Distance along the ray where it enters the box, or FLT_MAX if it misses it
+static float intersect(const aabb& box, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+	auto t0 = (box.min - origin) * inverse_direction;
+	auto t1 = (box.max - origin) * inverse_direction;
+	auto t_min = glm::min(t0, t1);
+	auto t_max = glm::max(t0, t1);
+
+	auto enter = max(max(t_min.x, t_min.y), max(t_min.z, 0.f));
+	auto exit = min(min(t_max.x, t_max.y), min(t_max.z, max_distance));
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+bvh::hit bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance) const
+{
+	hit result{ invalid, max_distance };
+	if (_nodes.empty())
+		return result;
+
+	auto inverse_direction = 1.f / direction;
+
+	uint32_t stack[max_stack_size];
+	int top = 0;
+	if (intersect(_nodes[0].box, origin, inverse_direction, max_distance) != FLT_MAX)
+		stack[top++] = 0;
+
+	while (top)
+	{
+		auto& n = _nodes[stack[--top]];
+
+		if (n.count)
+		{
+			for (uint32_t i = 0; i < n.count; i++)
+			{
+				auto p = _primitives[n.first + i];
+				auto t = intersect(_bounds[p], origin, inverse_direction, result.distance);
+				if (t < result.distance || (t == result.distance && result.object == invalid))
+					result = hit{ p, t };
+			}
+			continue;
+		}
+
+		// The nearest child is pushed last so it is visited first and shortens the ray early
+		auto left = intersect(_nodes[n.first].box, origin, inverse_direction, result.distance);
+		auto right = intersect(_nodes[n.first + 1].box, origin, inverse_direction, result.distance);
+
+		if (left <= right)
+		{
+			if (right != FLT_MAX)
+				stack[top++] = n.first + 1;
+			if (left != FLT_MAX)
+				stack[top++] = n.first;
+		}
+		else
+		{
+			if (left != FLT_MAX)
+				stack[top++] = n.first;
+			stack[top++] = n.first + 1;
+		}
+	}
+
+	return result;
+}
+
+void bvh::query(const glm::vec3& point, vector<uint32_t>& result) const
+{
+	if (_nodes.empty())
+		return;
+
+	auto contains = [&](const aabb& box)
+	{
+		return glm::all(glm::lessThanEqual(box.min, point)) && glm::all(glm::lessThanEqual(point, box.max));
+	};
+
+	uint32_t stack[max_stack_size];
+	int top = 0;
+	stack[top++] = 0;
+
+	while (top)
+	{
+		auto& n = _nodes[stack[--top]];
+		if (!contains(n.box))
+			continue;
+
+		if (n.count)
+		{
+			for (uint32_t i = 0; i < n.count; i++)
+			{
+				auto p = _primitives[n.first + i];
+				if (contains(_bounds[p]))
+					result.push_back(p);
+			}
+			continue;
+		}
+
+		stack[top++] = n.first + 1;
+		stack[top++] = n.first;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+#include "culling.h"
+
+/**
+ * Bounding volume hierarchy over the world bounding boxes of the objects.
+ * It is built with binned SAH, refitted when objects move and rebuilt in the background when refits have degraded it too much
+ */
+class bvh
+{
+public:
+
+	/// Node of the tree, a leaf when count is not 0
+	struct node
+	{
+		aabb box;
+		/// First child for an inner node, the second one follows it. First primitive for a leaf
+		uint32_t first;
+		uint32_t count;
+	};
+
+	/// Result of a ray query
+	struct hit
+	{
+		uint32_t object;
+		float distance;
+	};
+
+	static const uint32_t invalid = UINT32_MAX;
+
+	bvh() = default;
+	~bvh();
+
+	bvh(const bvh&) = delete;
+	bvh& operator=(const bvh&) = delete;
+
+	/// Builds the tree over the world bounds of the objects and clears their moved list
+	void build(scene_store& objects);
+
+	/// Builds the tree over bounding boxes
+	void build(const std::vector<aabb>& bounds);
+
+	/// Updates the bounds of the objects that moved, clears their moved list and refits the tree
+	void refit(scene_store& objects);
+
+	/// Sets the bounds of a primitive and refits the nodes above it
+	void update(uint32_t i, const aabb& box);
+
+	/// Starts a rebuild on another thread if the refits degraded the tree, and swaps in a finished one
+	void maintain(float max_degradation = 1.5f);
+
+	/// Appends the indices of the primitives intersecting the frustum, sorted
+	void cull(const frustum& f, std::vector<uint32_t>& visible) const;
+
+	/// Closest primitive whose box is hit by the ray, or invalid
+	hit raycast(const glm::vec3& origin, const glm::vec3& direction, float max_distance = FLT_MAX) const;
+
+	/// Appends the indices of the primitives whose box contains the point
+	void query(const glm::vec3& point, std::vector<uint32_t>& result) const;
+
+	/// Surface area heuristic cost of the tree, relative to the area of the root
+	float cost() const;
+
+	/// Ratio between the current cost and the cost after the last build
+	float degradation() const { return _build_cost > 0.f ? cost() / _build_cost : 1.f; }
+
+	const std::vector<node>& nodes() const { return _nodes; }
+
+	/// Number of primitives
+	size_t count() const { return _bounds.size(); }
+
+private:
+
+	/// Tree and primitive order produced by a build
+	struct tree
+	{
+		std::vector<node> nodes;
+		std::vector<uint32_t> primitives;
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> leaves;
+	};
+
+	static std::unique_ptr<tree> build_tree(const std::vector<aabb>& bounds);
+	static void build_node(tree& t, const std::vector<aabb>& bounds, const std::vector<glm::vec3>& centroids, uint32_t index, std::atomic<uint32_t>& next, int depth);
+
+	/// Installs a built tree
+	void install(tree& t);
+
+	/// Recomputes the box of a node from its children or primitives and returns whether it changed
+	bool refit_node(uint32_t index);
+
+	std::vector<aabb> _bounds;
+	std::vector<node> _nodes;
+	/// Primitives sorted by leaf
+	std::vector<uint32_t> _primitives;
+	/// Parent of every node
+	std::vector<uint32_t> _parents;
+	/// Leaf containing every primitive
+	std::vector<uint32_t> _leaves;
+	/// Sum of the areas of the nodes weighted by their cost, kept up to date by the refits
+	float _cost = 0.f;
+	/// Cost relative to the root after the last build
+	float _build_cost = 0.f;
+	/// Primitives updated since the background rebuild started
+	std::vector<uint32_t> _pending;
+	std::future<std::unique_ptr<tree>> _rebuild;
+};
\ No newline at end of file
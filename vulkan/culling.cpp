@@ -0,0 +1,153 @@
+#include "culling.h"
+#include <algorithm>
+#include <cfloat>
+#include <immintrin.h>
+
+using namespace std;
+
+/// Number of spheres tested per iteration
+static const size_t batch_size = 8;
+
+frustum extract_frustum(const glm::mat4& view_projection)
+{
+	auto row = [&](int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+	frustum f;
+	f.planes[0] = row(3) + row(0);
+	f.planes[1] = row(3) - row(0);
+	f.planes[2] = row(3) + row(1);
+	f.planes[3] = row(3) - row(1);
+	// -w <= z is the near plane with a [-1, 1] depth range and is conservative with [0, 1]
+	f.planes[4] = row(3) + row(2);
+	f.planes[5] = row(3) - row(2);
+
+	for (auto& p : f.planes)
+		p /= glm::length(glm::vec3(p));
+
+	return f;
+}
+
+sphere transform_sphere(const sphere& s, const glm::mat4& trans)
+{
+	auto scale = max(glm::length(glm::vec3(trans[0])), max(glm::length(glm::vec3(trans[1])), glm::length(glm::vec3(trans[2]))));
+	return sphere{ glm::vec3(trans * glm::vec4(s.center, 1.f)), s.radius * scale };
+}
+
+aabb transform_aabb(const aabb& box, const glm::mat4& trans)
+{
+	auto center = glm::vec3(trans * glm::vec4((box.min + box.max) * 0.5f, 1.f));
+	auto half = (box.max - box.min) * 0.5f;
+
+	glm::vec3 extent;
+	for (int i = 0; i < 3; i++)
+		extent[i] = abs(trans[0][i]) * half.x + abs(trans[1][i]) * half.y + abs(trans[2][i]) * half.z;
+
+	return aabb{ center - extent, center + extent };
+}
+
+void culler::update(const scene_store& objects)
+{
+	auto& transforms = objects.transforms();
+	auto& spheres = objects.bounding_spheres();
+
+	resize(objects.count());
+	for (size_t i = 0; i < objects.count(); i++)
+		set(i, transform_sphere(spheres[i], transforms[i]));
+}
+
+void culler::resize(size_t count)
+{
+	auto padded = (count + batch_size - 1) / batch_size * batch_size;
+
+	_x.resize(padded, 0.f);
+	_y.resize(padded, 0.f);
+	_z.resize(padded, 0.f);
+	_radius.resize(padded);
+	fill(begin(_radius) + count, end(_radius), -FLT_MAX);
+
+	_count = count;
+}
+
+void culler::set(size_t i, const sphere& s)
+{
+	_x[i] = s.center.x;
+	_y[i] = s.center.y;
+	_z[i] = s.center.z;
+	_radius[i] = s.radius;
+}
+
+const vector<uint32_t>& culler::cull(const frustum& f)
+{
+	auto padded = size(_x);
+	_visible.resize(padded);
+	auto* visible = data(_visible);
+	uint32_t count = 0;
+
+#ifdef __AVX__
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm256_set1_ps(f.planes[p][c]);
+
+	for (size_t i = 0; i < padded; i += batch_size)
+	{
+		auto x = _mm256_load_ps(&_x[i]);
+		auto y = _mm256_load_ps(&_y[i]);
+		auto z = _mm256_load_ps(&_z[i]);
+		auto r = _mm256_load_ps(&_radius[i]);
+
+		auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			auto d = _mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y));
+			d = _mm256_add_ps(d, _mm256_mul_ps(planes[p][2], z));
+			d = _mm256_add_ps(d, _mm256_add_ps(planes[p][3], r));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		auto mask = _mm256_movemask_ps(inside);
+		for (uint32_t b = 0; b < batch_size; b++)
+		{
+			visible[count] = uint32_t(i) + b;
+			count += (mask >> b) & 1;
+		}
+	}
+#else
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int c = 0; c < 4; c++)
+			planes[p][c] = _mm_set1_ps(f.planes[p][c]);
+
+	for (size_t i = 0; i < padded; i += batch_size)
+	{
+		int mask = 0;
+		for (size_t h = 0; h < batch_size; h += 4)
+		{
+			auto x = _mm_load_ps(&_x[i + h]);
+			auto y = _mm_load_ps(&_y[i + h]);
+			auto z = _mm_load_ps(&_z[i + h]);
+			auto r = _mm_load_ps(&_radius[i + h]);
+
+			auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; p++)
+			{
+				auto d = _mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y));
+				d = _mm_add_ps(d, _mm_mul_ps(planes[p][2], z));
+				d = _mm_add_ps(d, _mm_add_ps(planes[p][3], r));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+			}
+
+			mask |= _mm_movemask_ps(inside) << h;
+		}
+
+		for (uint32_t b = 0; b < batch_size; b++)
+		{
+			visible[count] = uint32_t(i) + b;
+			count += (mask >> b) & 1;
+		}
+	}
+#endif
+
+	_visible.resize(count);
+	return _visible;
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "aligned_allocator.h"
+#include "scene_store.h"
+
+/// Planes of a frustum, xyz is the normal pointing inside and w the distance to the origin
+struct frustum
+{
+	glm::vec4 planes[6];
+};
+
+/// Extracts the normalized planes of the frustum of a view projection matrix
+frustum extract_frustum(const glm::mat4& view_projection);
+
+/// Transforms a bounding sphere by a model matrix
+sphere transform_sphere(const sphere& s, const glm::mat4& trans);
+
+/// Transforms a bounding box by a model matrix, the result is the bounding box of the transformed box
+aabb transform_aabb(const aabb& box, const glm::mat4& trans);
+
+/**
+ * Culls objects against a frustum.
+ * The world bounding spheres are copied in a structure of arrays and tested eight at a time with SIMD
+ */
+class culler
+{
+public:
+
+	/// Copies the world bounding spheres of the objects
+	void update(const scene_store& objects);
+
+	/// Sets the number of spheres
+	void resize(size_t count);
+
+	/// Sets the world bounding sphere of an object
+	void set(size_t i, const sphere& s);
+
+	/// Tests every sphere against the frustum and returns the indices of the visible objects, sorted
+	const std::vector<uint32_t>& cull(const frustum& f);
+
+	/// Result of the last cull
+	const std::vector<uint32_t>& visible() const { return _visible; }
+
+	/// Number of spheres
+	size_t count() const { return _count; }
+
+private:
+
+	size_t _count = 0;
+	/// Sphere centers and radiuses, padded to a multiple of 8 with spheres that are never visible
+	aligned_vector<float> _x;
+	aligned_vector<float> _y;
+	aligned_vector<float> _z;
+	aligned_vector<float> _radius;
+	std::vector<uint32_t> _visible;
+};
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "frame_arena.h"
+#include <cstdint>
+
+using namespace std;
+
+frame_arena::frame_arena(size_t capacity)
+	: _block(new char[capacity]), _capacity(capacity) {}
+
+void frame_arena::reset()
+{
+	if (!_overflow.empty())
+	{
+		// Room for the whole previous frame
+		auto capacity = _capacity;
+		while (capacity < used())
+			capacity *= 2;
+
+		_overflow.clear();
+		_overflow_size = 0;
+		_block.reset(new char[capacity]);
+		_capacity = capacity;
+	}
+
+	_offset = 0;
+}
+
+void* frame_arena::allocate(size_t size, size_t alignment)
+{
+	auto base = reinterpret_cast<uintptr_t>(_block.get());
+	auto aligned = (base + _offset + alignment - 1) / alignment * alignment;
+
+	if (aligned + size <= base + _capacity)
+	{
+		_offset = aligned + size - base;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	_overflow.emplace_back(new char[size + alignment]);
+	_overflow_size += size + alignment;
+
+	auto overflow = reinterpret_cast<uintptr_t>(_overflow.back().get());
+	return reinterpret_cast<void*>((overflow + alignment - 1) / alignment * alignment);
+}
\ No newline at end of file
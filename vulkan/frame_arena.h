@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Linear allocator for the data that only lives during a frame, reset at the start of every frame.
+ * When a frame needs more than the capacity, the overflow is allocated separately and the next reset grows the block,
+ * so once the frames have the same size the arena does not allocate anymore
+ */
+class frame_arena
+{
+public:
+
+	explicit frame_arena(size_t capacity = 64 * 1024);
+
+	/// Frees everything allocated since the last reset
+	void reset();
+
+	/// Allocates uninitialized memory
+	void* allocate(size_t size, size_t alignment);
+
+	/// Allocates an uninitialized array, the destructors are never called
+	template<typename T>
+	T* allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "The arena never calls destructors");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	/// Bytes allocated since the last reset
+	size_t used() const { return _offset + _overflow_size; }
+
+	size_t capacity() const { return _capacity; }
+
+private:
+
+	std::unique_ptr<char[]> _block;
+	size_t _capacity;
+	size_t _offset = 0;
+	/// Allocations that did not fit in the block during this frame
+	std::vector<std::unique_ptr<char[]>> _overflow;
+	size_t _overflow_size = 0;
+};
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "frame_capture.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "image_writer.h"
+#include "profiler.h"
+
+using namespace std;
+
+frame_capture::frame_capture(const string& prefix, capture_format format, size_t max_pending, bool wait_when_full, size_t thread_count)
+	: _prefix(prefix), _format(format), _max_pending(max_pending), _wait_when_full(wait_when_full), _pool(thread_count) {}
+
+frame_capture::~frame_capture()
+{
+	_pool.wait();
+}
+
+bool frame_capture::add(const frame_pixels& pixels)
+{
+	auto image_size = size_t(pixels.width) * pixels.height * 4;
+	vector<uint8_t> buffer;
+	{
+		unique_lock<mutex> lock(_mutex);
+		if (_first_add == clock::time_point())
+			_first_add = clock::now();
+
+		if (_free_buffers.empty() && _buffer_count == _max_pending)
+		{
+			if (!_wait_when_full)
+			{
+				_dropped++;
+				return false;
+			}
+			_buffer_freed.wait(lock, [this] { return !_free_buffers.empty(); });
+		}
+
+		if (!_free_buffers.empty())
+		{
+			buffer = move(_free_buffers.back());
+			_free_buffers.pop_back();
+		}
+		else
+			_buffer_count++;
+	}
+
+	buffer.resize(image_size);
+	memcpy(data(buffer), pixels.data, image_size);
+
+	auto queued = pixels;
+	queued.data = nullptr;
+	// The buffer is moved into the task and handed back by encode
+	auto shared = make_shared<vector<uint8_t>>(move(buffer));
+	_pool.submit([this, shared, queued] { encode(move(*shared), queued); });
+	return true;
+}
+
+void frame_capture::encode(vector<uint8_t> buffer, frame_pixels pixels)
+{
+	PROFILE_ZONE("encode");
+
+	char number[32];
+	snprintf(number, sizeof(number), "_%06llu", static_cast<unsigned long long>(pixels.frame));
+	auto path = _prefix + number + (_format == capture_format::png ? ".png" : ".yuv");
+
+	try
+	{
+		if (_format == capture_format::png)
+			write_png(path, pixels.width, pixels.height, data(buffer), pixels.bottom_up);
+		else
+			write_yuv(path, pixels.width, pixels.height, data(buffer), pixels.bottom_up);
+	}
+	catch (const exception& e)
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (_error.empty())
+			_error = e.what();
+	}
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_free_buffers.push_back(move(buffer));
+		_last_write = clock::now();
+		_written++;
+	}
+	_buffer_freed.notify_one();
+}
+
+void frame_capture::finish()
+{
+	_pool.wait();
+
+	lock_guard<mutex> lock(_mutex);
+	if (!_error.empty())
+		throw runtime_error("Failed to capture frames : " + _error);
+}
+
+double frame_capture::frames_per_second() const
+{
+	auto seconds = chrono::duration<double>(_last_write - _first_add).count();
+	return seconds > 0. ? _written / seconds : 0.;
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "frame_pixels.h"
+#include "thread_pool.h"
+
+/// File format of the captured frames
+enum class capture_format
+{
+	png,
+	yuv
+};
+
+/**
+ * Writes read back frames to disk on a thread pool, one file per frame named <prefix>_<frame>.<format>.
+ * The render thread only copies the pixels into a free buffer of a pool; when every buffer is waiting to be written
+ * the frame is dropped, or add waits if wait_when_full is set so offline jobs keep every frame
+ */
+class frame_capture
+{
+public:
+
+	frame_capture(const std::string& prefix, capture_format format, size_t max_pending = 8, bool wait_when_full = false, size_t thread_count = 0);
+	~frame_capture();
+
+	/// Copies the pixels and queues their encoding, false if the frame was dropped
+	bool add(const frame_pixels& pixels);
+
+	/// Blocks until every queued frame is written
+	void finish();
+
+	size_t written() const { return _written; }
+	size_t dropped() const { return _dropped; }
+
+	/// Frames written per second between the first add and the last write, once finished
+	double frames_per_second() const;
+
+private:
+
+	using clock = std::chrono::steady_clock;
+
+	void encode(std::vector<uint8_t> buffer, frame_pixels pixels);
+
+	std::string _prefix;
+	capture_format _format;
+	size_t _max_pending;
+	bool _wait_when_full;
+
+	/// Buffers not used by a queued frame, reused so capturing does not allocate once they exist
+	std::vector<std::vector<uint8_t>> _free_buffers;
+	size_t _buffer_count = 0;
+	std::mutex _mutex;
+	std::condition_variable _buffer_freed;
+
+	std::atomic<size_t> _written{ 0 };
+	size_t _dropped = 0;
+	clock::time_point _first_add;
+	clock::time_point _last_write;
+	/// First error of the encoding threads, thrown by finish
+	std::string _error;
+
+	/// Destroyed first, so the workers finish before the buffers go away
+	thread_pool _pool;
+};
\ No newline at end of file
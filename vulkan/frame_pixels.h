@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+/// Pixels of a frame read back to the host, 4 bytes RGBA per pixel without padding between the rows
+struct frame_pixels
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	/// Whether the first row is the bottom of the image, as OpenGL reads it
+	bool bottom_up = false;
+	/// Number of the frame since the renderer was initialized
+	uint64_t frame = 0;
+	/// Valid until the next call to render
+	const uint8_t* data = nullptr;
+};
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "geometry_pool.h"
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+/// Capacity to grow an allocator to so that size more elements fit
+static size_t grown_capacity(const range_allocator& allocator, size_t size)
+{
+	if (allocator.largest_free() >= size)
+		return allocator.capacity();
+	return max(allocator.capacity() * 2, allocator.capacity() + size);
+}
+
+void geometry_pool::reserve_more(size_t vertex_count, size_t index_count)
+{
+	auto vertex_capacity = grown_capacity(_vertices, vertex_count);
+	auto index_capacity = grown_capacity(_indices, index_count);
+	if (vertex_capacity != _vertices.capacity() || index_capacity != _indices.capacity())
+	{
+		reserve(vertex_capacity, index_capacity);
+		_vertices.grow(vertex_capacity);
+		_indices.grow(index_capacity);
+	}
+}
+
+/// Whether size elements fit in the free elements of the allocator but in none of its free ranges
+static bool fragmented_for(const range_allocator& allocator, size_t size)
+{
+	return allocator.largest_free() < size && allocator.capacity() - allocator.used() >= size;
+}
+
+mesh_range geometry_pool::allocate(size_t vertex_count, size_t index_count)
+{
+	// Packing the holes left by the freed meshes is preferred to growing, the pool stays sized by the meshes it holds
+	if (fragmented_for(_vertices, vertex_count) || fragmented_for(_indices, index_count))
+		compact(0.f);
+	reserve_more(vertex_count, index_count);
+
+	mesh_range range;
+	range.vertex_count = uint32_t(vertex_count);
+	range.vertex_offset = uint32_t(_vertices.allocate(range.vertex_count));
+	range.index_count = uint32_t(index_count);
+	range.first_index = uint32_t(_indices.allocate(range.index_count));
+	return range;
+}
+
+void geometry_pool::free(const mesh_range& range)
+{
+	if (range.vertex_count)
+		_vertices.free(range.vertex_offset);
+	if (range.index_count)
+		_indices.free(range.first_index);
+}
+
+uint32_t geometry_pool::add(const model& m)
+{
+	auto vertices = interleave_vertices(m);
+	return add(data(vertices), size(vertices), data(m.indices), size(m.indices));
+}
+
+uint32_t geometry_pool::add(const vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count)
+{
+	auto range = allocate(vertex_count, index_count);
+	write(range, vertices, indices);
+
+	uint32_t mesh;
+	if (_free_meshes.empty())
+	{
+		mesh = uint32_t(size(_meshes));
+		_meshes.push_back(range);
+	}
+	else
+	{
+		mesh = _free_meshes.back();
+		_free_meshes.pop_back();
+		_meshes[mesh] = range;
+	}
+
+	return mesh;
+}
+
+void geometry_pool::replace(uint32_t mesh, const vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count, uint64_t frame)
+{
+	auto range = allocate(vertex_count, index_count);
+	write(range, vertices, indices);
+
+	_retired.push_back(retired_range{ _meshes[mesh], frame });
+	_meshes[mesh] = range;
+}
+
+void geometry_pool::replace(uint32_t mesh, const model& m, uint64_t frame)
+{
+	auto vertices = interleave_vertices(m);
+	replace(mesh, data(vertices), size(vertices), data(m.indices), size(m.indices), frame);
+}
+
+void geometry_pool::free_retired(uint64_t completed_frames)
+{
+	auto it = begin(_retired);
+	for (auto& r : _retired)
+	{
+		if (r.frame <= completed_frames)
+			free(r.range);
+		else
+			*it++ = r;
+	}
+	_retired.erase(it, end(_retired));
+}
+
+void geometry_pool::remove(uint32_t mesh)
+{
+	auto& range = _meshes[mesh];
+	free(range);
+	range = mesh_range{ 0, 0, 0, 0 };
+	_free_meshes.push_back(mesh);
+}
+
+bool geometry_pool::compact(float max_fragmentation)
+{
+	if (!_retired.empty() || fragmentation() <= max_fragmentation)
+		return false;
+
+	auto vertex_moves = _vertices.compact();
+	auto index_moves = _indices.compact();
+	if (vertex_moves.empty() && index_moves.empty())
+		return false;
+
+	relocate(vertex_moves, index_moves);
+
+	unordered_map<size_t, size_t> vertex_offsets, first_indices;
+	for (auto& m : vertex_moves)
+		vertex_offsets[m.from] = m.to;
+	for (auto& m : index_moves)
+		first_indices[m.from] = m.to;
+
+	for (auto& range : _meshes)
+	{
+		auto vertex_offset = vertex_offsets.find(range.vertex_offset);
+		if (range.vertex_count && vertex_offset != end(vertex_offsets))
+			range.vertex_offset = uint32_t(vertex_offset->second);
+		auto first_index = first_indices.find(range.first_index);
+		if (range.index_count && first_index != end(first_indices))
+			range.first_index = uint32_t(first_index->second);
+	}
+
+	return true;
+}
+
+float geometry_pool::fragmentation() const
+{
+	return max(_vertices.fragmentation(), _indices.fragmentation());
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "model.h"
+#include "range_allocator.h"
+
+/// Location of a mesh in a geometry pool
+struct mesh_range
+{
+	/// First vertex of the mesh, added to every index when drawing
+	uint32_t vertex_offset;
+	uint32_t vertex_count;
+	/// First index of the mesh
+	uint32_t first_index;
+	uint32_t index_count;
+};
+
+/**
+ * Packs the geometry of every mesh in one vertex buffer and one index buffer.
+ * The ranges are handed out by range allocators, the backends own the GPU buffers
+ */
+class geometry_pool
+{
+public:
+
+	virtual ~geometry_pool() = default;
+
+	/// Uploads the mesh to the pool and returns its id
+	uint32_t add(const model& m);
+
+	/// Uploads a mesh given as interleaved vertices and indices and returns its id
+	uint32_t add(const vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count);
+
+	/**
+	 * Uploads new geometry for a mesh, its id stays the same.
+	 * The old ranges may still be read by frames in flight, they are freed by free_retired once frame frames are completed
+	 */
+	void replace(uint32_t mesh, const vertex* vertices, size_t vertex_count, const uint32_t* indices, size_t index_count, uint64_t frame);
+	void replace(uint32_t mesh, const model& m, uint64_t frame);
+
+	/// Frees the replaced ranges no frame in flight reads, completed_frames is the number of frames the GPU finished
+	void free_retired(uint64_t completed_frames);
+
+	/// Releases the ranges of the mesh, its id may be reused
+	void remove(uint32_t mesh);
+
+	/// Grows the buffers so that this many more vertices and indices fit without growing again
+	void reserve_more(size_t vertex_count, size_t index_count);
+
+	/// Where the mesh is in the pool
+	const mesh_range& range(uint32_t mesh) const { return _meshes[mesh]; }
+
+	/// Packs the meshes if the fragmentation is above max_fragmentation, returns true if meshes moved.
+	/// Nothing moves while replaced ranges are waiting to be freed
+	bool compact(float max_fragmentation = 0.5f);
+
+	/// Fragmentation of the most fragmented of the vertex and index buffers (see range_allocator::fragmentation)
+	float fragmentation() const;
+
+	/// Number of vertices the pool can hold
+	size_t vertex_capacity() const { return _vertices.capacity(); }
+
+	/// Number of indices the pool can hold
+	size_t index_capacity() const { return _indices.capacity(); }
+
+protected:
+
+	/// Grows the GPU buffers to the new capacities (in elements), keeping their content
+	virtual void reserve(size_t vertex_capacity, size_t index_capacity) = 0;
+
+	/// Writes the geometry of a mesh in the GPU buffers
+	virtual void write(const mesh_range& range, const vertex* vertices, const uint32_t* indices) = 0;
+
+	/// Applies the moves (in elements) of a compaction to the GPU buffers
+	virtual void relocate(const std::vector<range_allocator::move>& vertex_moves, const std::vector<range_allocator::move>& index_moves) = 0;
+
+private:
+
+	/// Ranges replaced by replace, freed once the frames that may read them are completed
+	struct retired_range
+	{
+		mesh_range range;
+		/// Number of frames started when the range was replaced
+		uint64_t frame;
+	};
+
+	/// Allocates the ranges of a mesh, compacting or growing the buffers if needed
+	mesh_range allocate(size_t vertex_count, size_t index_count);
+
+	/// Frees the ranges of a mesh
+	void free(const mesh_range& range);
+
+	range_allocator _vertices;
+	range_allocator _indices;
+	std::vector<mesh_range> _meshes;
+	/// Ids of the removed meshes
+	std::vector<uint32_t> _free_meshes;
+	std::vector<retired_range> _retired;
+};
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+/// GPU cost of a frame measured with queries, read a few frames after it was submitted
+struct gpu_frame_stats
+{
+	/// Time from the start of the frame commands to their end
+	double frame_ms = 0.;
+	/// Time of the render pass drawing the scene
+	double pass_ms = 0.;
+	/// Primitives assembled, or generated on OpenGL
+	uint64_t primitives = 0;
+	/// Shader invocations, 0 when the device has no pipeline statistics queries
+	uint64_t vertex_invocations = 0;
+	uint64_t fragment_invocations = 0;
+	/// Number of the frame since the renderer was initialized
+	uint64_t frame = 0;
+	/// Times the CPU had to wait for the GPU to release the resources of an earlier frame, since the renderer was initialized
+	uint64_t cpu_stalls = 0;
+	/// CPU time from the start of the acquire to the return of the present of the latest presented frame, 0 when nothing is presented
+	double present_ms = 0.;
+	/// CPU time between the returns of the latest two presents
+	double present_interval_ms = 0.;
+	/// Number of frames presented and sum of their present_ms, since the renderer was initialized
+	uint64_t presents = 0;
+	double total_present_ms = 0.;
+};
\ No newline at end of file
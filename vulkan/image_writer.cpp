@@ -0,0 +1,223 @@
+#include "image_writer.h"
+#include <algorithm>
+#include <fstream>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/// Largest length of an uncompressed deflate block
+static const size_t max_stored_block = 65535;
+
+/// CRC-32 tables for slicing by 8, table k gives the CRC of a byte followed by k zero bytes
+static const uint32_t* crc_tables()
+{
+	static const auto tables = []
+	{
+		vector<uint32_t> t(8 * 256);
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			auto c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			t[n] = c;
+		}
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			for (int k = 1; k < 8; k++)
+				t[k * 256 + n] = t[(k - 1) * 256 + n] >> 8 ^ t[t[(k - 1) * 256 + n] & 0xff];
+		}
+		return t;
+	}();
+	return data(tables);
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t* bytes, size_t count)
+{
+	auto* t = crc_tables();
+	crc = ~crc;
+	for (; count >= 8; count -= 8, bytes += 8)
+	{
+		auto low = crc ^ (uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24);
+		crc = t[7 * 256 + (low & 0xff)] ^ t[6 * 256 + (low >> 8 & 0xff)] ^ t[5 * 256 + (low >> 16 & 0xff)] ^ t[4 * 256 + (low >> 24)] ^
+			t[3 * 256 + bytes[4]] ^ t[2 * 256 + bytes[5]] ^ t[256 + bytes[6]] ^ t[bytes[7]];
+	}
+	for (; count > 0; count--, bytes++)
+		crc = t[(crc ^ *bytes) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void put_u32(uint8_t* out, uint32_t v)
+{
+	out[0] = uint8_t(v >> 24);
+	out[1] = uint8_t(v >> 16);
+	out[2] = uint8_t(v >> 8);
+	out[3] = uint8_t(v);
+}
+
+/// Writes a chunk whose content is the concatenation of parts, so large data is not copied into a buffer first
+static void write_chunk(ofstream& file, const char* type, initializer_list<pair<const uint8_t*, size_t>> parts)
+{
+	size_t length = 0;
+	for (auto& p : parts)
+		length += p.second;
+
+	uint8_t header[8];
+	put_u32(header, uint32_t(length));
+	copy_n(type, 4, header + 4);
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	auto crc = crc32(0, header + 4, 4);
+	for (auto& p : parts)
+	{
+		crc = crc32(crc, p.first, p.second);
+		file.write(reinterpret_cast<const char*>(p.first), p.second);
+	}
+
+	uint8_t footer[4];
+	put_u32(footer, crc);
+	file.write(reinterpret_cast<const char*>(footer), sizeof(footer));
+}
+
+/// Row of the image at a top to bottom position
+static const uint8_t* row(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t y, bool bottom_up)
+{
+	return rgba + size_t(bottom_up ? height - 1 - y : y) * width * 4;
+}
+
+void write_png(const string& path, uint32_t width, uint32_t height, const uint8_t* rgba, bool bottom_up)
+{
+	ofstream file(path, ios::binary);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+
+	static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	uint8_t header[13];
+	put_u32(header, width);
+	put_u32(header + 4, height);
+	// 8 bits per channel, RGBA, deflate, adaptive filtering, not interlaced
+	const uint8_t format[] = { 8, 6, 0, 0, 0 };
+	copy_n(format, 5, header + 8);
+	write_chunk(file, "IHDR", { { header, sizeof(header) } });
+
+	// zlib stream of stored blocks, each block header is followed by its part of the rows.
+	// Every row starts with its filter type, 0 for none
+	auto row_size = size_t(width) * 4 + 1;
+	auto raw_size = row_size * height;
+	auto block_count = max<size_t>(1, (raw_size + max_stored_block - 1) / max_stored_block);
+	vector<uint8_t> stream(2 + raw_size + block_count * 5 + 4);
+	stream[0] = 0x78;
+	stream[1] = 0x01;
+
+	size_t position = 2;
+	size_t block_left = 0;
+	size_t raw_left = raw_size;
+	auto emit = [&](const uint8_t* bytes, size_t count)
+	{
+		while (count > 0)
+		{
+			if (block_left == 0)
+			{
+				block_left = min(max_stored_block, raw_left);
+				raw_left -= block_left;
+				stream[position++] = raw_left == 0 ? 1 : 0;
+				stream[position++] = uint8_t(block_left);
+				stream[position++] = uint8_t(block_left >> 8);
+				stream[position++] = uint8_t(~block_left);
+				stream[position++] = uint8_t(~block_left >> 8);
+			}
+			auto n = min(count, block_left);
+			copy_n(bytes, n, &stream[position]);
+			position += n;
+			bytes += n;
+			count -= n;
+			block_left -= n;
+		}
+	};
+
+	if (raw_size == 0)
+	{
+		const uint8_t empty_block[] = { 1, 0, 0, 0xff, 0xff };
+		copy_n(empty_block, 5, &stream[position]);
+		position += 5;
+	}
+
+	// Adler-32 of the rows, reduced at most every 5552 bytes so the sums can't overflow
+	uint32_t a = 1, b = 0;
+	const uint8_t filter = 0;
+	for (uint32_t y = 0; y < height; y++)
+	{
+		auto* r = row(rgba, width, height, y, bottom_up);
+		emit(&filter, 1);
+		emit(r, row_size - 1);
+
+		b = (b + a) % 65521;
+		for (size_t i = 0; i < row_size - 1; )
+		{
+			auto chunk = min<size_t>(5552, row_size - 1 - i);
+			for (size_t j = 0; j < chunk; j++)
+			{
+				a += r[i + j];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			i += chunk;
+		}
+	}
+	put_u32(&stream[position], (b << 16) | a);
+	position += 4;
+
+	write_chunk(file, "IDAT", { { data(stream), position } });
+	write_chunk(file, "IEND", {});
+
+	if (!file)
+		throw runtime_error("Failed to write " + path);
+}
+
+void write_yuv(const string& path, uint32_t width, uint32_t height, const uint8_t* rgba, bool bottom_up)
+{
+	auto chroma_width = (width + 1) / 2;
+	auto chroma_height = (height + 1) / 2;
+	vector<uint8_t> yuv(size_t(width) * height + 2 * size_t(chroma_width) * chroma_height);
+	auto* y_plane = data(yuv);
+	auto* u_plane = y_plane + size_t(width) * height;
+	auto* v_plane = u_plane + size_t(chroma_width) * chroma_height;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		auto* r = row(rgba, width, height, y, bottom_up);
+		for (uint32_t x = 0; x < width; x++, r += 4)
+			y_plane[size_t(y) * width + x] = uint8_t(((66 * r[0] + 129 * r[1] + 25 * r[2] + 128) >> 8) + 16);
+	}
+
+	// The chroma of a 2x2 block is computed from its average color
+	for (uint32_t cy = 0; cy < chroma_height; cy++)
+	{
+		auto* top = row(rgba, width, height, 2 * cy, bottom_up);
+		auto* bottom = row(rgba, width, height, min(2 * cy + 1, height - 1), bottom_up);
+		for (uint32_t cx = 0; cx < chroma_width; cx++)
+		{
+			auto x0 = 2 * cx * 4;
+			auto x1 = min(2 * cx + 1, width - 1) * 4;
+			int sum[3];
+			for (int c = 0; c < 3; c++)
+				sum[c] = top[x0 + c] + top[x1 + c] + bottom[x0 + c] + bottom[x1 + c];
+			int r = sum[0] / 4, g = sum[1] / 4, b = sum[2] / 4;
+
+			u_plane[size_t(cy) * chroma_width + cx] = uint8_t(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			v_plane[size_t(cy) * chroma_width + cx] = uint8_t(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+
+	ofstream file(path, ios::binary);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+	file.write(reinterpret_cast<const char*>(data(yuv)), size(yuv));
+	if (!file)
+		throw runtime_error("Failed to write " + path);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Writers for frames of 4 bytes RGBA per pixel, the rows are stored top to bottom whatever the order of the input
+ */
+
+/// Writes a PNG with uncompressed deflate blocks, fast to encode and without zlib dependency
+void write_png(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba, bool bottom_up);
+
+/// Writes a raw I420 frame (YUV 4:2:0 planar, BT.601), frames can be concatenated into a stream ffmpeg reads with -f rawvideo -pix_fmt yuv420p
+void write_yuv(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba, bool bottom_up);
\ No newline at end of file
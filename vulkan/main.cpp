@@ -1,11 +1,19 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include <iostream>
 #include <opengl/opengl_renderer.h>
+#include <opengl/egl_context.h>
 #include <vulkan/vulkan_renderer.h>
 #include "scene.h"
+#include "scene_file.h"
+#include "scene_generator.h"
+#include "allocation_counter.h"
+#include "benchmark_driver.h"
+#include "frame_capture.h"
+#include "profiler.h"
 #include <glm/gtx/transform.hpp>
-#include <ctime>
+#include <cctype>
+#include <chrono>
 
 using namespace std;
 
@@ -19,6 +27,139 @@ static void key_pressed(GLFWwindow* window, int key, int scancode, int action, i
 		glfwSetWindowShouldClose(window, true);
 }
 
+static vk::PresentModeKHR parse_present_mode(const string& name)
+{
+	if (name == "immediate")
+		return vk::PresentModeKHR::eImmediate;
+	if (name == "mailbox")
+		return vk::PresentModeKHR::eMailbox;
+	if (name == "fifo")
+		return vk::PresentModeKHR::eFifo;
+	if (name == "fifo_relaxed")
+		return vk::PresentModeKHR::eFifoRelaxed;
+	throw runtime_error("Invalid present mode " + name);
+}
+
+/// Window or headless context a renderer draws with
+struct context
+{
+	GLFWwindow* window = nullptr;
+	bool glfw = false;
+#ifdef USE_EGL
+	unique_ptr<opengl::egl_context> egl;
+#endif
+
+	~context()
+	{
+		if (glfw)
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+	}
+};
+
+static unique_ptr<context> create_context(const string& name, bool headless, int width, int height)
+{
+	auto ctx = make_unique<context>();
+#ifdef USE_EGL
+	ctx->glfw = !headless;
+#else
+	// Without EGL the OpenGL context comes from a hidden window
+	ctx->glfw = !headless || name == "opengl";
+#endif
+
+	if (ctx->glfw)
+	{
+		glfwInit();
+
+		if(name == "vulkan")
+			glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		else
+		{
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+			glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		}
+		glfwWindowHint(GLFW_RESIZABLE, headless ? GLFW_FALSE : GLFW_TRUE);
+		glfwWindowHint(GLFW_VISIBLE, headless ? GLFW_FALSE : GLFW_TRUE);
+
+		ctx->window = glfwCreateWindow(width, height, name.c_str(), nullptr, nullptr);
+		glfwSetKeyCallback(ctx->window, key_pressed);
+		if (name == "opengl")
+			glfwMakeContextCurrent(ctx->window);
+	}
+#ifdef USE_EGL
+	else if (name == "opengl")
+		ctx->egl = make_unique<opengl::egl_context>(4, 5);
+#endif
+
+	if (name == "opengl")
+	{
+		glewExperimental = true;
+#ifdef USE_EGL
+		// glewInit also initializes GLX, which fails without an X display, glewContextInit (glew 2.0) only loads the OpenGL functions
+		auto glew_result = ctx->egl ? glewContextInit() : glewInit();
+#else
+		auto glew_result = glewInit();
+#endif
+		if (glew_result != GLEW_OK)
+			throw runtime_error("Failed to initialize glew");
+
+		if (!glewIsSupported("GL_VERSION_4_5"))
+			throw runtime_error("Does not support OpenGL 4.5");
+	}
+
+	return ctx;
+}
+
+static unique_ptr<renderer> create_renderer(const string& name, vk::PresentModeKHR present_mode)
+{
+	if (name == "vulkan")
+		return make_unique<vulkan::vulkan_renderer>(false, present_mode);
+	if (name == "opengl")
+		return make_unique<opengl::opengl_renderer>();
+	throw runtime_error("Invalid renderer " + name);
+}
+
+/// Runs the benchmark matrix headless with every renderer and writes the results
+static int run_benchmarks(int argc, char** argv)
+{
+	auto settings = parse_benchmark_settings(argc, argv, 2);
+	benchmark_driver driver(settings);
+
+	for (auto& name : settings.renderers)
+	{
+		auto ctx = create_context(name, true, settings.width, settings.height);
+		benchmark_run run;
+		run.renderer = name;
+		if (name == "opengl")
+		{
+			for (auto& uniforms : settings.uniforms)
+			{
+				run.uniforms = uniforms;
+				driver.run(run, [&] { return make_unique<opengl::opengl_renderer>(uniforms == "ring"); });
+			}
+		}
+		else
+			driver.run(run, [&] { return create_renderer(name, vk::PresentModeKHR::eImmediate); });
+	}
+
+	// The Vulkan renderer presents to a window in each present mode, the renderer falls back to FIFO when the surface lacks the mode
+	for (auto& present : settings.present)
+	{
+		auto ctx = create_context("vulkan", false, settings.width, settings.height);
+		benchmark_run run;
+		run.renderer = "vulkan";
+		run.present = present;
+		run.window = ctx->window;
+		driver.run(run, [&] { return create_renderer("vulkan", parse_present_mode(present)); });
+	}
+
+	driver.write();
+	cout << "Results written to " << settings.output << endl;
+	return 0;
+}
+
 static unique_ptr<scene> create_scene(const string& name)
 {
 	auto sc = make_unique<scene>();
@@ -46,7 +187,7 @@ static unique_ptr<scene> create_scene(const string& name)
 
 	venus.translate(glm::vec3(0, -5, 0));
 
-	sc->objects.push_back(move(venus));
+	sc->objects.add(venus);
 
 	return sc;
 }
@@ -57,80 +198,251 @@ int main(int argc, char** argv)
 
 	if (argc >= 2)
 		name = argv[1];
+	if (name == "bench")
+		return run_benchmarks(argc, argv);
+	if (name == "compile")
+	{
+		if (argc != 4)
+			throw runtime_error("Usage : compile <text scene> <binary scene>");
+		write_scene_binary(parse_scene_text(argv[2]), argv[3]);
+		return 0;
+	}
 	if (name != "vulkan" && name != "opengl")
 		throw runtime_error("Invalid name " + string(name));
 
-	glfwInit();
-
-	if(name == "vulkan")
-		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	else
+	// Headless renders a number of frames offscreen, without window
+	auto headless = false;
+	auto headless_frames = 1000;
+	auto present_mode = vk::PresentModeKHR::eMailbox;
+	// Headless frames are written to <capture>_<frame>.<format> when capture is set
+	string capture_prefix;
+	auto format = capture_format::png;
+	// Zones of the run are written as a Chrome trace when trace is set
+	string trace_path;
+	// A scene of generated objects replaces the venus when generate is set, the same seed gives the same scene
+	uint32_t generated_count = 0;
+	uint32_t seed = 1;
+	// Scene file in the text or the binary form, which replaces the venus when set
+	string scene_path;
+	// Megabytes of streamed meshes uploaded per frame, 0 uploads every mesh before the first frame
+	auto upload_budget = double(default_upload_budget) / (1 << 20);
+	// Megabytes of streamed meshes kept resident, 0 keeps every mesh. The Vulkan renderer lowers it to the heap budget of VK_EXT_memory_budget,
+	// which the 1.0.30 SDK headers of the project do not declare, so with them the budget is this value only
+	auto memory_budget = 0.;
+	for (int i = 2; i < argc; i++)
 	{
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		string arg = argv[i];
+		if (arg == "headless")
+		{
+			headless = true;
+			if (i + 1 < argc && isdigit(argv[i + 1][0]))
+				headless_frames = stoi(argv[++i]);
+		}
+		else if (arg.compare(0, 8, "present=") == 0)
+			present_mode = parse_present_mode(arg.substr(8));
+		else if (arg.compare(0, 8, "capture=") == 0)
+			capture_prefix = arg.substr(8);
+		else if (arg.compare(0, 6, "trace=") == 0)
+			trace_path = arg.substr(6);
+		else if (arg.compare(0, 9, "generate=") == 0)
+			generated_count = uint32_t(stoul(arg.substr(9)));
+		else if (arg.compare(0, 5, "seed=") == 0)
+			seed = uint32_t(stoul(arg.substr(5)));
+		else if (arg.compare(0, 6, "scene=") == 0)
+			scene_path = arg.substr(6);
+		else if (arg.compare(0, 7, "upload=") == 0)
+			upload_budget = stod(arg.substr(7));
+		else if (arg.compare(0, 7, "memory=") == 0)
+			memory_budget = stod(arg.substr(7));
+		else if (arg == "format=png" || arg == "format=yuv")
+			format = arg == "format=png" ? capture_format::png : capture_format::yuv;
+		else
+			throw runtime_error("Invalid argument " + arg);
 	}
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-	auto* window = glfwCreateWindow(WIDTH, HEIGHT, name.c_str(), nullptr, nullptr);
-	glfwSetKeyCallback(window, key_pressed);
-	if (name == "opengl")
-	{
-		glfwMakeContextCurrent(window);
-		glewExperimental = true;
-		if (glewInit() != GLEW_OK)
-			throw runtime_error("Failed to initialize glew");
+	using clock = chrono::steady_clock;
+	// The time to the first frame includes the context, the scene loading and the initialization
+	auto startup_begin = clock::now();
 
-		if (!glewIsSupported("GL_VERSION_4_3"))
-			throw runtime_error("Does not support OpenGL 4.3");
-	}
+	auto ctx = create_context(name, headless, WIDTH, HEIGHT);
+	auto* window = ctx->window;
 
-	unique_ptr<renderer> rend;
-	if (name == "vulkan")
-		rend = make_unique<vulkan::vulkan_renderer>(false);
+	auto rend = create_renderer(name, present_mode);
+	rend->set_upload_budget(size_t(upload_budget * (1 << 20)));
+	rend->set_memory_budget(size_t(memory_budget * (1 << 20)));
+	unique_ptr<scene_generator> generator;
+	unique_ptr<scene> sc;
+	if (generated_count)
+	{
+		scene_parameters params;
+		params.seed = seed;
+		params.count = generated_count;
+		params.extent = cbrt(float(generated_count)) * 3.f;
+		params.animated_fraction = 0.1f;
+		params.renderer_name = name;
+		params.aspect = ASPECT;
+		generator = make_unique<scene_generator>(params);
+		sc = generator->generate();
+	}
+	else if (!scene_path.empty())
+	{
+		mesh_cache meshes;
+		auto load_begin = clock::now();
+		sc = load_scene(scene_path, name, ASPECT, meshes);
+		cout << "Scene load time : " << chrono::duration<double>(clock::now() - load_begin).count() << "s" << endl;
+	}
 	else
-		rend = make_unique<opengl::opengl_renderer>();
-	auto sc = create_scene(name);
+		sc = create_scene(name);
 
-	clock_t init_begin, init_end;
+	profiler::get().set_thread_name("main");
 
-	init_begin = clock();
-	rend->init(window);
+	auto init_begin = clock::now();
+	if (headless)
+		rend->init_headless(WIDTH, HEIGHT);
+	else
+		rend->init(window);
 	rend->init_scene(*sc);
-	init_end = clock();
+	auto init_end = clock::now();
+
+	cout << "Initialization time : " << chrono::duration<double>(init_end - init_begin).count() << "s" << endl;
+
+	unique_ptr<frame_capture> capture;
+	if (!capture_prefix.empty())
+		capture = make_unique<frame_capture>(capture_prefix, format);
 
-	cout << "Initialization time : " << float(init_end - init_begin) / CLOCKS_PER_SEC << "s" << endl;
+	// Frames during which the buffers reach their steady state size and may allocate
+	const int warm_up_frames = 10;
+	int frame = 0;
 
+	// Wall time between the starts of consecutive frames, printed every 5 seconds
+	frame_times times;
+	auto report_begin = clock::now();
+	auto frame_begin = report_begin;
 	int counter = 0;
-	float total = 0;
+	auto streamed_in = false;
+	auto report_memory = rend->memory_stats();
+	uint64_t report_stalls = 0;
+	uint64_t report_presents = 0;
+	double report_present_ms = 0.;
+	int window_width = WIDTH;
+	int window_height = HEIGHT;
 
-	while (!glfwWindowShouldClose(window))
+	while (headless ? frame < headless_frames : !glfwWindowShouldClose(window))
 	{
-		clock_t render_begin, render_end;
-		render_begin = clock();
-		rend->render(*sc);
-		render_end = clock();
+		{
+			PROFILE_ZONE("frame");
+
+			if (generator)
+			{
+				PROFILE_ZONE("animate");
+				generator->animate(*sc, 1.f / 60.f);
+			}
+
+			// The projection follows the aspect ratio of the window, the renderer recreates its swapchain in the frame
+			auto resized = false;
+			if (!headless)
+			{
+				int width, height;
+				glfwGetFramebufferSize(window, &width, &height);
+				if (width > 0 && height > 0 && (width != window_width || height != window_height))
+				{
+					sc->projection[0][0] *= (float(window_width) / window_height) / (float(width) / height);
+					window_width = width;
+					window_height = height;
+					resized = true;
+				}
+			}
+
+			// The frames streaming meshes in, evicting them or compacting the geometry are not steady, the workers and the uploads allocate
+			auto streaming = rend->pending_uploads() != 0;
+			auto evictions = rend->memory_stats().evictions;
+			auto compactions = rend->memory_stats().compactions;
+			auto allocations = allocation_count();
+			{
+				PROFILE_ZONE("render");
+				rend->render(*sc);
+			}
+			auto steady = !resized && !streaming && !rend->pending_uploads() && rend->memory_stats().evictions == evictions && rend->memory_stats().compactions == compactions;
+
+			if (++frame > warm_up_frames && steady && allocation_count() != allocations)
+				throw runtime_error("Steady state frame allocated " + to_string(allocation_count() - allocations) + " times");
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+			if (frame == 1)
+				cout << "Time to first frame : " << chrono::duration<double>(clock::now() - startup_begin).count() << "s" << endl;
+			if (streaming && !rend->pending_uploads() && !streamed_in)
+			{
+				cout << "Meshes streamed in after " << frame << " frames, " << chrono::duration<double>(clock::now() - startup_begin).count() << "s" << endl;
+				streamed_in = true;
+			}
 
+			if (capture)
+			{
+				PROFILE_ZONE("capture");
+				frame_pixels pixels;
+				while (rend->read_back(pixels))
+					capture->add(pixels);
+			}
+
+			if (!headless)
+			{
+				PROFILE_ZONE("swap");
+				glfwSwapBuffers(window);
+				glfwPollEvents();
+			}
+		}
+
+		auto frame_end = clock::now();
+		times.add(chrono::duration<double, milli>(frame_end - frame_begin).count());
+		frame_begin = frame_end;
 		counter++;
-		total += float(render_end - render_begin) / CLOCKS_PER_SEC;
-		if (total >= 5.f)
+
+		auto elapsed = chrono::duration<double>(frame_end - report_begin).count();
+		if (elapsed >= 5.)
 		{
-			cout << "Time : " << total << endl;
-			cout << "Counter : " << counter << endl;
-			total /= counter;
-			cout << "FPS : " << 1 / total << endl;
-			total = 0;
+			cout << "FPS : " << counter / elapsed << endl;
+			cout << "Frame time p50 : " << times.percentile(50) << "ms, p95 : " << times.percentile(95) << "ms, p99 : " << times.percentile(99) << "ms" << endl;
+			gpu_frame_stats gpu;
+			if (rend->gpu_stats(gpu))
+			{
+				cout << "GPU frame : " << gpu.frame_ms << "ms, render pass : " << gpu.pass_ms << "ms, primitives : " << gpu.primitives
+					<< ", vertex invocations : " << gpu.vertex_invocations << ", fragment invocations : " << gpu.fragment_invocations << endl;
+				cout << "CPU stalls on the GPU : " << gpu.cpu_stalls - report_stalls << " in " << counter << " frames" << endl;
+				report_stalls = gpu.cpu_stalls;
+				if (gpu.presents != report_presents)
+				{
+					cout << "Acquire to present : " << (gpu.total_present_ms - report_present_ms) / (gpu.presents - report_presents) << "ms"
+						<< ", latest present interval : " << gpu.present_interval_ms << "ms" << endl;
+					report_presents = gpu.presents;
+					report_present_ms = gpu.total_present_ms;
+				}
+			}
+
+			auto& memory = rend->memory_stats();
+			auto stream_ins = memory.stream_ins - report_memory.stream_ins;
+			cout << "Resident : " << memory.resident_meshes << "/" << memory.mesh_count << " meshes, " << double(memory.resident_bytes) / (1 << 20) << "MB"
+				<< ", evictions/s : " << (memory.evictions - report_memory.evictions) / elapsed
+				<< ", compactions : " << memory.compactions - report_memory.compactions
+				<< ", stream-in latency : " << (stream_ins ? (memory.total_latency_ms - report_memory.total_latency_ms) / stream_ins : 0.) << "ms"
+				<< ", max : " << memory.max_latency_ms << "ms" << endl;
+			report_memory = memory;
+			report_begin = frame_end;
 			counter = 0;
 		}
 	}
 
+	if (capture)
+	{
+		capture->finish();
+		cout << "Captured : " << capture->written() << " frames at " << capture->frames_per_second() << " FPS, dropped " << capture->dropped() << endl;
+	}
+
+	if (!trace_path.empty())
+		profiler::get().write_chrome_trace(trace_path);
+
 	rend->cleanup(*sc);
 
 	sc.reset();
 	rend.reset();
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	ctx.reset();
 	return 0;
 }
\ No newline at end of file
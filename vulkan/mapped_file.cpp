@@ -0,0 +1,90 @@
+#include "mapped_file.h"
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const string& path)
+{
+	auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw runtime_error("Can't open " + path);
+	_file = file;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(file, &length))
+	{
+		CloseHandle(file);
+		throw runtime_error("Can't get the size of " + path);
+	}
+	_length = size_t(length.QuadPart);
+	if (_length == 0)
+		return;
+
+	_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping)
+		_bytes = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!_bytes)
+	{
+		if (_mapping)
+			CloseHandle(_mapping);
+		CloseHandle(file);
+		throw runtime_error("Can't map " + path);
+	}
+}
+
+mapped_file::~mapped_file()
+{
+	if (_bytes)
+		UnmapViewOfFile(_bytes);
+	if (_mapping)
+		CloseHandle(_mapping);
+	CloseHandle(_file);
+}
+
+#else
+
+mapped_file::mapped_file(const string& path)
+{
+	_file = open(path.c_str(), O_RDONLY);
+	if (_file < 0)
+		throw runtime_error("Can't open " + path);
+
+	struct stat status;
+	if (fstat(_file, &status) != 0)
+	{
+		close(_file);
+		throw runtime_error("Can't get the size of " + path);
+	}
+	_length = size_t(status.st_size);
+	if (_length == 0)
+		return;
+
+	auto* bytes = mmap(nullptr, _length, PROT_READ, MAP_PRIVATE, _file, 0);
+	if (bytes == MAP_FAILED)
+	{
+		close(_file);
+		throw runtime_error("Can't map " + path);
+	}
+	_bytes = static_cast<const uint8_t*>(bytes);
+}
+
+mapped_file::~mapped_file()
+{
+	if (_bytes)
+		munmap(const_cast<uint8_t*>(_bytes), _length);
+	close(_file);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Read only view of a whole file mapped in memory, the pages are read from the disk or the file cache when they are first touched
+ */
+class mapped_file
+{
+public:
+
+	explicit mapped_file(const std::string& path);
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+	~mapped_file();
+
+	const uint8_t* bytes() const { return _bytes; }
+	size_t length() const { return _length; }
+
+private:
+
+	const uint8_t* _bytes = nullptr;
+	size_t _length = 0;
+#ifdef _WIN32
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+#else
+	int _file = -1;
+#endif
+};
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "matrix_batch.h"
+#include <glm/simd/matrix.h>
+
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+
+static void load(const glm::mat4& m, glm_vec4 columns[4])
+{
+	for (int i = 0; i < 4; i++)
+		columns[i] = _mm_loadu_ps(&m[i][0]);
+}
+
+static void store(const glm_vec4 columns[4], glm::mat4& m)
+{
+	for (int i = 0; i < 4; i++)
+		_mm_storeu_ps(&m[i][0], columns[i]);
+}
+
+void multiply_matrices(const glm::mat4& left, const glm::mat4* right, glm::mat4* out, size_t count)
+{
+	glm_vec4 l[4];
+	load(left, l);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		glm_vec4 r[4], result[4];
+		load(right[i], r);
+		glm_mat4_mul(l, r, result);
+		store(result, out[i]);
+	}
+}
+
+void inverse_transpose_matrices(const glm::mat4* in, glm::mat4* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		glm_vec4 m[4], inverse[4], result[4];
+		load(in[i], m);
+		glm_mat4_inverse(m, inverse);
+		glm_mat4_transpose(inverse, result);
+		store(result, out[i]);
+	}
+}
+
+void write_object_transforms(const glm::mat4& view_projection, const glm::mat4* models, const uint32_t* indices, size_t count, void* uniforms, size_t stride)
+{
+	glm_vec4 vp[4];
+	load(view_projection, vp);
+
+	auto* out = static_cast<char*>(uniforms);
+	for (size_t i = 0; i < count; i++, out += stride)
+	{
+		auto* object = reinterpret_cast<object_uniforms*>(out);
+
+		glm_vec4 model[4], mvp[4], inverse[4], normal[4];
+		load(models[indices[i]], model);
+		glm_mat4_mul(vp, model, mvp);
+		glm_mat4_inverse(model, inverse);
+		glm_mat4_transpose(inverse, normal);
+
+		store(model, object->model);
+		store(mvp, object->model_view_projection);
+		store(normal, object->normal);
+	}
+}
+
+#else
+
+void multiply_matrices(const glm::mat4& left, const glm::mat4* right, glm::mat4* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = left * right[i];
+}
+
+void inverse_transpose_matrices(const glm::mat4* in, glm::mat4* out, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = glm::transpose(glm::inverse(in[i]));
+}
+
+void write_object_transforms(const glm::mat4& view_projection, const glm::mat4* models, const uint32_t* indices, size_t count, void* uniforms, size_t stride)
+{
+	auto* out = static_cast<char*>(uniforms);
+	for (size_t i = 0; i < count; i++, out += stride)
+	{
+		auto* object = reinterpret_cast<object_uniforms*>(out);
+		auto& model = models[indices[i]];
+		object->model = model;
+		object->model_view_projection = view_projection * model;
+		object->normal = glm::transpose(glm::inverse(model));
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "uniforms.h"
+
+/**
+ * Matrix operations over arrays of matrices, with the SSE helpers of glm when they are available
+ */
+
+/// out[i] = left * right[i]
+void multiply_matrices(const glm::mat4& left, const glm::mat4* right, glm::mat4* out, size_t count);
+
+/// out[i] = transpose(inverse(in[i])), the matrices transforming the normals
+void inverse_transpose_matrices(const glm::mat4* in, glm::mat4* out, size_t count);
+
+/// Writes the model, model view projection and normal matrices of the objects at indices in uniforms separated by stride bytes
+void write_object_transforms(const glm::mat4& view_projection, const glm::mat4* models, const uint32_t* indices, size_t count, void* uniforms, size_t stride);
\ No newline at end of file
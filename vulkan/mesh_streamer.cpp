@@ -0,0 +1,75 @@
+#include "mesh_streamer.h"
+#include "profiler.h"
+
+using namespace std;
+
+mesh_streamer::mesh_streamer(size_t thread_count)
+	: _pool(thread_count) {}
+
+mesh_streamer::~mesh_streamer()
+{
+	_pool.wait();
+}
+
+void mesh_streamer::request(resource_handle key, shared_ptr<const model> mesh)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_pending++;
+	}
+
+	_pool.submit([this, key, mesh]
+	{
+		PROFILE_ZONE("prepare mesh");
+
+		streamed_mesh prepared;
+		prepared.key = key;
+		prepared.vertices = interleave_vertices(*mesh);
+		prepared.indices = mesh->indices;
+		weld_vertices(prepared.vertices, prepared.indices);
+		optimize_vertex_order(prepared.vertices, prepared.indices);
+
+		lock_guard<mutex> lock(_mutex);
+		_ready.push_back(move(prepared));
+	});
+}
+
+size_t mesh_streamer::take(size_t byte_budget, vector<streamed_mesh>& ready)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	size_t taken = 0;
+	while (!_ready.empty())
+	{
+		auto bytes = _ready.front().byte_size();
+		if (taken && taken + bytes > byte_budget)
+			break;
+
+		ready.push_back(move(_ready.front()));
+		_ready.pop_front();
+		_pending--;
+		taken += bytes;
+	}
+
+	return taken;
+}
+
+size_t mesh_streamer::pending() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _pending;
+}
+
+void mesh_streamer::wait()
+{
+	_pool.wait();
+}
+
+void mesh_streamer::clear()
+{
+	_pool.wait();
+
+	lock_guard<mutex> lock(_mutex);
+	_ready.clear();
+	_pending = 0;
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "model.h"
+#include "resource_table.h"
+#include "thread_pool.h"
+
+/// Bytes of streamed meshes a renderer uploads per frame unless told otherwise
+static const size_t default_upload_budget = 8 << 20;
+
+/// Geometry of a mesh prepared by the workers of a mesh_streamer, ready to be written to a geometry pool
+struct streamed_mesh
+{
+	/// Handle the mesh was requested with
+	resource_handle key;
+	std::vector<vertex> vertices;
+	std::vector<uint32_t> indices;
+
+	size_t byte_size() const { return vertices.size() * sizeof(vertex) + indices.size() * sizeof(uint32_t); }
+};
+
+/**
+ * Prepares meshes for upload on a thread pool: the vertices are interleaved, welded and ordered by first use.
+ * The models are already loaded from their files, only their preparation is streamed. The render thread takes the prepared meshes a few at a time, so uploading them is spread over the frames
+ */
+class mesh_streamer
+{
+public:
+
+	explicit mesh_streamer(size_t thread_count = 0);
+	~mesh_streamer();
+
+	/// Queues the preparation of a mesh, the model must not change until the mesh is taken
+	void request(resource_handle key, std::shared_ptr<const model> mesh);
+
+	/**
+	 * Moves prepared meshes to ready until their total size would exceed byte_budget, without waiting for the workers.
+	 * A mesh larger than the budget is taken alone, so it is not held back forever. Returns the number of bytes taken
+	 */
+	size_t take(size_t byte_budget, std::vector<streamed_mesh>& ready);
+
+	/// Number of requested meshes that were not taken yet
+	size_t pending() const;
+
+	/// Blocks until every requested mesh is prepared
+	void wait();
+
+	/// Waits for the workers and drops the meshes that were not taken
+	void clear();
+
+private:
+
+	mutable std::mutex _mutex;
+	/// Prepared meshes in the order they were finished
+	std::deque<streamed_mesh> _ready;
+	size_t _pending = 0;
+
+	/// Destroyed first, so the workers finish before the prepared meshes go away
+	thread_pool _pool;
+};
\ No newline at end of file
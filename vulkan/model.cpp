@@ -1,7 +1,11 @@
 #include "model.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <stdexcept>
+#include <unordered_map>
 
 using namespace std;
 
@@ -27,7 +31,7 @@ static void add_indice(void* vmesh, tinyobj::index_t* index, int num_index)
 {
 	auto* m = static_cast<model*>(vmesh);
 	for(auto i = 0; i < num_index; i++)
-		m->indices.push_back(index[i].vertex_index - 1);
+		m->indices.push_back(uint32_t(index[i].vertex_index - 1));
 }
 
 model load_model_from_file(const string& filename)
@@ -43,5 +47,267 @@ model load_model_from_file(const string& filename)
 	if (!file)
 		throw runtime_error("Can't open file");
 	tinyobj::LoadObjWithCallback(file, callbacks, &m);
+	compute_bounds(m);
 	return m;
+}
+
+/// Indices of the two triangles of every quad of a grid of (rows + 1) * (columns + 1) vertices
+static void add_grid_indices(model& m, uint32_t rows, uint32_t columns)
+{
+	for (uint32_t r = 0; r < rows; r++)
+	{
+		for (uint32_t c = 0; c < columns; c++)
+		{
+			auto a = r * (columns + 1) + c;
+			auto b = a + columns + 1;
+			m.indices.insert(end(m.indices), { a, a + 1, b, b, a + 1, b + 1 });
+		}
+	}
+}
+
+model create_sphere(uint32_t rings, uint32_t segments)
+{
+	if (rings < 2 || segments < 3)
+		throw runtime_error("A sphere needs at least 2 rings and 3 segments");
+
+	const float pi = 3.14159265358979f;
+	model m;
+	for (uint32_t r = 0; r <= rings; r++)
+	{
+		auto phi = pi * r / rings;
+		for (uint32_t s = 0; s <= segments; s++)
+		{
+			auto theta = 2.f * pi * s / segments;
+			auto n = glm::vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+			m.vertices.push_back(n);
+			m.normals.push_back(n);
+			m.text_coords.push_back(glm::vec2(float(s) / segments, float(r) / rings));
+		}
+	}
+
+	add_grid_indices(m, rings, segments);
+	compute_bounds(m);
+	return m;
+}
+
+model create_torus(uint32_t rings, uint32_t segments, float thickness)
+{
+	if (rings < 3 || segments < 3)
+		throw runtime_error("A torus needs at least 3 rings and 3 segments");
+
+	const float pi = 3.14159265358979f;
+	auto radius = 1.f - thickness;
+	model m;
+	for (uint32_t r = 0; r <= rings; r++)
+	{
+		// Angle around the y axis
+		auto theta = 2.f * pi * r / rings;
+		auto axis = glm::vec3(cos(theta), 0.f, sin(theta));
+		for (uint32_t s = 0; s <= segments; s++)
+		{
+			// Angle around the tube
+			auto phi = 2.f * pi * s / segments;
+			auto n = axis * cos(phi) + glm::vec3(0.f, sin(phi), 0.f);
+			m.vertices.push_back(axis * radius + n * thickness);
+			m.normals.push_back(n);
+			m.text_coords.push_back(glm::vec2(float(r) / rings, float(s) / segments));
+		}
+	}
+
+	add_grid_indices(m, rings, segments);
+	compute_bounds(m);
+	return m;
+}
+
+/// Value in [0, 1] hashed from a lattice point and a seed
+static float lattice_value(int32_t x, int32_t z, uint32_t seed)
+{
+	auto h = uint32_t(x) * 0x8da6b343u ^ uint32_t(z) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	h *= 0x297a2d39u;
+	h ^= h >> 15;
+	return (h >> 8) / float(1 << 24);
+}
+
+/// Value noise interpolated with a smoothstep between the lattice points
+static float value_noise(float x, float z, uint32_t seed)
+{
+	auto x0 = int32_t(floor(x));
+	auto z0 = int32_t(floor(z));
+	auto fx = x - x0;
+	auto fz = z - z0;
+	fx = fx * fx * (3.f - 2.f * fx);
+	fz = fz * fz * (3.f - 2.f * fz);
+
+	auto a = glm::mix(lattice_value(x0, z0, seed), lattice_value(x0 + 1, z0, seed), fx);
+	auto b = glm::mix(lattice_value(x0, z0 + 1, seed), lattice_value(x0 + 1, z0 + 1, seed), fx);
+	return glm::mix(a, b, fz);
+}
+
+model create_terrain(uint32_t cells, uint32_t seed, float height)
+{
+	if (cells < 1)
+		throw runtime_error("A terrain needs at least 1 cell");
+
+	// Four octaves, each twice the frequency and half the amplitude of the previous one
+	auto elevation = [&](float x, float z)
+	{
+		float h = 0.f;
+		float amplitude = 0.5f;
+		float frequency = 2.f;
+		for (uint32_t octave = 0; octave < 4; octave++)
+		{
+			h += amplitude * value_noise(x * frequency, z * frequency, seed + octave);
+			amplitude *= 0.5f;
+			frequency *= 2.f;
+		}
+		return h * height;
+	};
+
+	model m;
+	auto step = 2.f / cells;
+	for (uint32_t r = 0; r <= cells; r++)
+	{
+		for (uint32_t c = 0; c <= cells; c++)
+		{
+			auto x = -1.f + c * step;
+			auto z = -1.f + r * step;
+			m.vertices.push_back(glm::vec3(x, elevation(x, z), z));
+
+			// Normal from the central differences of the elevation
+			auto dx = elevation(x + step, z) - elevation(x - step, z);
+			auto dz = elevation(x, z + step) - elevation(x, z - step);
+			m.normals.push_back(glm::normalize(glm::vec3(-dx, 2.f * step, -dz)));
+			m.text_coords.push_back(glm::vec2(float(c) / cells, float(r) / cells));
+		}
+	}
+
+	add_grid_indices(m, cells, cells);
+	compute_bounds(m);
+	return m;
+}
+
+model create_box(const aabb& box)
+{
+	model m;
+	// Each face has its own 4 vertices, so its normal is not shared with the adjacent faces
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			glm::vec3 normal(0.f);
+			normal[axis] = side ? 1.f : -1.f;
+			auto u = (axis + 1) % 3;
+			auto v = (axis + 2) % 3;
+
+			auto first = uint32_t(size(m.vertices));
+			for (int corner = 0; corner < 4; corner++)
+			{
+				glm::vec3 p;
+				p[axis] = side ? box.max[axis] : box.min[axis];
+				p[u] = corner & 1 ? box.max[u] : box.min[u];
+				p[v] = corner & 2 ? box.max[v] : box.min[v];
+				m.vertices.push_back(p);
+				m.normals.push_back(normal);
+			}
+			m.indices.insert(end(m.indices), { first, first + 1, first + 2, first + 2, first + 1, first + 3 });
+		}
+	}
+
+	compute_bounds(m);
+	return m;
+}
+
+void compute_bounds(model& m)
+{
+	if (m.vertices.empty())
+	{
+		m.box = aabb{ glm::vec3(), glm::vec3() };
+		m.bounding_sphere = sphere{ glm::vec3(), 0.f };
+		return;
+	}
+
+	m.box = aabb{ m.vertices[0], m.vertices[0] };
+	for (auto& v : m.vertices)
+	{
+		m.box.min = glm::min(m.box.min, v);
+		m.box.max = glm::max(m.box.max, v);
+	}
+
+	auto center = (m.box.min + m.box.max) * 0.5f;
+	float radius = 0.f;
+	for (auto& v : m.vertices)
+		radius = max(radius, glm::distance(center, v));
+	m.bounding_sphere = sphere{ center, radius };
+}
+
+vector<vertex> interleave_vertices(const model& m)
+{
+	vector<vertex> vertices(size(m.vertices));
+	for (size_t i = 0; i < size(m.vertices); i++)
+	{
+		vertices[i].position = m.vertices[i];
+		vertices[i].normal = i < size(m.normals) ? m.normals[i] : glm::vec3();
+	}
+	return vertices;
+}
+
+/// Hash of the bytes of a vertex, positions and normals are compared bitwise when welding
+struct vertex_hash
+{
+	size_t operator()(const vertex& v) const
+	{
+		uint32_t words[sizeof(vertex) / 4];
+		memcpy(words, &v, sizeof(vertex));
+		size_t h = 0;
+		for (auto w : words)
+			h = (h ^ w) * 0x100000001b3ull;
+		return h;
+	}
+};
+
+struct vertex_equal
+{
+	bool operator()(const vertex& a, const vertex& b) const { return memcmp(&a, &b, sizeof(vertex)) == 0; }
+};
+
+void weld_vertices(vector<vertex>& vertices, vector<uint32_t>& indices)
+{
+	unordered_map<vertex, uint32_t, vertex_hash, vertex_equal> welded(size(vertices));
+	vector<uint32_t> remap(size(vertices));
+	size_t count = 0;
+	for (size_t i = 0; i < size(vertices); i++)
+	{
+		auto it = welded.emplace(vertices[i], uint32_t(count));
+		if (it.second)
+			vertices[count++] = vertices[i];
+		remap[i] = it.first->second;
+	}
+	vertices.resize(count);
+
+	for (auto& index : indices)
+		index = remap[index];
+}
+
+void optimize_vertex_order(vector<vertex>& vertices, vector<uint32_t>& indices)
+{
+	const auto unused = UINT32_MAX;
+	vector<uint32_t> remap(size(vertices), unused);
+	vector<vertex> ordered;
+	ordered.reserve(size(vertices));
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == unused)
+		{
+			remap[index] = uint32_t(size(ordered));
+			ordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	// Vertices no index refers to are dropped
+	vertices = move(ordered);
 }
\ No newline at end of file
@@ -1,16 +1,67 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <vector>
 #include <glm/glm.hpp>
-#include "any.h"
+#include "resource_table.h"
+
+/// Axis aligned bounding box
+struct aabb
+{
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+/// Bounding sphere
+struct sphere
+{
+	glm::vec3 center;
+	float radius;
+};
+
+/// Interleaved vertex as it is stored in the GPU buffers
+struct vertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+};
 
 struct model
 {
 	std::vector<glm::vec3> vertices;
 	std::vector<glm::vec3> normals;
 	std::vector<glm::vec2> text_coords;
-	std::vector<size_t> indices;
-	any user_data;
+	std::vector<uint32_t> indices;
+	/// Bounds in model space, computed when the model is loaded
+	aabb box;
+	sphere bounding_sphere;
+	/// Resources of the renderer for the model
+	resource_handle resource;
 };
 
-model load_model_from_file(const std::string& filename);
\ No newline at end of file
+model load_model_from_file(const std::string& filename);
+
+/// UV sphere of radius 1 with 2 * rings * segments triangles, the ones touching the poles are degenerate
+model create_sphere(uint32_t rings, uint32_t segments);
+
+/// Torus around the y axis with an outer radius of 1, 2 * rings * segments triangles, thickness is the radius of the tube
+model create_torus(uint32_t rings, uint32_t segments, float thickness);
+
+/// Square heightfield of cells * cells quads from -1 to 1 on x and z, with fractal value noise of the seed up to height on y
+model create_terrain(uint32_t cells, uint32_t seed, float height);
+
+/// Box with a normal per face, drawn in place of a mesh that is not loaded yet
+model create_box(const aabb& box);
+
+/// Computes the bounding box and the bounding sphere of the model from its vertices
+void compute_bounds(model& m);
+
+/// Interleaves the vertices and the normals of the model
+std::vector<vertex> interleave_vertices(const model& m);
+
+/// Merges the vertices with the same position and normal, the indices are remapped
+void weld_vertices(std::vector<vertex>& vertices, std::vector<uint32_t>& indices);
+
+/// Orders the vertices by their first use in the indices, so drawing reads the vertex buffer front to back
+void optimize_vertex_order(std::vector<vertex>& vertices, std::vector<uint32_t>& indices);
\ No newline at end of file
@@ -3,15 +3,15 @@
 
 void object::translate(const glm::vec3& v)
 {
-	trans *= glm::translate(v);
+	trans = glm::translate(trans, v);
 }
 
 void object::rotate(float a, const glm::vec3& v)
 {
-	trans *= glm::rotate(a, v);
+	trans = glm::rotate(trans, a, v);
 }
 
 void object::scale(const glm::vec3& v)
 {
-	trans *= glm::scale(v);
+	trans = glm::scale(trans, v);
 }
\ No newline at end of file
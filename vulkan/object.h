@@ -2,12 +2,10 @@
 
 #include "model.h"
 #include <memory>
-#include "any.h"
 
 struct shader
 {
 	std::string filename;
-	any user_data;
 };
 
 struct material
@@ -20,12 +18,11 @@ struct material
 
 struct object
 {
-	std::shared_ptr<model> model;
+	std::shared_ptr<::model> model;
 	glm::mat4 trans = glm::mat4(1.0);
 	shader vertex_shader;
 	shader fragment_shader;
-	material material;
-	any user_data;
+	::material material;
 
 	void translate(const glm::vec3& v);
 	void rotate(float a, const glm::vec3& v);
@@ -0,0 +1,91 @@
+#include "egl_context.h"
+
+#ifdef USE_EGL
+
+#include <EGL/eglext.h>
+#include <cstring>
+#include <stdexcept>
+
+using namespace opengl;
+using namespace std;
+
+static bool has_extension(const char* extensions, const char* name)
+{
+	return extensions && strstr(extensions, name);
+}
+
+/// Display of the surfaceless platform if available, so no X or Wayland server is needed
+static EGLDisplay get_display()
+{
+	auto* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless") && has_extension(client_extensions, "EGL_EXT_platform_base"))
+	{
+		auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (get_platform_display)
+		{
+			auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+egl_context::egl_context(int major, int minor)
+{
+	_display = get_display();
+	if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, nullptr, nullptr))
+		throw runtime_error("Failed to initialize EGL");
+
+	auto surfaceless = has_extension(eglQueryString(_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+
+	EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint config_count;
+	if (!eglChooseConfig(_display, config_attributes, &config, 1, &config_count) || config_count == 0)
+		throw runtime_error("No EGL config for OpenGL");
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+		throw runtime_error("EGL does not support OpenGL");
+
+	EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major,
+		EGL_CONTEXT_MINOR_VERSION, minor,
+		EGL_NONE
+	};
+	_context = eglCreateContext(_display, config, EGL_NO_CONTEXT, context_attributes);
+	if (_context == EGL_NO_CONTEXT)
+		throw runtime_error("Failed to create EGL context");
+
+	// The renderer draws into its own framebuffer, the pbuffer only exists to make the context current
+	if (!surfaceless)
+	{
+		EGLint pbuffer_attributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+		_surface = eglCreatePbufferSurface(_display, config, pbuffer_attributes);
+		if (_surface == EGL_NO_SURFACE)
+			throw runtime_error("Failed to create EGL pbuffer");
+	}
+
+	if (!eglMakeCurrent(_display, _surface, _surface, _context))
+		throw runtime_error("Failed to make the EGL context current");
+}
+
+egl_context::~egl_context()
+{
+	eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (_surface != EGL_NO_SURFACE)
+		eglDestroySurface(_display, _surface);
+	if (_context != EGL_NO_CONTEXT)
+		eglDestroyContext(_display, _context);
+	eglTerminate(_display);
+}
+
+#endif
\ No newline at end of file
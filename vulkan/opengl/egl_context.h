@@ -0,0 +1,32 @@
+#pragma once
+
+#ifdef USE_EGL
+
+#include <EGL/egl.h>
+
+namespace opengl
+{
+	/**
+	 * OpenGL context without window for the headless mode, made current on creation.
+	 * Uses a surfaceless context when the driver supports it (Mesa llvmpipe does), a small pbuffer otherwise.
+	 * glew is initialized with glewContextInit, its glXGetProcAddress is dispatched to the EGL context by glvnd,
+	 * a glew built with GLEW_EGL uses eglGetProcAddress instead
+	 */
+	class egl_context
+	{
+	public:
+
+		egl_context(int major, int minor);
+		egl_context(const egl_context&) = delete;
+		egl_context& operator=(const egl_context&) = delete;
+		~egl_context();
+
+	private:
+
+		EGLDisplay _display = EGL_NO_DISPLAY;
+		EGLSurface _surface = EGL_NO_SURFACE;
+		EGLContext _context = EGL_NO_CONTEXT;
+	};
+}
+
+#endif
\ No newline at end of file
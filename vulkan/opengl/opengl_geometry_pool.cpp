@@ -0,0 +1,109 @@
+#include "opengl_geometry_pool.h"
+
+using namespace opengl;
+using namespace std;
+
+/// Binding index of the interleaved vertex buffer
+static const GLuint vertex_binding = 0;
+
+/// Creates a buffer of new_size bytes containing the first old_size bytes of old, and deletes old
+static GLuint resize_buffer(GLuint old, size_t old_size, size_t new_size)
+{
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, new_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	if (old)
+	{
+		glCopyNamedBufferSubData(old, buffer, 0, 0, old_size);
+		glDeleteBuffers(1, &old);
+	}
+	return buffer;
+}
+
+/// Creates a copy of old where the moved ranges are relocated, and deletes old
+static GLuint relocate_buffer(GLuint old, size_t capacity, const vector<range_allocator::move>& moves, size_t element_size)
+{
+	GLuint buffer;
+	glCreateBuffers(1, &buffer);
+	glNamedBufferStorage(buffer, capacity * element_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// Everything before the first move is already in place, the moves cover the rest of the allocations
+	auto in_place = moves.empty() ? capacity : moves.front().to;
+	if (in_place)
+		glCopyNamedBufferSubData(old, buffer, 0, 0, in_place * element_size);
+	for (auto& m : moves)
+		glCopyNamedBufferSubData(old, buffer, m.from * element_size, m.to * element_size, m.size * element_size);
+
+	glDeleteBuffers(1, &old);
+	return buffer;
+}
+
+opengl_geometry_pool::~opengl_geometry_pool()
+{
+	destroy();
+}
+
+void opengl_geometry_pool::destroy()
+{
+	if (_vao)
+		glDeleteVertexArrays(1, &_vao);
+	if (_vertex_buffer)
+		glDeleteBuffers(1, &_vertex_buffer);
+	if (_index_buffer)
+		glDeleteBuffers(1, &_index_buffer);
+	_vao = 0;
+	_vertex_buffer = 0;
+	_index_buffer = 0;
+	_vertex_capacity = 0;
+	_index_capacity = 0;
+}
+
+void opengl_geometry_pool::bind_buffers()
+{
+	if (!_vao)
+	{
+		glCreateVertexArrays(1, &_vao);
+
+		glEnableVertexArrayAttrib(_vao, 0);
+		glVertexArrayAttribFormat(_vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, position));
+		glVertexArrayAttribBinding(_vao, 0, vertex_binding);
+
+		glEnableVertexArrayAttrib(_vao, 1);
+		glVertexArrayAttribFormat(_vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(vertex, normal));
+		glVertexArrayAttribBinding(_vao, 1, vertex_binding);
+	}
+
+	glVertexArrayVertexBuffer(_vao, vertex_binding, _vertex_buffer, 0, sizeof(vertex));
+	glVertexArrayElementBuffer(_vao, _index_buffer);
+}
+
+void opengl_geometry_pool::reserve(size_t vertex_capacity, size_t index_capacity)
+{
+	if (vertex_capacity != _vertex_capacity)
+		_vertex_buffer = resize_buffer(_vertex_buffer, _vertex_capacity * sizeof(vertex), vertex_capacity * sizeof(vertex));
+	if (index_capacity != _index_capacity)
+		_index_buffer = resize_buffer(_index_buffer, _index_capacity * sizeof(uint32_t), index_capacity * sizeof(uint32_t));
+
+	_vertex_capacity = vertex_capacity;
+	_index_capacity = index_capacity;
+
+	bind_buffers();
+}
+
+void opengl_geometry_pool::write(const mesh_range& range, const vertex* vertices, const uint32_t* indices)
+{
+	if (range.vertex_count)
+		glNamedBufferSubData(_vertex_buffer, range.vertex_offset * sizeof(vertex), range.vertex_count * sizeof(vertex), vertices);
+	if (range.index_count)
+		glNamedBufferSubData(_index_buffer, range.first_index * sizeof(uint32_t), range.index_count * sizeof(uint32_t), indices);
+}
+
+void opengl_geometry_pool::relocate(const vector<range_allocator::move>& vertex_moves, const vector<range_allocator::move>& index_moves)
+{
+	if (!vertex_moves.empty())
+		_vertex_buffer = relocate_buffer(_vertex_buffer, _vertex_capacity, vertex_moves, sizeof(vertex));
+	if (!index_moves.empty())
+		_index_buffer = relocate_buffer(_index_buffer, _index_capacity, index_moves, sizeof(uint32_t));
+
+	bind_buffers();
+}
\ No newline at end of file
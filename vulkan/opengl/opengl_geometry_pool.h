@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <geometry_pool.h>
+
+namespace opengl
+{
+	/**
+	 * Geometry pool storing every mesh in one OpenGL vertex buffer and one index buffer,
+	 * read through a single vertex array
+	 */
+	class opengl_geometry_pool : public geometry_pool
+	{
+	public:
+
+		opengl_geometry_pool() = default;
+		opengl_geometry_pool(const opengl_geometry_pool&) = delete;
+		opengl_geometry_pool& operator=(const opengl_geometry_pool&) = delete;
+		~opengl_geometry_pool();
+
+		/// Vertex array reading the buffers of the pool
+		GLuint vao() const { return _vao; }
+
+		/// Destroys the OpenGL objects
+		void destroy();
+
+	protected:
+
+		void reserve(size_t vertex_capacity, size_t index_capacity) override;
+
+		void write(const mesh_range& range, const vertex* vertices, const uint32_t* indices) override;
+
+		void relocate(const std::vector<range_allocator::move>& vertex_moves, const std::vector<range_allocator::move>& index_moves) override;
+
+	private:
+
+		/// Attaches the buffers to the vertex array
+		void bind_buffers();
+
+		GLuint _vao = 0;
+		GLuint _vertex_buffer = 0;
+		GLuint _index_buffer = 0;
+		size_t _vertex_capacity = 0;
+		size_t _index_capacity = 0;
+	};
+}
\ No newline at end of file
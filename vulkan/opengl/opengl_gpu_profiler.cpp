@@ -0,0 +1,142 @@
+#include "opengl_gpu_profiler.h"
+#include <profiler.h>
+
+using namespace opengl;
+using namespace std;
+
+opengl_gpu_profiler::~opengl_gpu_profiler()
+{
+	destroy();
+}
+
+void opengl_gpu_profiler::init(size_t slot_count)
+{
+	_statistics = GLEW_ARB_pipeline_statistics_query != 0;
+	_gpu_track = profiler::get().add_track("GPU");
+
+	_slots.resize(slot_count);
+	for (auto& s : _slots)
+	{
+		GLuint queries[6];
+		glGenQueries(_statistics ? 6 : 4, queries);
+		s.frame_begin = queries[0];
+		s.pass_end = queries[1];
+		s.frame_end = queries[2];
+		s.primitives = queries[3];
+		if (_statistics)
+		{
+			s.vertex_invocations = queries[4];
+			s.fragment_invocations = queries[5];
+		}
+	}
+
+	// The current GPU time is read synchronously, unlike the timestamps written by the queries
+	GLint64 gpu_time;
+	glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+	_offset = int64_t(profiler::get().now()) - gpu_time;
+}
+
+void opengl_gpu_profiler::collect(slot& s)
+{
+	if (s.frame == UINT64_MAX)
+		return;
+
+	// The end of the frame is the last query written, when it is done every other query is
+	GLuint available;
+	glGetQueryObjectuiv(s.frame_end, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+	{
+		s.frame = UINT64_MAX;
+		return;
+	}
+
+	GLuint64 begin, pass_end, end;
+	glGetQueryObjectui64v(s.frame_begin, GL_QUERY_RESULT, &begin);
+	glGetQueryObjectui64v(s.pass_end, GL_QUERY_RESULT, &pass_end);
+	glGetQueryObjectui64v(s.frame_end, GL_QUERY_RESULT, &end);
+
+	gpu_frame_stats stats;
+	stats.frame = s.frame;
+	stats.frame_ms = (end - begin) / 1e6;
+	stats.pass_ms = (pass_end - begin) / 1e6;
+
+	GLuint64 value;
+	glGetQueryObjectui64v(s.primitives, GL_QUERY_RESULT, &value);
+	stats.primitives = value;
+	if (_statistics)
+	{
+		glGetQueryObjectui64v(s.vertex_invocations, GL_QUERY_RESULT, &value);
+		stats.vertex_invocations = value;
+		glGetQueryObjectui64v(s.fragment_invocations, GL_QUERY_RESULT, &value);
+		stats.fragment_invocations = value;
+	}
+
+	auto& p = profiler::get();
+	p.record("frame", _gpu_track, uint64_t(int64_t(begin) + _offset), uint64_t(int64_t(end) + _offset));
+	p.record("render pass", _gpu_track, uint64_t(int64_t(begin) + _offset), uint64_t(int64_t(pass_end) + _offset));
+	if (_statistics)
+	{
+		auto time = p.now();
+		p.counter("vertex invocations", _gpu_track, time, double(stats.vertex_invocations));
+		p.counter("fragment invocations", _gpu_track, time, double(stats.fragment_invocations));
+	}
+
+	_latest = stats;
+	_has_latest = true;
+	s.frame = UINT64_MAX;
+}
+
+void opengl_gpu_profiler::begin_frame(uint64_t frame)
+{
+	_current = (_current + 1) % size(_slots);
+	auto& s = _slots[_current];
+	collect(s);
+
+	s.frame = frame;
+	glQueryCounter(s.frame_begin, GL_TIMESTAMP);
+}
+
+void opengl_gpu_profiler::begin_pass()
+{
+	auto& s = _slots[_current];
+	glBeginQuery(GL_PRIMITIVES_GENERATED, s.primitives);
+	if (_statistics)
+	{
+		glBeginQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB, s.vertex_invocations);
+		glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB, s.fragment_invocations);
+	}
+}
+
+void opengl_gpu_profiler::end_pass()
+{
+	auto& s = _slots[_current];
+	glEndQuery(GL_PRIMITIVES_GENERATED);
+	if (_statistics)
+	{
+		glEndQuery(GL_VERTEX_SHADER_INVOCATIONS_ARB);
+		glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS_ARB);
+	}
+	glQueryCounter(s.pass_end, GL_TIMESTAMP);
+}
+
+void opengl_gpu_profiler::end_frame()
+{
+	glQueryCounter(_slots[_current].frame_end, GL_TIMESTAMP);
+}
+
+bool opengl_gpu_profiler::latest(gpu_frame_stats& stats) const
+{
+	if (_has_latest)
+		stats = _latest;
+	return _has_latest;
+}
+
+void opengl_gpu_profiler::destroy()
+{
+	for (auto& s : _slots)
+	{
+		GLuint queries[] = { s.frame_begin, s.pass_end, s.frame_end, s.primitives, s.vertex_invocations, s.fragment_invocations };
+		glDeleteQueries(_statistics ? 6 : 4, queries);
+	}
+	_slots.clear();
+}
\ No newline at end of file
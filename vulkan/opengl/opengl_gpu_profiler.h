@@ -0,0 +1,71 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+#include <gpu_stats.h>
+
+namespace opengl
+{
+	/**
+	 * Measures the frames on the GPU with GL_TIMESTAMP and GL_PRIMITIVES_GENERATED queries, and the shader invocations
+	 * when ARB_pipeline_statistics_query is supported. The queries of a frame are read when their slot is reused a few frames later,
+	 * and only if their results are available, so reading never waits for the GPU. The results are added to the GPU track of the profiler
+	 */
+	class opengl_gpu_profiler
+	{
+	public:
+
+		opengl_gpu_profiler() = default;
+		opengl_gpu_profiler(const opengl_gpu_profiler&) = delete;
+		opengl_gpu_profiler& operator=(const opengl_gpu_profiler&) = delete;
+		~opengl_gpu_profiler();
+
+		/// Creates the queries of slot_count frames
+		void init(size_t slot_count);
+
+		/// Reads the previous frame of the next slot and starts measuring a frame
+		void begin_frame(uint64_t frame);
+
+		/// Starts counting the primitives and invocations of the draws
+		void begin_pass();
+
+		/// Stops counting and writes the timestamp of the end of the draws
+		void end_pass();
+
+		/// Writes the timestamp of the end of the frame
+		void end_frame();
+
+		/// Statistics of the latest frame read back, false if there is none yet
+		bool latest(gpu_frame_stats& stats) const;
+
+		/// Deletes the queries
+		void destroy();
+
+	private:
+
+		/// Queries of a frame
+		struct slot
+		{
+			GLuint frame_begin = 0;
+			GLuint pass_end = 0;
+			GLuint frame_end = 0;
+			GLuint primitives = 0;
+			GLuint vertex_invocations = 0;
+			GLuint fragment_invocations = 0;
+			/// Frame measured, or UINT64_MAX when it has nothing to read
+			uint64_t frame = UINT64_MAX;
+		};
+
+		/// Reads the queries of a slot if they are available
+		void collect(slot& s);
+
+		std::vector<slot> _slots;
+		size_t _current = 0;
+		bool _statistics = false;
+		/// Offset from the GPU timestamps to the profiler time
+		int64_t _offset = 0;
+		uint32_t _gpu_track = 0;
+		gpu_frame_stats _latest;
+		bool _has_latest = false;
+	};
+}
\ No newline at end of file
@@ -1,5 +1,8 @@
-#include <gl/glew.h>
+#include <GL/glew.h>
 #include "opengl_renderer.h"
+#include <uniforms.h>
+#include <matrix_batch.h>
+#include <profiler.h>
 #include <vector>
 #include <fstream>
 #include <iostream>
@@ -8,15 +11,63 @@
 using namespace opengl;
 using namespace std;
 
-void opengl_renderer::init(GLFWwindow* window) {}
+/// Number of regions of the uniform ring, so a frame is not overwritten while the GPU reads it
+static const size_t frames_in_flight = 3;
 
-struct model_opengl_data
+void opengl_renderer::init(GLFWwindow* window)
 {
-	GLuint vao;
-	GLuint vertex_buffer;
-	GLuint normal_buffer;
-	GLuint index_buffer;
-};
+	if (!GLEW_ARB_buffer_storage)
+		throw runtime_error("Does not support ARB_buffer_storage");
+
+	_window = window;
+	_gpu_profiler.init(frames_in_flight + 1);
+}
+
+void opengl_renderer::init_headless(uint32_t width, uint32_t height)
+{
+	init(nullptr);
+
+	_width = width;
+	_height = height;
+
+	// The context may have no default framebuffer, as with EGL surfaceless contexts
+	glGenRenderbuffers(1, &_color_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, _color_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &_depth_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, _depth_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _color_renderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, _depth_renderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw runtime_error("Offscreen framebuffer is incomplete");
+	glViewport(0, 0, width, height);
+
+	// Frames are read into the buffers in turn, so glReadPixels does not wait for the frame to be rendered
+	auto image_size = size_t(width) * height * 4;
+	GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	_readback_buffers.resize(frames_in_flight);
+	_readback_data.resize(frames_in_flight);
+	_readback_fences.resize(frames_in_flight, nullptr);
+	glGenBuffers(GLsizei(frames_in_flight), data(_readback_buffers));
+	for (size_t i = 0; i < frames_in_flight; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, _readback_buffers[i]);
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, image_size, nullptr, flags);
+		_readback_data[i] = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image_size, flags));
+		if (!_readback_data[i])
+			throw runtime_error("Failed to map read back buffer");
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+/// Binding point of the FrameBlock uniform block
+static const GLuint frame_block_binding = 0;
+/// Binding point of the ObjectBlock uniform block
+static const GLuint object_block_binding = 1;
 
 static GLuint create_shader(const string& path, GLenum type)
 {
@@ -82,97 +133,319 @@ GLuint create_program(const std::string& vs, const std::string& fs)
 	return program;
 }
 
-void opengl_renderer::init_scene(scene& sc)
+static size_t align_up(size_t size, size_t alignment)
 {
-	for(auto& obj : sc.objects)
-	{
-		model_opengl_data model_data;
-		if (obj.model->user_data.empty())
-		{
-			glGenVertexArrays(1, &model_data.vao);
-			glBindVertexArray(model_data.vao);
+	return (size + alignment - 1) / alignment * alignment;
+}
 
-			glGenBuffers(1, &model_data.vertex_buffer);
-			glBindBuffer(GL_ARRAY_BUFFER, model_data.vertex_buffer);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(obj.model->vertices[0]) * size(obj.model->vertices), data(obj.model->vertices), GL_STATIC_DRAW);
+/// Binds the uniform blocks of the program to their binding points
+static void bind_uniform_blocks(GLuint program)
+{
+	auto frame_block = glGetUniformBlockIndex(program, "FrameBlock");
+	auto object_block = glGetUniformBlockIndex(program, "ObjectBlock");
+	if (frame_block == GL_INVALID_INDEX || object_block == GL_INVALID_INDEX)
+		throw runtime_error("Program is missing a uniform block");
 
-			glGenBuffers(1, &model_data.normal_buffer);
-			glBindBuffer(GL_ARRAY_BUFFER, model_data.normal_buffer);
-			glBufferData(GL_ARRAY_BUFFER, sizeof(obj.model->normals[0]) * size(obj.model->normals), data(obj.model->normals), GL_STATIC_DRAW);
+	glUniformBlockBinding(program, frame_block, frame_block_binding);
+	glUniformBlockBinding(program, object_block, object_block_binding);
+}
 
-			glGenBuffers(1, &model_data.index_buffer);
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model_data.index_buffer);
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(obj.model->indices[0]) * size(obj.model->indices), data(obj.model->indices), GL_STATIC_DRAW);
+/// Size of the uniforms of a frame with count objects
+static size_t uniforms_size(size_t count, size_t alignment)
+{
+	return align_up(sizeof(frame_uniforms), alignment) + count * align_up(sizeof(object_uniforms), alignment);
+}
+
+void opengl_renderer::init_scene(scene& sc)
+{
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	_uniform_alignment = alignment;
+
+	_uniforms.reserve(uniforms_size(sc.objects.count(), _uniform_alignment), frames_in_flight);
+
+	// Without an upload budget the meshes are uploaded now, otherwise their boxes are drawn until the streamer prepared them.
+	// Without a memory budget every mesh is requested now, otherwise when it is first visible
+	for (auto& m : sc.objects.meshes())
+	{
+		if (_meshes.valid(m->resource))
+			continue;
 
-			obj.model->user_data = model_data;
+		if (_upload_budget)
+		{
+			m->resource = _meshes.add(model_opengl_data{ _geometry.add(create_box(m->box)), m->box });
+			_residency.add(m->resource);
+			if (!_residency.budget() && _residency.request(m->resource))
+				_streamer.request(m->resource, m);
+		}
+		else
+		{
+			m->resource = _meshes.add(model_opengl_data{ _geometry.add(*m), m->box });
+			_residency.add(m->resource, size(m->vertices) * sizeof(vertex) + size(m->indices) * sizeof(uint32_t));
 		}
+	}
+
+	// One program per pipeline, shared by every object drawn with it
+	for (auto& p : sc.objects.pipelines())
+	{
+		if (_programs.valid(p.resource))
+			continue;
 
-		obj.user_data = create_program(obj.vertex_shader.filename, obj.fragment_shader.filename);
+		auto program = create_program(p.vertex_shader.filename, p.fragment_shader.filename);
+		bind_uniform_blocks(program);
+		p.resource = _programs.add(program);
 	}
 }
 
 void opengl_renderer::render(const scene& sc)
 {
+	_gpu_profiler.begin_frame(_frame_count);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+
+	// The default framebuffer follows the size of the window
+	if (_window)
+	{
+		int width, height;
+		glfwGetFramebufferSize(_window, &width, &height);
+		if (uint32_t(width) != _width || uint32_t(height) != _height)
+		{
+			glViewport(0, 0, width, height);
+			_width = width;
+			_height = height;
+		}
+	}
+
 	glEnable(GL_DEPTH_TEST);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	for(auto& obj : sc.objects)
-	{
-		auto program = any_cast<GLuint>(obj.user_data);
-
-		auto ubo_model = glGetUniformLocation(program, "model");
-		auto ubo_view = glGetUniformLocation(program, "view");
-		auto ubo_proj = glGetUniformLocation(program, "proj");
-		auto ubo_material_ambiant = glGetUniformLocation(program, "material.ambiant");
-		auto ubo_material_diffuse = glGetUniformLocation(program, "material.diffuse");
-		auto ubo_material_specular = glGetUniformLocation(program, "material.specular");
-		auto ubo_material_hardness = glGetUniformLocation(program, "material.hardness");
-		auto ubo_point_pos = glGetUniformLocation(program, "point.pos");
-		auto ubo_point_ambiant = glGetUniformLocation(program, "point.pos");
-		auto ubo_point_diffuse = glGetUniformLocation(program, "point.diffuse");
-		auto ubo_point_specular = glGetUniformLocation(program, "point.specular");
-		auto ubo_point_attenuation = glGetUniformLocation(program, "point.attenuation");
-		auto ubo_eye = glGetUniformLocation(program, "eye");
-
-		glUseProgram(program);
-
-		glUniformMatrix4fv(ubo_model, 1, GL_FALSE, &obj.trans[0][0]);
-		glUniformMatrix4fv(ubo_view, 1, GL_FALSE, &sc.view[0][0]);
-		glUniformMatrix4fv(ubo_proj, 1, GL_FALSE, &sc.projection[0][0]);
-		glUniform4fv(ubo_material_ambiant, 1, &obj.material.ambiant[0]);
-		glUniform4fv(ubo_material_diffuse, 1, &obj.material.diffuse[0]);
-		glUniform4fv(ubo_material_specular, 1, &obj.material.specular[0]);
-		glUniform4fv(ubo_material_hardness, 1, &obj.material.hardness[0]);
-		glUniform4fv(ubo_point_pos, 1, &sc.point.pos[0]);
-		glUniform4fv(ubo_point_ambiant, 1, &sc.point.ambiant[0]);
-		glUniform4fv(ubo_point_diffuse, 1, &sc.point.diffuse[0]);
-		glUniform4fv(ubo_point_specular, 1, &sc.point.specular[0]);
-		glUniform4fv(ubo_point_attenuation, 1, &sc.point.attenuation[0]);
-		glUniform4fv(ubo_eye, 1, &sc.eye[0]);
-
-		auto model_data = any_cast<model_opengl_data>(obj.model->user_data);
-
-		glBindVertexArray(model_data.vao);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, model_data.vertex_buffer);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-		
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, model_data.normal_buffer);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model_data.index_buffer);
-
-		glDrawElements(GL_TRIANGLES, size(obj.model->indices), GL_UNSIGNED_INT, nullptr);
-
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(0);
-
-		glUseProgram(0);
+
+	{
+		PROFILE_ZONE("acquire");
+		_uniforms.reserve(uniforms_size(sc.objects.count(), _uniform_alignment), frames_in_flight);
+		_uniforms.begin_frame();
+	}
+
+	{
+		PROFILE_ZONE("cull");
+		_culler.update(sc.objects);
+		_culler.cull(extract_frustum(sc.projection * sc.view));
+	}
+	auto& visible = _culler.visible();
+
+	stream_meshes(sc, visible);
+
+	auto object_stride = align_up(sizeof(object_uniforms), _uniform_alignment);
+	stream_buffer::allocation objects;
+	{
+		PROFILE_ZONE("uniforms");
+
+		auto frame = _uniforms.allocate(sizeof(frame_uniforms), _uniform_alignment);
+		auto* frame_data = static_cast<frame_uniforms*>(frame.data);
+		frame_data->view = sc.view;
+		frame_data->proj = sc.projection;
+		frame_data->point = sc.point;
+		frame_data->sun = sc.sun;
+		frame_data->spot = sc.spot;
+		frame_data->eye = sc.eye;
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, frame_block_binding, _uniforms.buffer(), frame.offset, sizeof(frame_uniforms));
+
+		auto& transforms = sc.objects.transforms();
+		auto& material_ids = sc.objects.material_ids();
+		auto& materials = sc.objects.materials();
+
+		objects = _uniforms.allocate(size(visible) * object_stride, _uniform_alignment);
+		write_object_transforms(sc.projection * sc.view, data(transforms), data(visible), size(visible), objects.data, object_stride);
+		for (size_t i = 0; i < size(visible); i++)
+		{
+			auto* uniforms = reinterpret_cast<object_uniforms*>(static_cast<char*>(objects.data) + i * object_stride);
+			uniforms->material = materials[material_ids[visible[i]]];
+		}
+		_uniforms.flush();
+	}
+
+	{
+		PROFILE_ZONE("record");
+		_gpu_profiler.begin_pass();
+		draw(sc, visible, objects.offset, object_stride);
+		_gpu_profiler.end_pass();
+	}
+
+	if (_framebuffer)
+	{
+		PROFILE_ZONE("read back");
+		read_pixels();
+	}
+
+	_gpu_profiler.end_frame();
+
+	_uniforms.end_frame();
+	_frame_count++;
+}
+
+void opengl_renderer::stream_meshes(const scene& sc, const vector<uint32_t>& visible)
+{
+	PROFILE_ZONE("stream");
+
+	auto& mesh_ids = sc.objects.mesh_ids();
+	auto& meshes = sc.objects.meshes();
+	for (auto index : visible)
+	{
+		auto& m = meshes[mesh_ids[index]];
+		if (_residency.use(m->resource, _frame_count))
+			_streamer.request(m->resource, m);
+	}
+
+	if (_streamer.pending())
+	{
+		_streamer.take(_upload_budget, _streamed);
+		for (auto& m : _streamed)
+		{
+			_geometry.replace(_meshes[m.key].mesh, data(m.vertices), size(m.vertices), data(m.indices), size(m.indices), _frame_count);
+			_residency.made_resident(m.key, m.byte_size());
+		}
+		_streamed.clear();
+	}
+
+	if (_residency.evict(_frame_count, _evicted))
+	{
+		for (auto mesh : _evicted)
+			_geometry.replace(_meshes[mesh].mesh, create_box(_meshes[mesh].box), _frame_count);
+		_evicted.clear();
+	}
+
+	// The buffer writes are ordered after the draws already issued, so the replaced ranges can be overwritten right away
+	_geometry.free_retired(_frame_count);
+	if (_geometry.compact())
+		_residency.compacted();
+	_residency.record_counters();
+}
+
+void opengl_renderer::draw(const scene& sc, const vector<uint32_t>& visible, size_t objects_offset, size_t object_stride)
+{
+	auto& pipeline_ids = sc.objects.pipeline_ids();
+	auto& mesh_ids = sc.objects.mesh_ids();
+	auto& pipelines = sc.objects.pipelines();
+	auto& meshes = sc.objects.meshes();
+
+	glBindVertexArray(_geometry.vao());
+
+	GLuint current_program = 0;
+	for (size_t i = 0; i < size(visible); i++)
+	{
+		auto index = visible[i];
+		auto program = _programs[pipelines[pipeline_ids[index]].resource];
+
+		if (program != current_program)
+		{
+			glUseProgram(program);
+			current_program = program;
+		}
+
+		glBindBufferRange(GL_UNIFORM_BUFFER, object_block_binding, _uniforms.buffer(), objects_offset + i * object_stride, sizeof(object_uniforms));
+
+		auto& range = _geometry.range(_meshes[meshes[mesh_ids[index]]->resource].mesh);
+
+		glDrawElementsBaseVertex(GL_TRIANGLES, range.index_count, GL_UNSIGNED_INT, reinterpret_cast<void*>(range.first_index * sizeof(uint32_t)), range.vertex_offset);
 	}
+
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+void opengl_renderer::read_pixels()
+{
+	auto buffer = size_t(_frame_count % size(_readback_buffers));
+	if (_readback_fences[buffer])
+		glDeleteSync(_readback_fences[buffer]);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, _readback_buffers[buffer]);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	_readback_fences[buffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool opengl_renderer::read_back(frame_pixels& pixels)
+{
+	if (!_framebuffer)
+		return false;
+
+	// Frames older than the buffers were overwritten
+	auto buffer_count = uint64_t(size(_readback_buffers));
+	if (_frame_count > buffer_count)
+		_read_count = max(_read_count, _frame_count - buffer_count);
+	if (_read_count == _frame_count)
+		return false;
+
+	// The next render reuses the oldest buffer, so that frame is waited for instead of lost
+	auto buffer = size_t(_read_count % buffer_count);
+	auto timeout = _read_count + buffer_count == _frame_count ? 1000000000ull : 0ull;
+	auto result = glClientWaitSync(_readback_fences[buffer], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+	if (result == GL_WAIT_FAILED)
+		throw runtime_error("Failed to wait for the read back fence");
+	if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+		return false;
+
+	pixels.width = _width;
+	pixels.height = _height;
+	pixels.bottom_up = true;
+	pixels.frame = _read_count++;
+	pixels.data = _readback_data[buffer];
+	return true;
+}
+
+bool opengl_renderer::gpu_stats(gpu_frame_stats& stats)
+{
+	if (!_gpu_profiler.latest(stats))
+		return false;
+	stats.cpu_stalls = _uniforms.stalls();
+	return true;
 }
 
 void opengl_renderer::cleanup(scene& sc)
 {
-	
+	_streamer.clear();
+	_geometry.free_retired(_frame_count);
+
+	for (auto& m : sc.objects.meshes())
+	{
+		if (_meshes.valid(m->resource))
+		{
+			_geometry.remove(_meshes[m->resource].mesh);
+			_residency.remove(m->resource);
+			_meshes.remove(m->resource);
+		}
+		m->resource = resource_handle();
+	}
+
+	for (auto& p : sc.objects.pipelines())
+	{
+		glDeleteProgram(_programs[p.resource]);
+		_programs.remove(p.resource);
+		p.resource = resource_handle();
+	}
+
+	_geometry.destroy();
+	_uniforms.destroy();
+	_gpu_profiler.destroy();
+
+	for (size_t i = 0; i < size(_readback_buffers); i++)
+	{
+		if (_readback_fences[i])
+			glDeleteSync(_readback_fences[i]);
+		glDeleteBuffers(1, &_readback_buffers[i]);
+	}
+	_readback_buffers.clear();
+	_readback_data.clear();
+	_readback_fences.clear();
+
+	if (_framebuffer)
+	{
+		glDeleteFramebuffers(1, &_framebuffer);
+		glDeleteRenderbuffers(1, &_color_renderbuffer);
+		glDeleteRenderbuffers(1, &_depth_renderbuffer);
+		_framebuffer = 0;
+	}
 }
@@ -1,24 +1,111 @@
 #pragma once
 
+#include <GL/glew.h>
 #include <renderer.h>
-#include <glfw/glfw3.h>
+#include <GLFW/glfw3.h>
+#include <culling.h>
+#include <mesh_streamer.h>
+#include <residency_manager.h>
+#include <resource_table.h>
+#include "opengl_geometry_pool.h"
+#include "opengl_gpu_profiler.h"
+#include "stream_buffer.h"
 
 namespace opengl
 {
+	/// Resources of a model
+	struct model_opengl_data
+	{
+		/// Id of the mesh in the geometry pool
+		uint32_t mesh;
+		/// Bounds of the mesh, drawn as a box while the mesh is not resident
+		aabb box;
+	};
+
 	/**
 	 * Renderer for OpenGL
 	 */
 	class opengl_renderer : public renderer
 	{
 	public:
+		/// The uniforms are written to a persistently mapped ring, or uploaded with glBufferSubData to compare with it
+		explicit opengl_renderer(bool persistent_uniforms = true) : _uniforms(persistent_uniforms) {}
 		virtual ~opengl_renderer() = default;
 
 		void init(GLFWwindow* window) override;
 
+		void init_headless(uint32_t width, uint32_t height) override;
+
 		void init_scene(scene& sc) override;
 
+		void set_upload_budget(size_t bytes) override { _upload_budget = bytes; }
+
+		size_t pending_uploads() const override { return _streamer.pending(); }
+
+		void set_memory_budget(size_t bytes) override { _residency.set_budget(bytes); }
+
+		const residency_stats& memory_stats() const override { return _residency.stats(); }
+
 		void render(const scene& sc) override;
 
+		bool read_back(frame_pixels& pixels) override;
+
+		bool gpu_stats(gpu_frame_stats& stats) override;
+
 		void cleanup(scene& sc) override;
+
+	private:
+
+		/// Draws the visible objects, their uniforms start at objects_offset in the uniform ring
+		void draw(const scene& sc, const std::vector<uint32_t>& visible, size_t objects_offset, size_t object_stride);
+
+		/// Requests the visible meshes that are not resident, uploads the prepared ones within the upload budget
+		/// and evicts the least recently drawn ones beyond the memory budget
+		void stream_meshes(const scene& sc, const std::vector<uint32_t>& visible);
+
+		/// Copies the offscreen framebuffer to the next read back buffer
+		void read_pixels();
+
+		/// Frustum culling of the objects
+		culler _culler;
+		/// Geometry of every model
+		opengl_geometry_pool _geometry;
+		/// Meshes of the models in the geometry pool
+		resource_table<model_opengl_data> _meshes;
+		/// Prepares the meshes on worker threads while their bounding boxes are drawn
+		mesh_streamer _streamer;
+		size_t _upload_budget = default_upload_budget;
+		/// Meshes taken from the streamer this frame, kept to reuse its storage
+		std::vector<streamed_mesh> _streamed;
+		/// Decides which meshes are requested and evicted
+		residency_manager _residency;
+		/// Meshes evicted this frame
+		std::vector<resource_handle> _evicted;
+		/// Program of every pipeline
+		resource_table<GLuint> _programs;
+
+		/// Ring containing the frame and object uniforms of the frames in flight
+		stream_buffer _uniforms;
+		/// Required alignment of a uniform buffer binding offset
+		size_t _uniform_alignment = 0;
+		/// Timestamp and statistics queries of the frames
+		opengl_gpu_profiler _gpu_profiler;
+
+		/// Window drawn into, null when headless
+		GLFWwindow* _window = nullptr;
+		/// Framebuffer drawn into when headless, 0 for the window
+		GLuint _framebuffer = 0;
+		GLuint _color_renderbuffer = 0;
+		GLuint _depth_renderbuffer = 0;
+		uint32_t _width = 0;
+		uint32_t _height = 0;
+		/// Number of frames rendered
+		uint64_t _frame_count = 0;
+		/// Number of frames read back or skipped
+		uint64_t _read_count = 0;
+		/// Persistently mapped pixel buffers the frames are read into in turn, with the fence of their last read
+		std::vector<GLuint> _readback_buffers;
+		std::vector<const uint8_t*> _readback_data;
+		std::vector<GLsync> _readback_fences;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "stream_buffer.h"
+#include <stdexcept>
+
+using namespace opengl;
+using namespace std;
+
+stream_buffer::~stream_buffer()
+{
+	destroy();
+}
+
+void stream_buffer::reserve(size_t region_size, size_t regions)
+{
+	if (_buffer && region_size <= _region_size && regions == size(_fences))
+		return;
+
+	destroy();
+
+	_region_size = region_size;
+	_fences.resize(regions, nullptr);
+	_region = 0;
+	_head = 0;
+
+	glGenBuffers(1, &_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+
+	if (!_persistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, _region_size * regions, nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		_staging.resize(_region_size);
+		return;
+	}
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glBufferStorage(GL_COPY_WRITE_BUFFER, _region_size * regions, nullptr, flags);
+	_mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, _region_size * regions, flags));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (!_mapped)
+		throw runtime_error("Failed to map stream buffer");
+}
+
+void stream_buffer::wait(size_t region)
+{
+	auto fence = _fences[region];
+	if (!fence)
+		return;
+
+	auto result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		_stalls++;
+		do
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		while (result == GL_TIMEOUT_EXPIRED);
+	}
+	if (result == GL_WAIT_FAILED)
+		throw runtime_error("Failed to wait for stream buffer fence");
+
+	glDeleteSync(fence);
+	_fences[region] = nullptr;
+}
+
+void stream_buffer::begin_frame()
+{
+	_region = (_region + 1) % size(_fences);
+	_head = 0;
+	wait(_region);
+}
+
+stream_buffer::allocation stream_buffer::allocate(size_t size, size_t alignment)
+{
+	auto offset = (_head + alignment - 1) / alignment * alignment;
+	if (offset + size > _region_size)
+		throw runtime_error("Stream buffer region is full");
+	_head = offset + size;
+
+	if (!_persistent)
+		return allocation{ data(_staging) + offset, offset + _region * _region_size };
+
+	offset += _region * _region_size;
+	return allocation{ _mapped + offset, offset };
+}
+
+void stream_buffer::flush()
+{
+	if (_persistent || !_head)
+		return;
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, _region * _region_size, _head, data(_staging));
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void stream_buffer::end_frame()
+{
+	// The driver orders glBufferSubData after the draws that read the region before
+	if (_persistent)
+		_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void stream_buffer::destroy()
+{
+	if (!_buffer)
+		return;
+
+	for (size_t i = 0; i < size(_fences); i++)
+		wait(i);
+
+	if (_mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, _buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &_buffer);
+
+	_buffer = 0;
+	_mapped = nullptr;
+	_region_size = 0;
+}
\ No newline at end of file
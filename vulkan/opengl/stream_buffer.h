@@ -0,0 +1,73 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+namespace opengl
+{
+	/**
+	 * Persistently mapped buffer written by the CPU and read by the GPU (ARB_buffer_storage).
+	 * The buffer is split in regions used in turn by consecutive frames, a region is only
+	 * written again once the fence of the frame that last used it is signaled.
+	 * When not persistent the allocations are written to a CPU copy of the region and uploaded
+	 * with glBufferSubData by flush, leaving the synchronization to the driver
+	 */
+	class stream_buffer
+	{
+	public:
+
+		/// Memory allocated in the current region
+		struct allocation
+		{
+			/// Where the CPU writes the data
+			void* data;
+			/// Offset of the data in the buffer
+			size_t offset;
+		};
+
+		explicit stream_buffer(bool persistent = true) : _persistent(persistent) {}
+		stream_buffer(const stream_buffer&) = delete;
+		stream_buffer& operator=(const stream_buffer&) = delete;
+		~stream_buffer();
+
+		/// Makes sure every region is at least region_size bytes, recreates the buffer if needed
+		void reserve(size_t region_size, size_t regions = 3);
+
+		/// Waits for the GPU to be done with the next region and makes it current
+		void begin_frame();
+
+		/// Allocates memory in the current region
+		allocation allocate(size_t size, size_t alignment);
+
+		/// Uploads the allocations of the current region when not persistent, call before drawing with them
+		void flush();
+
+		/// Fences the current region so it is not overwritten before the GPU used it
+		void end_frame();
+
+		/// Destroys the buffer
+		void destroy();
+
+		/// The OpenGL buffer
+		GLuint buffer() const { return _buffer; }
+
+		/// Number of times begin_frame had to block on the GPU, the waits of glBufferSubData in the driver are not counted
+		size_t stalls() const { return _stalls; }
+
+	private:
+
+		/// Waits on the fence of a region and deletes it
+		void wait(size_t region);
+
+		bool _persistent;
+		GLuint _buffer = 0;
+		char* _mapped = nullptr;
+		/// CPU copy of the current region when not persistent
+		std::vector<char> _staging;
+		size_t _region_size = 0;
+		size_t _region = 0;
+		size_t _head = 0;
+		size_t _stalls = 0;
+		std::vector<GLsync> _fences;
+	};
+}
\ No newline at end of file
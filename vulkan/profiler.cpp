@@ -0,0 +1,169 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+const size_t profiler::ring_capacity;
+
+profiler& profiler::get()
+{
+	static profiler instance;
+	return instance;
+}
+
+profiler::profiler()
+	: _start(chrono::steady_clock::now()) {}
+
+uint64_t profiler::now() const
+{
+	return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - _start).count());
+}
+
+profiler::ring& profiler::thread_ring()
+{
+	thread_local ring* current = nullptr;
+	if (!current)
+	{
+		lock_guard<mutex> lock(_mutex);
+		_rings.push_back(make_unique<ring>());
+		current = _rings.back().get();
+		current->track = uint32_t(size(_track_names));
+		_track_names.push_back("thread " + to_string(size(_rings) - 1));
+	}
+	return *current;
+}
+
+void profiler::record(const char* name, uint64_t begin, uint64_t end)
+{
+	auto& r = thread_ring();
+	record(name, r.track, begin, end);
+}
+
+void profiler::record(const char* name, uint32_t track, uint64_t begin, uint64_t end)
+{
+	if (_enabled)
+		push(event{ name, track, begin, end, 0., false });
+}
+
+void profiler::counter(const char* name, uint32_t track, uint64_t time, double value)
+{
+	if (_enabled)
+		push(event{ name, track, time, time, value, true });
+}
+
+void profiler::push(const event& e)
+{
+	auto& r = thread_ring();
+	auto head = r.head.load(memory_order_relaxed);
+	r.events[head % ring_capacity] = e;
+	// Publishes the event to write_chrome_trace
+	r.head.store(head + 1, memory_order_release);
+}
+
+uint32_t profiler::add_track(const string& name)
+{
+	lock_guard<mutex> lock(_mutex);
+	_track_names.push_back(name);
+	return uint32_t(size(_track_names) - 1);
+}
+
+void profiler::set_thread_name(const string& name)
+{
+	auto& r = thread_ring();
+	lock_guard<mutex> lock(_mutex);
+	_track_names[r.track] = name;
+}
+
+/// Escapes the characters JSON does not allow in a string
+static string json_string(const string& s)
+{
+	string escaped = "\"";
+	for (auto c : s)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if (static_cast<unsigned char>(c) >= 0x20)
+			escaped += c;
+	}
+	return escaped + "\"";
+}
+
+void profiler::write_chrome_trace(const string& path) const
+{
+	ofstream file(path);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+
+	lock_guard<mutex> lock(_mutex);
+
+	file << "{\"traceEvents\":[\n";
+	auto first = true;
+	auto separate = [&]
+	{
+		if (!first)
+			file << ",\n";
+		first = false;
+	};
+
+	for (size_t track = 0; track < size(_track_names); track++)
+	{
+		separate();
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track << ",\"args\":{\"name\":" << json_string(_track_names[track]) << "}}";
+	}
+
+	file.precision(3);
+	file << fixed;
+	for (auto& r : _rings)
+	{
+		auto head = r->head.load(memory_order_acquire);
+		auto count = min<uint64_t>(head, ring_capacity);
+		for (auto i = head - count; i < head; i++)
+		{
+			auto& e = r->events[i % ring_capacity];
+			separate();
+			// Complete and counter events, the times are in microseconds
+			if (e.counter)
+				file << "{\"name\":" << json_string(e.name) << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << e.track
+					<< ",\"ts\":" << e.begin / 1000. << ",\"args\":{\"value\":" << e.value << "}}";
+			else
+				file << "{\"name\":" << json_string(e.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.track
+					<< ",\"ts\":" << e.begin / 1000. << ",\"dur\":" << (e.end - e.begin) / 1000. << "}";
+		}
+	}
+
+	file << "\n]}\n";
+}
+
+frame_times::frame_times(size_t window)
+	: _times(window), _sorted(window) {}
+
+void frame_times::add(double milliseconds)
+{
+	_times[_next] = milliseconds;
+	_next = (_next + 1) % size(_times);
+	_count = min(_count + 1, size(_times));
+}
+
+double frame_times::percentile(double p)
+{
+	if (_count == 0)
+		return 0.;
+
+	// Nearest rank
+	copy_n(begin(_times), _count, begin(_sorted));
+	auto rank = size_t(ceil(p / 100. * _count));
+	auto index = rank == 0 ? 0 : min(rank, _count) - 1;
+	nth_element(begin(_sorted), begin(_sorted) + index, begin(_sorted) + _count);
+	return _sorted[index];
+}
+
+double frame_times::mean() const
+{
+	double total = 0.;
+	for (size_t i = 0; i < _count; i++)
+		total += _times[i];
+	return _count ? total / _count : 0.;
+}
\ No newline at end of file
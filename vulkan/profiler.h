@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Records timed zones of every thread and exports them as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+ * Each thread writes into its own ring of events without locking, older events are overwritten when it is full.
+ * Zone names must outlive the profiler, string literals in practice
+ */
+class profiler
+{
+public:
+
+	/// A zone of a track in nanoseconds since the profiler started, or a counter value when counter is set
+	struct event
+	{
+		const char* name;
+		uint32_t track;
+		uint64_t begin;
+		uint64_t end;
+		double value;
+		bool counter;
+	};
+
+	/// Events kept per thread
+	static const size_t ring_capacity = 1 << 16;
+
+	static profiler& get();
+
+	/// Nanoseconds since the profiler started
+	uint64_t now() const;
+
+	/// Records a zone on the track of the calling thread
+	void record(const char* name, uint64_t begin, uint64_t end);
+
+	/// Records a zone on another track, like the GPU timeline
+	void record(const char* name, uint32_t track, uint64_t begin, uint64_t end);
+
+	/// Records the value of a counter at a time, like the shader invocations of a GPU frame
+	void counter(const char* name, uint32_t track, uint64_t time, double value);
+
+	/// Adds a named track that is not a thread
+	uint32_t add_track(const std::string& name);
+
+	/// Names the track of the calling thread
+	void set_thread_name(const std::string& name);
+
+	/// Writes the events of every thread, best called when the threads are not recording
+	void write_chrome_trace(const std::string& path) const;
+
+	void set_enabled(bool enabled) { _enabled = enabled; }
+	bool enabled() const { return _enabled; }
+
+private:
+
+	struct ring
+	{
+		std::unique_ptr<event[]> events{ new event[ring_capacity] };
+		/// Number of events written, the writer is the only thread changing it
+		std::atomic<uint64_t> head{ 0 };
+		uint32_t track = 0;
+	};
+
+	profiler();
+
+	/// Ring of the calling thread, created on its first event
+	ring& thread_ring();
+
+	void push(const event& e);
+
+	std::chrono::steady_clock::time_point _start;
+	std::atomic<bool> _enabled{ true };
+
+	/// Guards the list of rings and the track names, not the events
+	mutable std::mutex _mutex;
+	std::vector<std::unique_ptr<ring>> _rings;
+	std::vector<std::string> _track_names;
+};
+
+/// Records the time between its construction and its destruction
+class profile_zone
+{
+public:
+
+	explicit profile_zone(const char* name)
+		: _name(name), _begin(profiler::get().now()) {}
+
+	~profile_zone()
+	{
+		auto& p = profiler::get();
+		if (p.enabled())
+			p.record(_name, _begin, p.now());
+	}
+
+	profile_zone(const profile_zone&) = delete;
+	profile_zone& operator=(const profile_zone&) = delete;
+
+private:
+
+	const char* _name;
+	uint64_t _begin;
+};
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+/// Profiles the rest of the enclosing scope
+#define PROFILE_ZONE(name) profile_zone PROFILE_ZONE_CONCAT(profile_zone_, __LINE__)(name)
+
+/**
+ * Rolling window of the last frame times, for percentiles instead of a mean that hides the hitches
+ */
+class frame_times
+{
+public:
+
+	explicit frame_times(size_t window = 1024);
+
+	void add(double milliseconds);
+
+	/// Frame time below which p percent of the frames of the window are, 0 without frames
+	double percentile(double p);
+
+	double mean() const;
+
+	/// Number of frames in the window
+	size_t count() const { return _count; }
+
+	void clear() { _count = 0; _next = 0; }
+
+private:
+
+	std::vector<double> _times;
+	/// Sorted copy of the times, kept to not allocate when computing percentiles
+	std::vector<double> _sorted;
+	size_t _count = 0;
+	size_t _next = 0;
+};
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include "range_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+range_allocator::range_allocator(size_t capacity)
+{
+	grow(capacity);
+}
+
+size_t range_allocator::allocate(size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	for (auto it = begin(_free); it != end(_free); ++it)
+	{
+		if (it->size < size)
+			continue;
+
+		auto offset = it->offset;
+		it->offset += size;
+		it->size -= size;
+		if (it->size == 0)
+			_free.erase(it);
+
+		_allocations[offset] = size;
+		_used += size;
+		return offset;
+	}
+
+	return invalid;
+}
+
+void range_allocator::free(size_t offset)
+{
+	auto allocation = _allocations.find(offset);
+	if (allocation == end(_allocations))
+		throw runtime_error("Freeing a range that was not allocated");
+
+	auto size = allocation->second;
+	_allocations.erase(allocation);
+	_used -= size;
+
+	auto next = lower_bound(begin(_free), end(_free), offset, [](const range& r, size_t o) { return r.offset < o; });
+	auto merge_next = next != end(_free) && offset + size == next->offset;
+
+	if (next != begin(_free) && prev(next)->offset + prev(next)->size == offset)
+	{
+		auto previous = prev(next);
+		previous->size += size;
+		if (merge_next)
+		{
+			previous->size += next->size;
+			_free.erase(next);
+		}
+	}
+	else if (merge_next)
+	{
+		next->offset = offset;
+		next->size += size;
+	}
+	else
+		_free.insert(next, range{ offset, size });
+}
+
+void range_allocator::grow(size_t capacity)
+{
+	if (capacity <= _capacity)
+		return;
+
+	if (!_free.empty() && _free.back().offset + _free.back().size == _capacity)
+		_free.back().size += capacity - _capacity;
+	else
+		_free.push_back(range{ _capacity, capacity - _capacity });
+
+	_capacity = capacity;
+}
+
+vector<range_allocator::move> range_allocator::compact()
+{
+	vector<move> moves;
+	map<size_t, size_t> allocations;
+	size_t head = 0;
+
+	for (auto& a : _allocations)
+	{
+		if (a.first != head)
+			moves.push_back(move{ a.first, head, a.second });
+		allocations[head] = a.second;
+		head += a.second;
+	}
+
+	_allocations.swap(allocations);
+	_free.clear();
+	if (head < _capacity)
+		_free.push_back(range{ head, _capacity - head });
+
+	return moves;
+}
+
+size_t range_allocator::largest_free() const
+{
+	size_t largest = 0;
+	for (auto& r : _free)
+		largest = max(largest, r.size);
+	return largest;
+}
+
+float range_allocator::fragmentation() const
+{
+	auto free = _capacity - _used;
+	if (free == 0)
+		return 0.f;
+	return 1.f - float(largest_free()) / float(free);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/**
+ * Free-list allocator handing out ranges of elements of a linear resource (e.g. a buffer).
+ * Free ranges are kept sorted by offset and merged with their neighbours when freed
+ */
+class range_allocator
+{
+public:
+
+	/// Returned by allocate when there is no free range large enough
+	static const size_t invalid = size_t(-1);
+
+	/// Range of elements
+	struct range
+	{
+		size_t offset;
+		size_t size;
+	};
+
+	/// Allocation moved by compact
+	struct move
+	{
+		size_t from;
+		size_t to;
+		size_t size;
+	};
+
+	explicit range_allocator(size_t capacity = 0);
+
+	/// Allocates size elements with a first fit, returns invalid if no free range is large enough
+	size_t allocate(size_t size);
+
+	/// Frees the allocation starting at offset
+	void free(size_t offset);
+
+	/// Adds free elements at the end of the resource
+	void grow(size_t capacity);
+
+	/// Packs every allocation at the start of the resource and returns the moves, sorted by offset, to apply to it
+	std::vector<move> compact();
+
+	/// Total number of elements
+	size_t capacity() const { return _capacity; }
+
+	/// Number of allocated elements
+	size_t used() const { return _used; }
+
+	/// Size of the largest free range
+	size_t largest_free() const;
+
+	/// 0 when the free elements are contiguous, tends to 1 when they are scattered in small ranges
+	float fragmentation() const;
+
+private:
+
+	size_t _capacity = 0;
+	size_t _used = 0;
+	/// Free ranges sorted by offset
+	std::vector<range> _free;
+	/// Size of the allocations by offset
+	std::map<size_t, size_t> _allocations;
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <GLFW/glfw3.h>
+#include "frame_pixels.h"
+#include "gpu_stats.h"
+#include "residency_manager.h"
 #include "scene.h"
 
 /**
@@ -15,12 +18,37 @@ public:
 	/// Initializes the renderer
 	virtual void init(GLFWwindow* window) = 0;
 
+	/// Initializes the renderer to draw into offscreen images without a window, the frames are read back to the host
+	virtual void init_headless(uint32_t width, uint32_t height) = 0;
+
 	/// Initializes the scene
 	virtual void init_scene(scene& sc) = 0;
 
+	/// Bytes of streamed meshes uploaded per frame at most, 0 uploads every mesh in init_scene. Set before init_scene
+	virtual void set_upload_budget(size_t bytes) = 0;
+
+	/// Number of meshes still drawn as their bounding box while they are streamed in
+	virtual size_t pending_uploads() const = 0;
+
+	/// Bytes of streamed meshes kept in the geometry pool at most, the least recently drawn ones go back to their box beyond it.
+	/// 0 for no limit, then every mesh is streamed in at once. Set before init_scene
+	virtual void set_memory_budget(size_t bytes) = 0;
+
+	/// Residency of the streamed meshes
+	virtual const residency_stats& memory_stats() const = 0;
+
 	/// Renders the scene
 	virtual void render(const scene& scene) = 0;
 
+	/**
+	 * Oldest headless frame not read back yet, so calling it until it returns false after every render gives every frame in order.
+	 * Returns false if the next frame is still being rendered or the renderer has a window
+	 */
+	virtual bool read_back(frame_pixels& pixels) = 0;
+
+	/// GPU statistics of the latest frame whose queries were read, false if there is none yet
+	virtual bool gpu_stats(gpu_frame_stats& stats) = 0;
+
 	/// Clean's up the scene
 	virtual void cleanup(scene& sc) = 0;
 };
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "residency_manager.h"
+#include "profiler.h"
+#include <algorithm>
+
+using namespace std;
+
+residency_manager::residency_manager()
+	: _track(profiler::get().add_track("Residency")) {}
+
+void residency_manager::set_budget(size_t bytes)
+{
+	_stats.budget = bytes;
+}
+
+void residency_manager::add(resource_handle mesh, size_t bytes)
+{
+	if (mesh.slot >= size(_entries))
+		_entries.resize(mesh.slot + 1);
+
+	auto& e = _entries[mesh.slot];
+	e = entry();
+	e.mesh = mesh;
+	_stats.mesh_count++;
+
+	if (bytes)
+	{
+		e.state = mesh_state::resident;
+		e.bytes = bytes;
+		_stats.resident_bytes += bytes;
+		_stats.resident_meshes++;
+	}
+}
+
+void residency_manager::remove(resource_handle mesh)
+{
+	auto& e = _entries[mesh.slot];
+	if (e.state == mesh_state::resident)
+	{
+		_stats.resident_bytes -= e.bytes;
+		_stats.resident_meshes--;
+	}
+	e = entry();
+	_stats.mesh_count--;
+}
+
+bool residency_manager::request(resource_handle mesh)
+{
+	auto& e = _entries[mesh.slot];
+	if (e.state != mesh_state::absent)
+		return false;
+
+	e.state = mesh_state::requested;
+	e.requested = clock::now();
+	return true;
+}
+
+void residency_manager::made_resident(resource_handle mesh, size_t bytes)
+{
+	auto& e = _entries[mesh.slot];
+	if (e.state == mesh_state::resident)
+		_stats.resident_bytes -= e.bytes;
+	else
+	{
+		_stats.resident_meshes++;
+		_stats.stream_ins++;
+
+		auto latency = chrono::duration<double, milli>(clock::now() - e.requested).count();
+		_stats.total_latency_ms += latency;
+		_stats.max_latency_ms = max(_stats.max_latency_ms, latency);
+	}
+
+	e.state = mesh_state::resident;
+	e.bytes = bytes;
+	_stats.resident_bytes += bytes;
+}
+
+size_t residency_manager::evict(uint64_t frame, vector<resource_handle>& evicted)
+{
+	if (!_stats.budget || _stats.resident_bytes <= _stats.budget)
+		return 0;
+
+	_candidates.clear();
+	for (uint32_t i = 0; i < uint32_t(size(_entries)); i++)
+	{
+		if (_entries[i].state == mesh_state::resident && _entries[i].last_used < frame)
+			_candidates.push_back(i);
+	}
+
+	// When the visible meshes alone are over the budget there is nothing to evict
+	if (_candidates.empty())
+		return 0;
+
+	// A heap of the least recently drawn first, only the evicted meshes are taken out of it
+	auto more_recent = [this](uint32_t a, uint32_t b) { return _entries[a].last_used > _entries[b].last_used; };
+	make_heap(begin(_candidates), end(_candidates), more_recent);
+
+	size_t count = 0;
+	for (auto last = end(_candidates); last != begin(_candidates) && _stats.resident_bytes > _stats.budget; --last)
+	{
+		pop_heap(begin(_candidates), last, more_recent);
+
+		auto& e = _entries[*(last - 1)];
+		_stats.resident_bytes -= e.bytes;
+		_stats.resident_meshes--;
+		_stats.evictions++;
+		e.state = mesh_state::absent;
+		e.bytes = 0;
+		evicted.push_back(e.mesh);
+		count++;
+	}
+
+	return count;
+}
+
+void residency_manager::record_counters() const
+{
+	auto& p = profiler::get();
+	auto time = p.now();
+	p.counter("resident MB", _track, time, double(_stats.resident_bytes) / (1 << 20));
+	p.counter("evictions", _track, time, double(_stats.evictions));
+}
\ No newline at end of file
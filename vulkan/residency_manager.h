@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "resource_table.h"
+
+/// Residency counters of the streamed meshes, cumulative so rates are computed between two reads
+struct residency_stats
+{
+	/// Bytes of the full meshes in the geometry pool, the boxes drawn in place of the others are not counted
+	size_t resident_bytes = 0;
+	/// Bytes the resident meshes are kept under, 0 when there is no limit
+	size_t budget = 0;
+	uint32_t resident_meshes = 0;
+	uint32_t mesh_count = 0;
+	/// Meshes put back to their box to stay under the budget
+	uint64_t evictions = 0;
+	/// Meshes that became resident
+	uint64_t stream_ins = 0;
+	/// Compactions of the geometry pool packing the meshes left scattered by the replacements
+	uint64_t compactions = 0;
+	/// Sum and maximum of the times from the request of a mesh to it becoming resident
+	double total_latency_ms = 0.;
+	double max_latency_ms = 0.;
+};
+
+/**
+ * Tracks which meshes of a renderer are resident, the size of their geometry and the last frame drawing them.
+ * Meshes drawn while not resident are requested, and the least recently drawn ones are evicted when the resident
+ * bytes exceed the budget. The renderer does the streaming and the eviction, the manager only decides.
+ * Meshes are referred to by the handle of their renderer resources
+ */
+class residency_manager
+{
+public:
+
+	residency_manager();
+
+	/// Bytes the resident meshes are kept under, 0 for no limit
+	void set_budget(size_t bytes);
+	size_t budget() const { return _stats.budget; }
+
+	/// Adds a mesh, resident when bytes is not 0
+	void add(resource_handle mesh, size_t bytes = 0);
+
+	void remove(resource_handle mesh);
+
+	/// Requests a mesh that is neither resident nor requested, returns true if the caller must stream it in
+	bool request(resource_handle mesh);
+
+	/// Marks a mesh as drawn by a frame and requests it if it is not resident, see request
+	bool use(resource_handle mesh, uint64_t frame)
+	{
+		_entries[mesh.slot].last_used = frame;
+		return _entries[mesh.slot].state == mesh_state::absent && request(mesh);
+	}
+
+	/// Records that the geometry of a requested mesh is in the geometry pool
+	void made_resident(resource_handle mesh, size_t bytes);
+
+	/// Evicts the least recently drawn meshes until the resident bytes fit the budget, the meshes drawn by frame are kept.
+	/// The evicted meshes are appended to evicted, the caller puts their box back
+	size_t evict(uint64_t frame, std::vector<resource_handle>& evicted);
+
+	/// Records that the renderer compacted its geometry pool
+	void compacted() { _stats.compactions++; }
+
+	/// Records the resident bytes and the evictions as counters of the profiler
+	void record_counters() const;
+
+	const residency_stats& stats() const { return _stats; }
+
+private:
+
+	using clock = std::chrono::steady_clock;
+
+	enum class mesh_state : uint8_t
+	{
+		absent,
+		requested,
+		resident
+	};
+
+	struct entry
+	{
+		resource_handle mesh;
+		mesh_state state = mesh_state::absent;
+		size_t bytes = 0;
+		uint64_t last_used = 0;
+		clock::time_point requested;
+	};
+
+	/// Entries by the slot of the mesh handle
+	std::vector<entry> _entries;
+	/// Resident meshes drawn before the frame, a heap by last use when evicting, kept to reuse its storage
+	std::vector<uint32_t> _candidates;
+	residency_stats _stats;
+	uint32_t _track;
+};
\ No newline at end of file
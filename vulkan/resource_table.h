@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/// Handle to a value of a resource_table, the generation detects handles to removed values
+struct resource_handle
+{
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool empty() const { return slot == UINT32_MAX; }
+};
+
+/**
+ * Values of one type stored contiguously and referred to by generational handles.
+ * Renderers keep their per-mesh, per-pipeline and per-object GPU state in these tables
+ */
+template<typename T>
+class resource_table
+{
+public:
+
+	/// Adds a value and returns its handle
+	resource_handle add(T value)
+	{
+		uint32_t slot;
+		if (_free_slots.empty())
+		{
+			slot = uint32_t(_indices.size());
+			_indices.push_back(0);
+			_generations.push_back(0);
+		}
+		else
+		{
+			slot = _free_slots.back();
+			_free_slots.pop_back();
+		}
+
+		_indices[slot] = uint32_t(_values.size());
+		_values.push_back(std::move(value));
+		_slots.push_back(slot);
+
+		return resource_handle{ slot, _generations[slot] };
+	}
+
+	/// Removes a value, the last value takes its place
+	void remove(resource_handle handle)
+	{
+		auto index = this->index(handle);
+		auto last = uint32_t(_values.size() - 1);
+
+		if (index != last)
+		{
+			_values[index] = std::move(_values[last]);
+			_slots[index] = _slots[last];
+			_indices[_slots[index]] = index;
+		}
+		_values.pop_back();
+		_slots.pop_back();
+
+		_generations[handle.slot]++;
+		_free_slots.push_back(handle.slot);
+	}
+
+	/// Whether the handle refers to a value that has not been removed
+	bool valid(resource_handle handle) const
+	{
+		return handle.slot < _generations.size() && _generations[handle.slot] == handle.generation;
+	}
+
+	T& operator[](resource_handle handle) { return _values[index(handle)]; }
+	const T& operator[](resource_handle handle) const { return _values[index(handle)]; }
+
+	/// Values in no particular order
+	std::vector<T>& values() { return _values; }
+	const std::vector<T>& values() const { return _values; }
+
+	/// Removes every value, the handles given until now become invalid
+	void clear()
+	{
+		for (auto slot : _slots)
+		{
+			_generations[slot]++;
+			_free_slots.push_back(slot);
+		}
+		_values.clear();
+		_slots.clear();
+	}
+
+private:
+
+	uint32_t index(resource_handle handle) const
+	{
+		if (!valid(handle))
+			throw std::runtime_error("Invalid resource handle");
+		return _indices[handle.slot];
+	}
+
+	std::vector<T> _values;
+	/// Slot of the value at every index
+	std::vector<uint32_t> _slots;
+	/// Index of the value in every slot
+	std::vector<uint32_t> _indices;
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _free_slots;
+};
\ No newline at end of file
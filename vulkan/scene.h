@@ -1,7 +1,7 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include "object.h"
+#include "scene_store.h"
 
 struct light
 {
@@ -22,6 +22,5 @@ struct scene
 	light sun;
 	light spot;
 	glm::vec4 eye;
-	std::vector<object> objects;
-	any user_data;
+	scene_store objects;
 };
\ No newline at end of file
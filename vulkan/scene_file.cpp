@@ -0,0 +1,533 @@
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "scene_file.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <glm/gtx/transform.hpp>
+
+using namespace std;
+
+static const char binary_magic[8] = { 'S', 'C', 'E', 'N', 'E', 'B', 'I', 'N' };
+static const uint32_t binary_version = 1;
+/// Alignment of the sections, so the arrays can be read in place from the mapping
+static const uint64_t section_alignment = 16;
+
+/// Header of the binary form, followed by the sections it gives the offsets of. Numbers are stored little endian
+struct binary_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t object_count;
+	uint32_t mesh_count;
+	uint32_t material_count;
+	uint32_t pipeline_count;
+	/// Size of the null terminated paths, the tables refer to them by offset
+	uint32_t string_bytes;
+	scene_camera camera;
+	light lights[3];
+	uint64_t strings;
+	/// One string offset per mesh
+	uint64_t mesh_paths;
+	/// Vertex and fragment shader string offsets per pipeline
+	uint64_t pipeline_paths;
+	uint64_t materials;
+	uint64_t transforms;
+	uint64_t mesh_ids;
+	uint64_t material_ids;
+	uint64_t pipeline_ids;
+};
+
+static_assert(is_trivially_copyable<binary_header>::value, "The header is written and read as bytes");
+
+/// Reads the statements of the text form, with the line of the error in the exceptions
+class scene_parser
+{
+public:
+
+	scene_parser(const string& path, scene_description& description)
+		: _path(path), _description(description) {}
+
+	void parse()
+	{
+		ifstream file(_path);
+		if (!file)
+			throw runtime_error("Can't open " + _path);
+
+		string line;
+		while (getline(file, line))
+		{
+			_line++;
+			auto comment = line.find('#');
+			if (comment != string::npos)
+				line.resize(comment);
+			_tokens = istringstream(line);
+
+			string statement;
+			if (!(_tokens >> statement))
+				continue;
+
+			if (statement == "camera")
+				parse_camera();
+			else if (statement == "light")
+				parse_light();
+			else if (statement == "mesh")
+				parse_mesh();
+			else if (statement == "material")
+				parse_material();
+			else if (statement == "pipeline")
+				parse_pipeline();
+			else if (statement == "object")
+				parse_object();
+			else
+				error("Unknown statement " + statement);
+		}
+	}
+
+private:
+
+	[[noreturn]] void error(const string& message) const
+	{
+		throw runtime_error(_path + ":" + to_string(_line) + ": " + message);
+	}
+
+	string word()
+	{
+		string w;
+		if (!(_tokens >> w))
+			error("Missing value");
+		return w;
+	}
+
+	float number()
+	{
+		float f;
+		if (!(_tokens >> f))
+			error("Expected a number");
+		return f;
+	}
+
+	glm::vec3 vec3()
+	{
+		auto x = number();
+		auto y = number();
+		return glm::vec3(x, y, number());
+	}
+
+	glm::vec4 vec4()
+	{
+		auto v = vec3();
+		return glm::vec4(v, number());
+	}
+
+	/// Index of a name in a table of names
+	uint32_t find(const map<string, uint32_t>& names, const string& kind)
+	{
+		auto name = word();
+		auto it = names.find(name);
+		if (it == end(names))
+			error("Unknown " + kind + " " + name);
+		return it->second;
+	}
+
+	void parse_camera()
+	{
+		auto& camera = _description.camera;
+		string key;
+		while (_tokens >> key)
+		{
+			if (key == "eye")
+				camera.eye = vec3();
+			else if (key == "target")
+				camera.target = vec3();
+			else if (key == "up")
+				camera.up = vec3();
+			else if (key == "fov")
+				camera.fov = number();
+			else if (key == "near")
+				camera.z_near = number();
+			else if (key == "far")
+				camera.z_far = number();
+			else
+				error("Unknown camera key " + key);
+		}
+	}
+
+	void parse_light()
+	{
+		auto kind = word();
+		light* l;
+		if (kind == "point")
+			l = &_description.point;
+		else if (kind == "sun")
+			l = &_description.sun;
+		else if (kind == "spot")
+			l = &_description.spot;
+		else
+			error("Unknown light " + kind);
+
+		string key;
+		while (_tokens >> key)
+		{
+			if (key == "pos")
+				l->pos = glm::vec4(vec3(), 1.f);
+			else if (key == "dir")
+				l->dir = glm::vec4(vec3(), 0.f);
+			else if (key == "ambiant")
+				l->ambiant = vec4();
+			else if (key == "diffuse")
+				l->diffuse = vec4();
+			else if (key == "specular")
+				l->specular = vec4();
+			else if (key == "attenuation")
+				l->attenuation = glm::vec4(vec3(), 0.f);
+			else if (key == "angle")
+				l->angle = glm::vec4(number(), 0.f, 0.f, 0.f);
+			else
+				error("Unknown light key " + key);
+		}
+	}
+
+	void parse_mesh()
+	{
+		auto name = word();
+		auto path = word();
+
+		auto it = _mesh_paths.find(path);
+		if (it == end(_mesh_paths))
+		{
+			it = _mesh_paths.emplace(path, uint32_t(size(_description.meshes))).first;
+			_description.meshes.push_back(path);
+		}
+		_mesh_names[name] = it->second;
+	}
+
+	void parse_material()
+	{
+		auto name = word();
+		material mat = {};
+		string key;
+		while (_tokens >> key)
+		{
+			if (key == "ambiant")
+				mat.ambiant = vec4();
+			else if (key == "diffuse")
+				mat.diffuse = vec4();
+			else if (key == "specular")
+				mat.specular = vec4();
+			else if (key == "hardness")
+				mat.hardness = glm::vec4(number(), 0.f, 0.f, 0.f);
+			else
+				error("Unknown material key " + key);
+		}
+
+		// Materials with the same values share their index, like in the scene_store
+		uint32_t index = 0;
+		while (index < size(_description.materials) && memcmp(&_description.materials[index], &mat, sizeof(material)) != 0)
+			index++;
+		if (index == size(_description.materials))
+			_description.materials.push_back(mat);
+		_material_names[name] = index;
+	}
+
+	void parse_pipeline()
+	{
+		auto name = word();
+		auto vertex = word();
+		auto shaders = make_pair(vertex, word());
+
+		auto& pipelines = _description.pipelines;
+		auto it = std::find(begin(pipelines), end(pipelines), shaders);
+		_pipeline_names[name] = uint32_t(it - begin(pipelines));
+		if (it == end(pipelines))
+			pipelines.push_back(shaders);
+	}
+
+	void parse_object()
+	{
+		_description.mesh_ids.push_back(find(_mesh_names, "mesh"));
+		_description.material_ids.push_back(find(_material_names, "material"));
+		_description.pipeline_ids.push_back(find(_pipeline_names, "pipeline"));
+
+		glm::mat4 trans(1.f);
+		string key;
+		while (_tokens >> key)
+		{
+			if (key == "translate")
+				trans = glm::translate(trans, vec3());
+			else if (key == "rotate")
+			{
+				auto degrees = number();
+				trans = glm::rotate(trans, glm::radians(degrees), vec3());
+			}
+			else if (key == "scale")
+				trans = glm::scale(trans, vec3());
+			else
+				error("Unknown transform " + key);
+		}
+		_description.transforms.push_back(trans);
+	}
+
+	string _path;
+	scene_description& _description;
+	size_t _line = 0;
+	istringstream _tokens;
+	map<string, uint32_t> _mesh_names;
+	map<string, uint32_t> _material_names;
+	map<string, uint32_t> _pipeline_names;
+	/// Index of every mesh path, a path is loaded once even under several names
+	map<string, uint32_t> _mesh_paths;
+};
+
+scene_description parse_scene_text(const string& path)
+{
+	scene_description description;
+	scene_parser(path, description).parse();
+	return description;
+}
+
+void write_scene_binary(const scene_description& description, const string& path)
+{
+	auto object_count = size(description.transforms);
+	if (size(description.mesh_ids) != object_count || size(description.material_ids) != object_count || size(description.pipeline_ids) != object_count)
+		throw runtime_error("The object arrays of the scene have different sizes");
+
+	// Paths are stored once, null terminated
+	string strings;
+	auto add_string = [&](const string& s)
+	{
+		auto offset = uint32_t(size(strings));
+		strings.append(s);
+		strings.push_back('\0');
+		return offset;
+	};
+	vector<uint32_t> mesh_paths;
+	for (auto& m : description.meshes)
+		mesh_paths.push_back(add_string(m));
+	vector<uint32_t> pipeline_paths;
+	for (auto& p : description.pipelines)
+	{
+		pipeline_paths.push_back(add_string(p.first));
+		pipeline_paths.push_back(add_string(p.second));
+	}
+
+	binary_header header = {};
+	memcpy(header.magic, binary_magic, sizeof(binary_magic));
+	header.version = binary_version;
+	header.object_count = uint32_t(object_count);
+	header.mesh_count = uint32_t(size(description.meshes));
+	header.material_count = uint32_t(size(description.materials));
+	header.pipeline_count = uint32_t(size(description.pipelines));
+	header.string_bytes = uint32_t(size(strings));
+	header.camera = description.camera;
+	header.lights[0] = description.point;
+	header.lights[1] = description.sun;
+	header.lights[2] = description.spot;
+
+	// Sections in order, each aligned
+	struct section
+	{
+		uint64_t* offset;
+		const void* data;
+		size_t bytes;
+	};
+	section sections[] =
+	{
+		{ &header.strings, strings.data(), size(strings) },
+		{ &header.mesh_paths, mesh_paths.data(), size(mesh_paths) * sizeof(uint32_t) },
+		{ &header.pipeline_paths, pipeline_paths.data(), size(pipeline_paths) * sizeof(uint32_t) },
+		{ &header.materials, description.materials.data(), size(description.materials) * sizeof(material) },
+		{ &header.transforms, description.transforms.data(), object_count * sizeof(glm::mat4) },
+		{ &header.mesh_ids, description.mesh_ids.data(), object_count * sizeof(uint32_t) },
+		{ &header.material_ids, description.material_ids.data(), object_count * sizeof(uint32_t) },
+		{ &header.pipeline_ids, description.pipeline_ids.data(), object_count * sizeof(uint32_t) },
+	};
+
+	uint64_t offset = sizeof(binary_header);
+	for (auto& s : sections)
+	{
+		offset = (offset + section_alignment - 1) / section_alignment * section_alignment;
+		*s.offset = offset;
+		offset += s.bytes;
+	}
+
+	ofstream file(path, ios::binary);
+	if (!file)
+		throw runtime_error("Can't open " + path);
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t position = sizeof(binary_header);
+	const char padding[section_alignment] = {};
+	for (auto& s : sections)
+	{
+		file.write(padding, *s.offset - position);
+		file.write(static_cast<const char*>(s.data), s.bytes);
+		position = *s.offset + s.bytes;
+	}
+
+	if (!file)
+		throw runtime_error("Can't write " + path);
+}
+
+/// Sets the view and the projection from the camera, the projection is flipped for Vulkan
+static void set_camera(scene& sc, const scene_camera& camera, const string& renderer_name, float aspect)
+{
+	sc.projection = glm::perspective<float>(glm::radians(camera.fov), aspect, camera.z_near, camera.z_far);
+	sc.view = glm::lookAt(camera.eye, camera.target, camera.up);
+	if (renderer_name == "vulkan")
+		sc.projection[1][1] *= -1;
+	sc.eye = glm::vec4(camera.eye, 1);
+}
+
+/// Replaces {renderer} in a shader path
+static string shader_path(string path, const string& renderer_name)
+{
+	static const string placeholder = "{renderer}";
+	auto position = path.find(placeholder);
+	if (position != string::npos)
+		path.replace(position, size(placeholder), renderer_name);
+	return path;
+}
+
+/// Adds the tables of a scene file to the store, their ids must stay the indices of the file
+static void add_tables(scene_store& store, const vector<string>& meshes, const material* materials, size_t material_count,
+	const vector<pair<string, string>>& pipelines, const string& renderer_name, mesh_cache& cache)
+{
+	// The files missing from the cache are loaded on worker threads, the first error is thrown once they are done
+	{
+		vector<string> missing;
+		for (auto& path : meshes)
+		{
+			if (!cache[path] && find(begin(missing), end(missing), path) == end(missing))
+				missing.push_back(path);
+		}
+
+		vector<shared_ptr<model>> loaded(size(missing));
+		vector<exception_ptr> errors(size(missing));
+		if (!missing.empty())
+		{
+			thread_pool pool(min(size(missing), size_t(max(1u, thread::hardware_concurrency()))));
+			for (size_t i = 0; i < size(missing); i++)
+			{
+				pool.submit([&, i]
+				{
+					try
+					{
+						loaded[i] = make_shared<model>(load_model_from_file(missing[i]));
+					}
+					catch (...)
+					{
+						errors[i] = current_exception();
+					}
+				});
+			}
+		}
+
+		for (size_t i = 0; i < size(missing); i++)
+		{
+			if (errors[i])
+				rethrow_exception(errors[i]);
+			cache[missing[i]] = loaded[i];
+		}
+	}
+
+	for (size_t i = 0; i < size(meshes); i++)
+	{
+		if (store.add_mesh(cache[meshes[i]]) != i)
+			throw runtime_error("Mesh " + meshes[i] + " is listed twice");
+	}
+
+	for (size_t i = 0; i < material_count; i++)
+	{
+		if (store.add_material(materials[i]) != i)
+			throw runtime_error("Material " + to_string(i) + " is listed twice");
+	}
+
+	for (size_t i = 0; i < size(pipelines); i++)
+	{
+		pipeline p;
+		p.vertex_shader.filename = shader_path(pipelines[i].first, renderer_name);
+		p.fragment_shader.filename = shader_path(pipelines[i].second, renderer_name);
+		if (store.add_pipeline(p) != i)
+			throw runtime_error("Pipeline " + p.vertex_shader.filename + " " + p.fragment_shader.filename + " is listed twice");
+	}
+}
+
+/// Loads the binary form, the object arrays are copied from the mapping without going through the objects one by one
+static unique_ptr<scene> load_scene_binary(const mapped_file& file, const string& path, const string& renderer_name, float aspect, mesh_cache& cache)
+{
+	binary_header header;
+	memcpy(&header, file.bytes(), sizeof(header));
+	if (header.version != binary_version)
+		throw runtime_error(path + " has version " + to_string(header.version) + ", expected " + to_string(binary_version));
+
+	auto section = [&](uint64_t offset, uint64_t count, uint64_t element_size)
+	{
+		if (offset % section_alignment != 0 || offset > file.length() || count > (file.length() - offset) / element_size)
+			throw runtime_error(path + " is truncated or corrupted");
+		return file.bytes() + offset;
+	};
+
+	auto* strings = reinterpret_cast<const char*>(section(header.strings, header.string_bytes, 1));
+	if (header.string_bytes > 0 && strings[header.string_bytes - 1] != '\0')
+		throw runtime_error(path + " is truncated or corrupted");
+	auto string_at = [&](uint32_t offset)
+	{
+		if (offset >= header.string_bytes)
+			throw runtime_error(path + " is truncated or corrupted");
+		return string(strings + offset);
+	};
+
+	auto* mesh_paths = reinterpret_cast<const uint32_t*>(section(header.mesh_paths, header.mesh_count, sizeof(uint32_t)));
+	auto* pipeline_paths = reinterpret_cast<const uint32_t*>(section(header.pipeline_paths, header.pipeline_count * uint64_t(2), sizeof(uint32_t)));
+	auto* materials = reinterpret_cast<const material*>(section(header.materials, header.material_count, sizeof(material)));
+	auto* transforms = reinterpret_cast<const glm::mat4*>(section(header.transforms, header.object_count, sizeof(glm::mat4)));
+	auto* mesh_ids = reinterpret_cast<const uint32_t*>(section(header.mesh_ids, header.object_count, sizeof(uint32_t)));
+	auto* material_ids = reinterpret_cast<const uint32_t*>(section(header.material_ids, header.object_count, sizeof(uint32_t)));
+	auto* pipeline_ids = reinterpret_cast<const uint32_t*>(section(header.pipeline_ids, header.object_count, sizeof(uint32_t)));
+
+	vector<string> meshes;
+	for (uint32_t i = 0; i < header.mesh_count; i++)
+		meshes.push_back(string_at(mesh_paths[i]));
+	vector<pair<string, string>> pipelines;
+	for (uint32_t i = 0; i < header.pipeline_count; i++)
+		pipelines.emplace_back(string_at(pipeline_paths[2 * i]), string_at(pipeline_paths[2 * i + 1]));
+
+	auto sc = make_unique<scene>();
+	set_camera(*sc, header.camera, renderer_name, aspect);
+	sc->point = header.lights[0];
+	sc->sun = header.lights[1];
+	sc->spot = header.lights[2];
+
+	add_tables(sc->objects, meshes, materials, header.material_count, pipelines, renderer_name, cache);
+	sc->objects.add(header.object_count, transforms, mesh_ids, material_ids, pipeline_ids);
+	return sc;
+}
+
+unique_ptr<scene> load_scene(const string& path, const string& renderer_name, float aspect, mesh_cache& cache)
+{
+	{
+		mapped_file file(path);
+		if (file.length() >= sizeof(binary_header) && memcmp(file.bytes(), binary_magic, sizeof(binary_magic)) == 0)
+			return load_scene_binary(file, path, renderer_name, aspect, cache);
+	}
+
+	auto description = parse_scene_text(path);
+
+	auto sc = make_unique<scene>();
+	set_camera(*sc, description.camera, renderer_name, aspect);
+	sc->point = description.point;
+	sc->sun = description.sun;
+	sc->spot = description.spot;
+
+	add_tables(sc->objects, description.meshes, description.materials.data(), size(description.materials), description.pipelines, renderer_name, cache);
+	sc->objects.add(size(description.transforms), description.transforms.data(), description.mesh_ids.data(), description.material_ids.data(), description.pipeline_ids.data());
+	return sc;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "scene.h"
+
+/// Camera of a scene file, the projection is built for the aspect and the renderer when the scene is loaded
+struct scene_camera
+{
+	glm::vec3 eye = glm::vec3(15, 15, 15);
+	glm::vec3 target = glm::vec3(0, 0, 0);
+	glm::vec3 up = glm::vec3(0, 1, 0);
+	/// Vertical field of view in degrees
+	float fov = 70.f;
+	float z_near = 0.1f;
+	float z_far = 1000.f;
+};
+
+/**
+ * Contents of a scene file, with the tables deduplicated: meshes by path, materials by value and pipelines by shaders.
+ * Objects are stored as arrays of transforms and of indices in the tables, like in the scene_store
+ */
+struct scene_description
+{
+	scene_camera camera;
+	light point;
+	light sun;
+	light spot;
+	/// Paths of the mesh files
+	std::vector<std::string> meshes;
+	std::vector<material> materials;
+	/// Paths of the vertex and fragment shaders, {renderer} stands for the name of the renderer
+	std::vector<std::pair<std::string, std::string>> pipelines;
+	std::vector<glm::mat4> transforms;
+	std::vector<uint32_t> mesh_ids;
+	std::vector<uint32_t> material_ids;
+	std::vector<uint32_t> pipeline_ids;
+};
+
+/// Meshes by path, so a mesh is loaded once and shared by the scenes loaded with the same cache
+using mesh_cache = std::unordered_map<std::string, std::shared_ptr<model>>;
+
+/**
+ * Parses the text form, one statement per line and # starting a comment:
+ *   camera [eye x y z] [target x y z] [up x y z] [fov degrees] [near z] [far z]
+ *   light point|sun|spot [pos x y z] [dir x y z] [ambiant r g b a] [diffuse r g b a] [specular r g b a] [attenuation c l q] [angle radians]
+ *   mesh <name> <path>
+ *   material <name> [ambiant r g b a] [diffuse r g b a] [specular r g b a] [hardness h]
+ *   pipeline <name> <vertex shader> <fragment shader>
+ *   object <mesh> <material> <pipeline> [translate x y z] [rotate degrees x y z] [scale x y z]...
+ * The transforms of an object are applied in order, like the methods of object
+ */
+scene_description parse_scene_text(const std::string& path);
+
+/// Writes the binary form, which load_scene maps and copies into the scene arrays without parsing the objects
+void write_scene_binary(const scene_description& description, const std::string& path);
+
+/// Loads a scene in the text or the binary form, the binary form is recognized by its header
+std::unique_ptr<scene> load_scene(const std::string& path, const std::string& renderer_name, float aspect, mesh_cache& cache);
\ No newline at end of file
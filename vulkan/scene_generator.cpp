@@ -0,0 +1,227 @@
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include "scene_generator.h"
+#include <cmath>
+#include <stdexcept>
+#include <glm/gtx/transform.hpp>
+
+using namespace std;
+
+namespace
+{
+	/// xorshift64* generator, its sequence only depends on the seed
+	class random_generator
+	{
+	public:
+
+		explicit random_generator(uint64_t seed)
+		{
+			// splitmix64 spreads close seeds over the state and never gives 0
+			seed += 0x9e3779b97f4a7c15ull;
+			seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9ull;
+			seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebull;
+			_state = (seed ^ (seed >> 31)) | 1;
+		}
+
+		uint64_t next()
+		{
+			_state ^= _state >> 12;
+			_state ^= _state << 25;
+			_state ^= _state >> 27;
+			return _state * 0x2545f4914f6cdd1dull;
+		}
+
+		/// Uniform in [0, 1)
+		float uniform() { return (next() >> 40) / float(1 << 24); }
+
+		float uniform(float min, float max) { return min + (max - min) * uniform(); }
+
+		/// Uniform in [0, count)
+		uint32_t index(uint32_t count) { return uint32_t((next() >> 32) * count >> 32); }
+
+		/// Standard normal from the Box-Muller transform
+		float normal()
+		{
+			auto u = 1.f - uniform();
+			auto v = uniform();
+			return sqrt(-2.f * log(u)) * cos(6.28318530718f * v);
+		}
+
+		/// Uniform on the unit sphere
+		glm::vec3 direction()
+		{
+			auto z = uniform(-1.f, 1.f);
+			auto a = uniform(0.f, 6.28318530718f);
+			auto r = sqrt(max(0.f, 1.f - z * z));
+			return glm::vec3(r * cos(a), r * sin(a), z);
+		}
+
+	private:
+
+		uint64_t _state;
+	};
+}
+
+scene_generator::scene_generator(const scene_parameters& params)
+	: _params(params)
+{
+	if (_params.count == 0 || _params.mesh_count == 0 || _params.mesh_kinds.empty() || _params.material_count == 0)
+		throw runtime_error("A generated scene needs objects, meshes and materials");
+	if (_params.light_count > 3)
+		throw runtime_error("A scene has at most 3 lights");
+
+	create_meshes();
+	create_materials();
+}
+
+void scene_generator::create_meshes()
+{
+	// Each kind is tessellated to about the triangle budget: 2 * rings * segments triangles for spheres and tori,
+	// 2 * cells² for the terrains
+	auto rings = max(3u, uint32_t(round(sqrt(_params.triangles / 4.))));
+	auto cells = max(1u, uint32_t(round(sqrt(_params.triangles / 2.))));
+
+	random_generator rng(_params.seed ^ 0x6d657368u);
+	for (uint32_t i = 0; i < _params.mesh_count; i++)
+	{
+		model m;
+		switch (_params.mesh_kinds[i % size(_params.mesh_kinds)])
+		{
+		case mesh_kind::sphere:
+			m = create_sphere(rings, rings * 2);
+			break;
+		case mesh_kind::torus:
+			m = create_torus(rings * 2, rings, rng.uniform(0.15f, 0.4f));
+			break;
+		case mesh_kind::terrain:
+			m = create_terrain(cells, uint32_t(rng.next()), rng.uniform(0.2f, 0.6f));
+			break;
+		}
+		_meshes.push_back(make_shared<model>(move(m)));
+	}
+}
+
+void scene_generator::create_materials()
+{
+	random_generator rng(_params.seed ^ 0x6d617465u);
+	_materials.resize(_params.material_count);
+	for (uint32_t i = 0; i < _params.material_count; i++)
+	{
+		// Hues spread around the color wheel, so every material differs
+		auto hue = 6.f * i / _params.material_count;
+		auto color = glm::clamp(glm::abs(glm::mod(glm::vec3(hue) + glm::vec3(0, 4, 2), 6.f) - 3.f) - 1.f, 0.f, 1.f);
+		auto& m = _materials[i];
+		m.ambiant = glm::vec4(color, 1);
+		m.diffuse = glm::vec4(color, 1);
+		m.specular = glm::vec4(glm::vec3(rng.uniform(0.2f, 1.f)), 1);
+		m.hardness.x = rng.uniform(2.f, 64.f);
+	}
+}
+
+void scene_generator::set_camera_and_lights(scene& sc) const
+{
+	auto extent = _params.extent;
+	auto eye = glm::vec3(extent * 1.5f);
+
+	sc.projection = glm::perspective<float>(glm::radians<float>(70), _params.aspect, 0.1f, extent * 5.f);
+	sc.view = glm::lookAt(eye, glm::vec3(), glm::vec3(0, 1, 0));
+	if (_params.renderer_name == "vulkan")
+		sc.projection[1][1] *= -1;
+	sc.eye = glm::vec4(eye, 1);
+
+	// The lights left out stay black
+	if (_params.light_count >= 1)
+	{
+		sc.point.ambiant = glm::vec4(0.4, 0.4, 0.4, 1);
+		sc.point.diffuse = glm::vec4(1, 1, 1, 1);
+		sc.point.specular = glm::vec4(0.2, 0.2, 0.2, 1);
+		sc.point.pos = glm::vec4(0, extent * 1.2f, 0, 1);
+		sc.point.attenuation = glm::vec4(1, 0, 0, 0);
+	}
+	if (_params.light_count >= 2)
+	{
+		sc.sun.ambiant = glm::vec4(0.1, 0.1, 0.1, 1);
+		sc.sun.diffuse = glm::vec4(0.8, 0.8, 0.7, 1);
+		sc.sun.specular = glm::vec4(0.2, 0.2, 0.2, 1);
+		sc.sun.dir = glm::vec4(glm::normalize(glm::vec3(-1, -2, -1)), 0);
+	}
+	if (_params.light_count >= 3)
+	{
+		sc.spot.ambiant = glm::vec4(0, 0, 0, 1);
+		sc.spot.diffuse = glm::vec4(1, 1, 1, 1);
+		sc.spot.specular = glm::vec4(0.5, 0.5, 0.5, 1);
+		sc.spot.pos = glm::vec4(eye, 1);
+		sc.spot.dir = glm::vec4(-glm::normalize(eye), 0);
+		sc.spot.attenuation = glm::vec4(1, 0, 0, 0);
+		sc.spot.angle = glm::vec4(glm::radians(20.f), 0, 0, 0);
+	}
+}
+
+unique_ptr<scene> scene_generator::generate()
+{
+	auto sc = make_unique<scene>();
+	set_camera_and_lights(*sc);
+	_animated.clear();
+	_hierarchy = transform_hierarchy();
+
+	random_generator rng(_params.seed);
+	auto extent = _params.extent;
+	auto side = uint32_t(ceil(cbrt(double(_params.count))));
+	auto spacing = 2.f * extent / side;
+
+	vector<glm::vec3> centers(_params.cluster_count);
+	for (auto& c : centers)
+		c = glm::vec3(rng.uniform(-extent, extent), rng.uniform(-extent, extent), rng.uniform(-extent, extent));
+	auto cluster_radius = extent / cbrt(float(max(1u, _params.cluster_count))) * 0.25f;
+
+	object obj;
+	obj.vertex_shader.filename = "shaders/sphere_" + _params.renderer_name + ".vert";
+	obj.fragment_shader.filename = "shaders/sphere_" + _params.renderer_name + ".frag";
+
+	sc->objects.reserve(_params.count);
+	for (uint32_t i = 0; i < _params.count; i++)
+	{
+		glm::vec3 position;
+		switch (_params.distribution)
+		{
+		case spatial_distribution::grid:
+			position = (glm::vec3(i % side, i / side % side, i / (side * side)) + 0.5f) * spacing - extent;
+			break;
+		case spatial_distribution::uniform:
+			position = glm::vec3(rng.uniform(-extent, extent), rng.uniform(-extent, extent), rng.uniform(-extent, extent));
+			break;
+		case spatial_distribution::clusters:
+			position = centers.empty() ? glm::vec3() : centers[rng.index(uint32_t(size(centers)))];
+			position += glm::vec3(rng.normal(), rng.normal(), rng.normal()) * cluster_radius;
+			break;
+		}
+
+		auto axis = rng.direction();
+		auto angle = rng.uniform(0.f, 6.28318530718f);
+		auto scale = rng.uniform(_params.min_scale, _params.max_scale);
+		obj.trans = glm::translate(position) * glm::rotate(angle, axis) * glm::scale(glm::vec3(scale));
+		obj.model = _meshes[rng.index(uint32_t(size(_meshes)))];
+		obj.material = _materials[rng.index(uint32_t(size(_materials)))];
+
+		auto handle = sc->objects.add(obj);
+		if (rng.uniform() < _params.animated_fraction)
+		{
+			_animated.push_back(animation{ handle, rng.direction(), rng.uniform(0.5f, 2.f) });
+			auto node = _hierarchy.create();
+			_hierarchy.set_translation(node, position);
+			_hierarchy.set_rotation(node, glm::angleAxis(angle, axis));
+			_hierarchy.set_scale(node, glm::vec3(scale));
+		}
+	}
+
+	return sc;
+}
+
+void scene_generator::animate(scene& sc, float seconds)
+{
+	for (uint32_t node = 0; node < uint32_t(size(_animated)); node++)
+		_hierarchy.rotate(node, _animated[node].speed * seconds, _animated[node].axis);
+
+	_hierarchy.update();
+	for (auto node : _hierarchy.updated())
+		sc.objects.set_transform(sc.objects.index(_animated[node].handle), _hierarchy.world(node));
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "scene.h"
+#include "transform_hierarchy.h"
+
+/// How the generated objects are spread in the cube of the scene
+enum class spatial_distribution
+{
+	/// Regular cubic grid filled in order
+	grid,
+	/// Uniformly random in the cube
+	uniform,
+	/// Normally distributed around random cluster centers
+	clusters
+};
+
+/// Procedural meshes of the mesh pool
+enum class mesh_kind
+{
+	sphere,
+	torus,
+	terrain
+};
+
+/// Parameters of a generated scene, the same parameters and seed always give the same scene
+struct scene_parameters
+{
+	uint32_t seed = 1;
+	uint32_t count = 1000;
+	spatial_distribution distribution = spatial_distribution::uniform;
+	/// Half size of the cube centered on the origin the objects are placed in
+	float extent = 100.f;
+	/// Number of clusters of the clusters distribution
+	uint32_t cluster_count = 16;
+	/// Scale of the objects is uniformly random between these, 1 is a mesh of radius about 1
+	float min_scale = 0.5f;
+	float max_scale = 1.5f;
+	/// Kinds of the meshes of the pool, taken in turn
+	std::vector<mesh_kind> mesh_kinds = { mesh_kind::sphere, mesh_kind::torus, mesh_kind::terrain };
+	/// Number of distinct meshes the objects choose from
+	uint32_t mesh_count = 3;
+	/// Approximate number of triangles of every mesh
+	uint32_t triangles = 512;
+	/// Number of distinct materials the objects choose from
+	uint32_t material_count = 16;
+	/// Fraction of the objects animate rotates
+	float animated_fraction = 0.f;
+	/// Lights of the scene, up to 3: the point light, then the sun, then the spot
+	uint32_t light_count = 1;
+	/// Renderer drawing the scene, which selects its shaders and the orientation of the projection
+	std::string renderer_name = "vulkan";
+	float aspect = 1.f;
+};
+
+/**
+ * Builds scenes of procedural meshes from a seed, with up to millions of objects.
+ * The random numbers come from a fixed generator rather than the standard distributions, whose results depend on the library,
+ * so a seed gives the same scene on every platform
+ */
+class scene_generator
+{
+public:
+
+	explicit scene_generator(const scene_parameters& params);
+
+	/// Builds the scene, the camera looks at the center of the cube from one of its corners
+	std::unique_ptr<scene> generate();
+
+	/// Rotates the animated objects of the last generated scene by their angular speed for a time step,
+	/// the transforms of the moved objects are updated in the scene before it is culled
+	void animate(scene& sc, float seconds);
+
+	/// Meshes of the pool
+	const std::vector<std::shared_ptr<model>>& meshes() const { return _meshes; }
+
+	/// Number of animated objects
+	size_t animated_count() const { return _animated.size(); }
+
+private:
+
+	/// Rotation of an animated object
+	struct animation
+	{
+		object_handle handle;
+		glm::vec3 axis;
+		/// Radians per second
+		float speed;
+	};
+
+	void create_meshes();
+	void create_materials();
+	void set_camera_and_lights(scene& sc) const;
+
+	scene_parameters _params;
+	std::vector<std::shared_ptr<model>> _meshes;
+	std::vector<material> _materials;
+	/// Animations in the order of their nodes in the hierarchy
+	std::vector<animation> _animated;
+	/// Local transforms of the animated objects, a node for every animation
+	transform_hierarchy _hierarchy;
+};
\ No newline at end of file
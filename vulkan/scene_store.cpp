@@ -0,0 +1,199 @@
+#include "scene_store.h"
+#include <algorithm>
+#include <stdexcept>
+#include <glm/gtx/transform.hpp>
+
+using namespace std;
+
+template<typename T, typename Lookup, typename Key>
+uint32_t scene_store::find_or_add(vector<T>& table, Lookup& lookup, const Key& key, const T& value)
+{
+	auto it = lookup.find(key);
+	if (it != end(lookup))
+		return it->second;
+
+	auto index = uint32_t(size(table));
+	table.push_back(value);
+	lookup.emplace(key, index);
+	return index;
+}
+
+object_handle scene_store::add(const object& obj)
+{
+	uint32_t slot;
+	if (_free_slots.empty())
+	{
+		slot = uint32_t(size(_indices));
+		_indices.push_back(0);
+		_generations.push_back(0);
+	}
+	else
+	{
+		slot = _free_slots.back();
+		_free_slots.pop_back();
+	}
+
+	auto index = uint32_t(count());
+	_indices[slot] = index;
+	_slots.push_back(slot);
+
+	_transforms.push_back(obj.trans);
+	_spheres.push_back(obj.model->bounding_sphere);
+	_boxes.push_back(obj.model->box);
+	_mesh_ids.push_back(add_mesh(obj.model));
+	_material_ids.push_back(add_material(obj.material));
+	_pipeline_ids.push_back(add_pipeline(pipeline{ obj.vertex_shader, obj.fragment_shader, resource_handle() }));
+	_resources.emplace_back();
+
+	_moved_flags.push_back(0);
+	mark_moved(index);
+
+	return object_handle{ slot, _generations[slot] };
+}
+
+uint32_t scene_store::add_mesh(const shared_ptr<model>& mesh)
+{
+	return find_or_add(_meshes, _mesh_lookup, mesh.get(), mesh);
+}
+
+uint32_t scene_store::add_material(const material& mat)
+{
+	return find_or_add(_materials, _material_lookup, mat, mat);
+}
+
+uint32_t scene_store::add_pipeline(const pipeline& p)
+{
+	return find_or_add(_pipelines, _pipeline_lookup, make_pair(p.vertex_shader.filename, p.fragment_shader.filename), p);
+}
+
+void scene_store::add(size_t count, const glm::mat4* transforms, const uint32_t* mesh_ids, const uint32_t* material_ids, const uint32_t* pipeline_ids)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		if (mesh_ids[i] >= size(_meshes) || material_ids[i] >= size(_materials) || pipeline_ids[i] >= size(_pipelines))
+			throw runtime_error("Invalid object id");
+	}
+
+	// New slots are taken in order, the free slots of removed objects are left for the next single adds
+	auto first = uint32_t(this->count());
+	auto first_slot = uint32_t(size(_indices));
+	reserve(first + count);
+
+	_transforms.insert(end(_transforms), transforms, transforms + count);
+	_mesh_ids.insert(end(_mesh_ids), mesh_ids, mesh_ids + count);
+	_material_ids.insert(end(_material_ids), material_ids, material_ids + count);
+	_pipeline_ids.insert(end(_pipeline_ids), pipeline_ids, pipeline_ids + count);
+	_resources.resize(first + count);
+	_generations.resize(first_slot + count, 0);
+	_moved_flags.resize(first + count, 1);
+
+	for (uint32_t i = 0; i < uint32_t(count); i++)
+	{
+		auto& mesh = *_meshes[mesh_ids[i]];
+		_spheres.push_back(mesh.bounding_sphere);
+		_boxes.push_back(mesh.box);
+		_slots.push_back(first_slot + i);
+		_indices.push_back(first + i);
+		_moved.push_back(first + i);
+	}
+}
+
+void scene_store::remove(object_handle handle)
+{
+	auto index = this->index(handle);
+	auto last = uint32_t(count() - 1);
+
+	auto swap_remove = [&](auto& column)
+	{
+		if (index != last)
+			column[index] = move(column[last]);
+		column.pop_back();
+	};
+
+	// The moved list refers to indices, the removed object leaves it and the last one takes its index
+	_moved.erase(std::remove(begin(_moved), end(_moved), index), end(_moved));
+	replace(begin(_moved), end(_moved), last, index);
+
+	swap_remove(_transforms);
+	swap_remove(_spheres);
+	swap_remove(_boxes);
+	swap_remove(_mesh_ids);
+	swap_remove(_material_ids);
+	swap_remove(_pipeline_ids);
+	swap_remove(_moved_flags);
+	swap_remove(_resources);
+	swap_remove(_slots);
+
+	if (index != last)
+		_indices[_slots[index]] = index;
+
+	_generations[handle.slot]++;
+	_free_slots.push_back(handle.slot);
+}
+
+void scene_store::reserve(size_t count)
+{
+	_transforms.reserve(count);
+	_spheres.reserve(count);
+	_boxes.reserve(count);
+	_mesh_ids.reserve(count);
+	_material_ids.reserve(count);
+	_pipeline_ids.reserve(count);
+	_moved_flags.reserve(count);
+	_resources.reserve(count);
+	_slots.reserve(count);
+	_indices.reserve(count);
+	_generations.reserve(count);
+	_moved.reserve(count);
+}
+
+bool scene_store::valid(object_handle handle) const
+{
+	return handle.slot < size(_generations) && _generations[handle.slot] == handle.generation;
+}
+
+uint32_t scene_store::index(object_handle handle) const
+{
+	if (!valid(handle))
+		throw runtime_error("Invalid object handle");
+	return _indices[handle.slot];
+}
+
+void scene_store::mark_moved(uint32_t index)
+{
+	if (_moved_flags[index])
+		return;
+	_moved_flags[index] = 1;
+	_moved.push_back(index);
+}
+
+void scene_store::clear_moved()
+{
+	for (auto i : _moved)
+		_moved_flags[i] = 0;
+	_moved.clear();
+}
+
+void scene_store::set_transform(uint32_t index, const glm::mat4& trans)
+{
+	_transforms[index] = trans;
+	mark_moved(index);
+}
+
+void scene_store::translate(object_handle handle, const glm::vec3& v)
+{
+	auto i = index(handle);
+	set_transform(i, glm::translate(_transforms[i], v));
+}
+
+void scene_store::rotate(object_handle handle, float a, const glm::vec3& v)
+{
+	auto i = index(handle);
+	set_transform(i, glm::rotate(_transforms[i], a, v));
+}
+
+void scene_store::scale(object_handle handle, const glm::vec3& v)
+{
+	auto i = index(handle);
+	set_transform(i, glm::scale(_transforms[i], v));
+}
\ No newline at end of file
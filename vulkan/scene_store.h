@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "aligned_allocator.h"
+#include "object.h"
+
+/// Handle to an object of a scene_store, the generation detects handles to removed objects
+struct object_handle
+{
+	uint32_t slot = UINT32_MAX;
+	uint32_t generation = 0;
+};
+
+/// Shaders drawing an object
+struct pipeline
+{
+	shader vertex_shader;
+	shader fragment_shader;
+	/// Resources of the renderer for the pipeline
+	resource_handle resource;
+};
+
+/**
+ * Objects of a scene stored as dense arrays, one per component.
+ * Removing an object moves the last one in its place, so the loops over the objects only touch the arrays they need.
+ * Meshes, materials and pipelines are shared by the objects and referred to by their index
+ */
+class scene_store
+{
+public:
+
+	/// Adds an object, its model, material and shaders are shared with the objects that already use them
+	object_handle add(const object& obj);
+
+	/// Id of a mesh, material or pipeline, added if no object uses it yet
+	uint32_t add_mesh(const std::shared_ptr<model>& mesh);
+	uint32_t add_material(const material& mat);
+	uint32_t add_pipeline(const pipeline& p);
+
+	/// Adds count objects from arrays of transforms and of the ids given by add_mesh, add_material and add_pipeline
+	void add(size_t count, const glm::mat4* transforms, const uint32_t* mesh_ids, const uint32_t* material_ids, const uint32_t* pipeline_ids);
+
+	/// Removes an object, the last object takes its index
+	void remove(object_handle handle);
+
+	/// Allocates the arrays for a number of objects, so adding that many does not reallocate
+	void reserve(size_t count);
+
+	/// Whether the handle refers to an object that has not been removed
+	bool valid(object_handle handle) const;
+
+	/// Index of the object in the arrays
+	uint32_t index(object_handle handle) const;
+
+	/// Handle of the object at an index
+	object_handle handle(uint32_t index) const { return object_handle{ _slots[index], _generations[_slots[index]] }; }
+
+	/// Number of objects
+	size_t count() const { return _transforms.size(); }
+
+	/// Sets the model matrix of an object
+	void set_transform(uint32_t index, const glm::mat4& trans);
+
+	void translate(object_handle handle, const glm::vec3& v);
+	void rotate(object_handle handle, float a, const glm::vec3& v);
+	void scale(object_handle handle, const glm::vec3& v);
+
+	/// Indices of the objects whose transform changed since the last call to clear_moved
+	const std::vector<uint32_t>& moved() const { return _moved; }
+	void clear_moved();
+
+	const aligned_vector<glm::mat4>& transforms() const { return _transforms; }
+	/// Bounding spheres in model space
+	const aligned_vector<sphere>& bounding_spheres() const { return _spheres; }
+	/// Bounding boxes in model space
+	const aligned_vector<aabb>& boxes() const { return _boxes; }
+	const aligned_vector<uint32_t>& mesh_ids() const { return _mesh_ids; }
+	const aligned_vector<uint32_t>& material_ids() const { return _material_ids; }
+	const aligned_vector<uint32_t>& pipeline_ids() const { return _pipeline_ids; }
+
+	/// Resources of the renderer for an object
+	resource_handle& resource(uint32_t index) { return _resources[index]; }
+	resource_handle resource(uint32_t index) const { return _resources[index]; }
+
+	const std::vector<std::shared_ptr<model>>& meshes() const { return _meshes; }
+	const std::vector<material>& materials() const { return _materials; }
+	std::vector<pipeline>& pipelines() { return _pipelines; }
+	const std::vector<pipeline>& pipelines() const { return _pipelines; }
+
+private:
+
+	/// Orders the materials by their bytes, so equal materials are shared
+	struct material_less
+	{
+		bool operator()(const material& a, const material& b) const { return std::memcmp(&a, &b, sizeof(material)) < 0; }
+	};
+
+	/// Index of a value in a table, added if the lookup does not have it yet
+	template<typename T, typename Lookup, typename Key>
+	static uint32_t find_or_add(std::vector<T>& table, Lookup& lookup, const Key& key, const T& value);
+
+	void mark_moved(uint32_t index);
+
+	aligned_vector<glm::mat4> _transforms;
+	aligned_vector<sphere> _spheres;
+	aligned_vector<aabb> _boxes;
+	aligned_vector<uint32_t> _mesh_ids;
+	aligned_vector<uint32_t> _material_ids;
+	aligned_vector<uint32_t> _pipeline_ids;
+	aligned_vector<uint8_t> _moved_flags;
+	aligned_vector<resource_handle> _resources;
+	/// Slot of the object at every index
+	std::vector<uint32_t> _slots;
+
+	/// Index of the object in every slot
+	std::vector<uint32_t> _indices;
+	std::vector<uint32_t> _generations;
+	std::vector<uint32_t> _free_slots;
+
+	std::vector<uint32_t> _moved;
+
+	std::vector<std::shared_ptr<model>> _meshes;
+	std::vector<material> _materials;
+	std::vector<pipeline> _pipelines;
+	std::unordered_map<const model*, uint32_t> _mesh_lookup;
+	std::map<material, uint32_t, material_less> _material_lookup;
+	/// Pipelines by the names of their vertex and fragment shaders
+	std::map<std::pair<std::string, std::string>, uint32_t> _pipeline_lookup;
+};
\ No newline at end of file
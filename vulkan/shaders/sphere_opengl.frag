@@ -19,39 +19,85 @@ struct Material
 	vec4 hardness;
 };
 
-uniform Material material;
-uniform Light point;
-uniform vec4 eye;
+layout(std140) uniform FrameBlock
+{
+	mat4 view;
+	mat4 proj;
+	Light point;
+	Light sun;
+	Light spot;
+	vec4 eye;
+} frame;
+
+layout(std140) uniform ObjectBlock
+{
+	mat4 model;
+	mat4 model_view_projection;
+	mat4 normal;
+	Material material;
+} obj;
 
 in vec3 position;
 in vec3 normal;
 
 layout(location = 0) out vec4 outColor;
 
-vec4 point_light()
+// Whether the scene sets the light, the lights it leaves out are zero
+bool enabled(Light light)
 {
-	vec4 result = vec4(0, 0, 0, 0);
+	return any(greaterThan(light.ambiant.xyz + light.diffuse.xyz + light.specular.xyz, vec3(0)));
+}
 
-	result += material.ambiant * point.ambiant;
+float attenuation(Light light, float dist)
+{
+	return max(light.attenuation[0] + light.attenuation[1] * dist + light.attenuation[2] * dist * dist, 1e-4);
+}
 
-	vec4 dir = vec4(position, 1) - point.pos;
-	float dist = length(dir);
-	dir = -normalize(dir);
-	float a = dot(dir, vec4(normal, 0));
-	result += a * material.diffuse * point.diffuse / (point.attenuation[0] + point.attenuation[1] * dist + point.attenuation[2] * dist * dist);
-
-	vec4 V = vec4(position, 1) - point.pos;
-	dist = length(V);
-	V = -normalize(V);
-	vec3 R = reflect(vec3(V), normal);
-	vec4 E = normalize(vec4(position, 1) - eye);
+// Ambiant, diffuse and specular light of a light seen from the surface along to_light, the diffuse and specular terms are scaled by intensity
+vec4 shade(Light light, vec3 to_light, float intensity)
+{
+	vec4 result = obj.material.ambiant * light.ambiant;
+
+	float a = dot(to_light, normal);
+	result += a * obj.material.diffuse * light.diffuse * intensity;
+
+	vec3 R = reflect(to_light, normal);
+	vec4 E = normalize(vec4(position, 1) - frame.eye);
 	a = dot(R, vec3(E));
-	result += pow(a, material.hardness.x) * material.specular * point.specular / (point.attenuation[0] + point.attenuation[1] * dist + point.attenuation[2] * dist * dist);
+	result += pow(a, obj.material.hardness.x) * obj.material.specular * light.specular * intensity;
 
-	return vec4(result.xyz, 1);
+	return result;
+}
+
+vec4 point_light()
+{
+	vec3 dir = position - frame.point.pos.xyz;
+	return shade(frame.point, -normalize(dir), 1 / attenuation(frame.point, length(dir)));
+}
+
+vec4 sun_light()
+{
+	return shade(frame.sun, -frame.sun.dir.xyz, 1);
+}
+
+// Lights the cone of half angle spot.angle.x around the direction of the spot
+vec4 spot_light()
+{
+	vec3 dir = position - frame.spot.pos.xyz;
+	float dist = length(dir);
+	dir /= dist;
+	float cone = step(cos(frame.spot.angle.x), dot(dir, frame.spot.dir.xyz));
+	return shade(frame.spot, -dir, cone / attenuation(frame.spot, dist));
 }
 
 void main()
 {
-    outColor = clamp(point_light(), 0, 1);
+    vec4 color = vec4(0, 0, 0, 0);
+    if (enabled(frame.point))
+        color += point_light();
+    if (enabled(frame.sun))
+        color += sun_light();
+    if (enabled(frame.spot))
+        color += spot_light();
+    outColor = clamp(vec4(color.xyz, 1), 0, 1);
 }
@@ -1,8 +1,41 @@
 #version 430
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+struct Light
+{
+	vec4 pos;
+	vec4 ambiant;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 attenuation;
+	vec4 dir;
+	vec4 angle;
+};
+
+struct Material
+{
+	vec4 ambiant;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 hardness;
+};
+
+layout(std140) uniform FrameBlock
+{
+	mat4 view;
+	mat4 proj;
+	Light point;
+	Light sun;
+	Light spot;
+	vec4 eye;
+} frame;
+
+layout(std140) uniform ObjectBlock
+{
+	mat4 model;
+	mat4 model_view_projection;
+	mat4 normal;
+	Material material;
+} obj;
 
 layout(location = 0) in vec3 vp;
 layout(location = 1) in vec3 vn;
@@ -12,7 +45,7 @@ out vec3 normal;
 
 void main()
 {
-    gl_Position = proj * view * model * vec4(vp, 1.0);
-    position = vp;
-    normal = vn;
+    gl_Position = obj.model_view_projection * vec4(vp, 1.0);
+    position = vec3(obj.model * vec4(vp, 1.0));
+    normal = normalize(mat3(obj.normal) * vn);
 }
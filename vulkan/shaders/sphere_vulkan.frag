@@ -20,45 +20,85 @@ struct Material
 	vec4 hardness;
 };
 
-layout(binding = 0, set = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(std140, binding = 0, set = 0) uniform FrameBlock {
     mat4 view;
     mat4 proj;
-    Material material;
     Light point;
     Light sun;
     Light spot;
     vec4 eye;
-} ubo;
+} frame;
+
+layout(std430, binding = 1, set = 0) readonly buffer MaterialBuffer {
+    Material materials[];
+};
 
-in vec3 position;
-in vec3 normal;
+layout(push_constant) uniform ObjectConstants {
+    mat4 model;
+    uint material;
+} obj;
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
 
 layout(location = 0) out vec4 outColor;
 
-vec4 point_light()
+// Whether the scene sets the light, the lights it leaves out are zero
+bool enabled(Light light)
 {
-	vec4 result = vec4(0, 0, 0, 0);
+	return any(greaterThan(light.ambiant.xyz + light.diffuse.xyz + light.specular.xyz, vec3(0)));
+}
 
-	result += ubo.material.ambiant * ubo.point.ambiant;
+float attenuation(Light light, float dist)
+{
+	return max(light.attenuation[0] + light.attenuation[1] * dist + light.attenuation[2] * dist * dist, 1e-4);
+}
 
-	vec4 dir = vec4(position, 1) - ubo.point.pos;
-	float dist = length(dir);
-	dir = normalize(dir);
-	float a = dot(dir, vec4(normal, 0));
-	result += a * ubo.material.diffuse * ubo.point.diffuse / (ubo.point.attenuation[0] + ubo.point.attenuation[1] * dist + ubo.point.attenuation[2] * dist * dist);
-
-	vec4 V = vec4(position, 1) - ubo.point.pos;
-	dist = length(V);
-	V = normalize(V);
-	vec3 R = reflect(vec3(V), normal);
-	vec4 E = normalize(vec4(position, 1) - ubo.eye);
+// Ambiant, diffuse and specular light of a light reaching the surface along dir, the diffuse and specular terms are scaled by intensity
+vec4 shade(Light light, Material material, vec3 dir, float intensity)
+{
+	vec4 result = material.ambiant * light.ambiant;
+
+	float a = dot(dir, normal);
+	result += a * material.diffuse * light.diffuse * intensity;
+
+	vec3 R = reflect(dir, normal);
+	vec4 E = normalize(vec4(position, 1) - frame.eye);
 	a = dot(R, vec3(E));
-	result += pow(a, ubo.material.hardness.x) * ubo.material.specular * ubo.point.specular / (ubo.point.attenuation[0] + ubo.point.attenuation[1] * dist + ubo.point.attenuation[2] * dist * dist);
+	result += pow(a, material.hardness.x) * material.specular * light.specular * intensity;
+
+	return result;
+}
+
+vec4 point_light(Material material)
+{
+	vec3 dir = position - frame.point.pos.xyz;
+	return shade(frame.point, material, normalize(dir), 1 / attenuation(frame.point, length(dir)));
+}
 
-	return vec4(result.xyz, 1);
+vec4 sun_light(Material material)
+{
+	return shade(frame.sun, material, frame.sun.dir.xyz, 1);
+}
+
+// Lights the cone of half angle spot.angle.x around the direction of the spot
+vec4 spot_light(Material material)
+{
+	vec3 dir = position - frame.spot.pos.xyz;
+	float dist = length(dir);
+	dir /= dist;
+	float cone = step(cos(frame.spot.angle.x), dot(dir, frame.spot.dir.xyz));
+	return shade(frame.spot, material, dir, cone / attenuation(frame.spot, dist));
 }
 
 void main() {
-    outColor = clamp(point_light(), 0, 1);
+    Material material = materials[obj.material];
+    vec4 color = vec4(0, 0, 0, 0);
+    if (enabled(frame.point))
+        color += point_light(material);
+    if (enabled(frame.sun))
+        color += sun_light(material);
+    if (enabled(frame.spot))
+        color += spot_light(material);
+    outColor = clamp(vec4(color.xyz, 1), 0, 1);
 }
\ No newline at end of file
@@ -20,25 +20,29 @@ struct Material
     vec4 hardness;
 };
 
-layout(binding = 0, set = 0) uniform UniformBufferObject {
-    mat4 model;
+layout(std140, binding = 0, set = 0) uniform FrameBlock {
     mat4 view;
     mat4 proj;
-    Material material;
     Light point;
     Light sun;
     Light spot;
     vec4 eye;
-} ubo;
+} frame;
+
+layout(push_constant) uniform ObjectConstants {
+    mat4 model;
+    uint material;
+} obj;
 
 layout(location = 0) in vec3 vp;
 layout(location = 1) in vec3 vn;
 
-out vec3 position;
-out vec3 normal;
+layout(location = 0) out vec3 position;
+layout(location = 1) out vec3 normal;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(vp, 1.0);
-    position = vp;
-    normal = vn;
+    vec4 world = obj.model * vec4(vp, 1.0);
+    gl_Position = frame.proj * frame.view * world;
+    position = vec3(world);
+    normal = normalize(transpose(inverse(mat3(obj.model))) * vn);
 }
\ No newline at end of file
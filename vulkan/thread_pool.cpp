@@ -0,0 +1,69 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+using namespace std;
+
+thread_pool::thread_pool(size_t thread_count)
+{
+	if (thread_count == 0)
+		thread_count = max(1u, thread::hardware_concurrency());
+
+	for (size_t i = 0; i < thread_count; i++)
+		_threads.emplace_back([this] { work(); });
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_task_available.notify_all();
+
+	for (auto& t : _threads)
+		t.join();
+}
+
+void thread_pool::submit(function<void()> task)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_tasks.push_back(move(task));
+	}
+	_task_available.notify_one();
+}
+
+void thread_pool::wait()
+{
+	unique_lock<mutex> lock(_mutex);
+	_task_done.wait(lock, [this] { return _tasks.empty() && _running == 0; });
+}
+
+size_t thread_pool::pending() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return size(_tasks) + _running;
+}
+
+void thread_pool::work()
+{
+	unique_lock<mutex> lock(_mutex);
+	while (true)
+	{
+		_task_available.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+		// The queue is drained before stopping
+		if (_tasks.empty())
+			return;
+
+		auto task = move(_tasks.front());
+		_tasks.pop_front();
+		_running++;
+
+		lock.unlock();
+		task();
+		lock.lock();
+
+		_running--;
+		_task_done.notify_all();
+	}
+}
\ No newline at end of file
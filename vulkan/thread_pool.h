@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads running tasks in the order they were submitted
+ */
+class thread_pool
+{
+public:
+
+	/// Starts thread_count workers, one per hardware thread when 0
+	explicit thread_pool(size_t thread_count = 0);
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	/// Runs the remaining tasks and joins the workers
+	~thread_pool();
+
+	/// Queues a task
+	void submit(std::function<void()> task);
+
+	/// Blocks until every submitted task has finished
+	void wait();
+
+	/// Number of tasks queued or running
+	size_t pending() const;
+
+	size_t thread_count() const { return _threads.size(); }
+
+private:
+
+	void work();
+
+	std::vector<std::thread> _threads;
+	std::deque<std::function<void()>> _tasks;
+	size_t _running = 0;
+	bool _stopping = false;
+	mutable std::mutex _mutex;
+	/// Signaled when a task is queued or the pool stops
+	std::condition_variable _task_available;
+	/// Signaled when a task finishes
+	std::condition_variable _task_done;
+};
\ No newline at end of file
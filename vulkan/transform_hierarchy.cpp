@@ -0,0 +1,246 @@
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <glm/simd/matrix.h>
+
+using namespace std;
+
+const uint32_t transform_hierarchy::invalid;
+
+/// Levels with fewer dirty nodes are updated on the calling thread
+static const size_t parallel_threshold = 4096;
+
+/// Matrix of a translation, a rotation and a scale applied in the reverse order
+static glm::mat4 compose(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+	auto r = glm::mat3_cast(rotation);
+	return glm::mat4(
+		glm::vec4(r[0] * scale.x, 0.f),
+		glm::vec4(r[1] * scale.y, 0.f),
+		glm::vec4(r[2] * scale.z, 0.f),
+		glm::vec4(translation, 1.f));
+}
+
+uint32_t transform_hierarchy::create(uint32_t parent)
+{
+	uint32_t node;
+	if (_free_nodes.empty())
+	{
+		node = uint32_t(size(_parents));
+		_translations.emplace_back();
+		_rotations.emplace_back();
+		_scales.emplace_back();
+		_worlds.emplace_back();
+		_parents.push_back(invalid);
+		_first_children.push_back(invalid);
+		_next_siblings.push_back(invalid);
+		_depths.push_back(0);
+		_dirty.push_back(0);
+	}
+	else
+	{
+		node = _free_nodes.back();
+		_free_nodes.pop_back();
+	}
+
+	_translations[node] = glm::vec3(0.f);
+	_rotations[node] = glm::quat();
+	_scales[node] = glm::vec3(1.f);
+	_worlds[node] = glm::mat4(1.f);
+	_parents[node] = invalid;
+	_first_children[node] = invalid;
+	_next_siblings[node] = invalid;
+	_depths[node] = 0;
+	_dirty[node] = 0;
+
+	set_parent(node, parent);
+	return node;
+}
+
+void transform_hierarchy::destroy(uint32_t node)
+{
+	if (_first_children[node] != invalid)
+		throw runtime_error("Can't destroy a node with children");
+
+	set_parent(node, invalid);
+
+	// The node was marked dirty by set_parent
+	auto& level = _dirty_levels[_depths[node]];
+	level.erase(remove(begin(level), end(level), node), end(level));
+	_dirty[node] = 0;
+
+	_free_nodes.push_back(node);
+}
+
+void transform_hierarchy::set_parent(uint32_t node, uint32_t parent)
+{
+	auto old_parent = _parents[node];
+	if (old_parent != invalid)
+	{
+		auto* link = &_first_children[old_parent];
+		while (*link != node)
+			link = &_next_siblings[*link];
+		*link = _next_siblings[node];
+	}
+
+	_parents[node] = parent;
+	_next_siblings[node] = invalid;
+	if (parent != invalid)
+	{
+		_next_siblings[node] = _first_children[parent];
+		_first_children[parent] = node;
+	}
+
+	update_depths(node);
+	mark_dirty(node);
+}
+
+void transform_hierarchy::update_depths(uint32_t node)
+{
+	// A dirty node is listed at its old depth, so it is unlisted and the whole subtree is recomputed from the node
+	if (_dirty[node])
+	{
+		auto& level = _dirty_levels[_depths[node]];
+		level.erase(remove(begin(level), end(level), node), end(level));
+		_dirty[node] = 0;
+	}
+
+	auto parent = _parents[node];
+	_depths[node] = parent == invalid ? 0 : _depths[parent] + 1;
+
+	for (auto child = _first_children[node]; child != invalid; child = _next_siblings[child])
+		update_depths(child);
+}
+
+void transform_hierarchy::mark_dirty(uint32_t node)
+{
+	if (_dirty[node])
+		return;
+	_dirty[node] = 1;
+
+	auto depth = _depths[node];
+	if (depth >= size(_dirty_levels))
+		_dirty_levels.resize(depth + 1);
+	_dirty_levels[depth].push_back(node);
+}
+
+void transform_hierarchy::set_translation(uint32_t node, const glm::vec3& translation)
+{
+	_translations[node] = translation;
+	mark_dirty(node);
+}
+
+void transform_hierarchy::set_rotation(uint32_t node, const glm::quat& rotation)
+{
+	_rotations[node] = rotation;
+	mark_dirty(node);
+}
+
+void transform_hierarchy::set_scale(uint32_t node, const glm::vec3& scale)
+{
+	_scales[node] = scale;
+	mark_dirty(node);
+}
+
+void transform_hierarchy::translate(uint32_t node, const glm::vec3& v)
+{
+	set_translation(node, _translations[node] + _rotations[node] * (_scales[node] * v));
+}
+
+void transform_hierarchy::rotate(uint32_t node, float a, const glm::vec3& v)
+{
+	// Normalized so that rotating every frame does not scale the node
+	set_rotation(node, glm::normalize(_rotations[node] * glm::angleAxis(a, glm::normalize(v))));
+}
+
+void transform_hierarchy::scale(uint32_t node, const glm::vec3& v)
+{
+	set_scale(node, _scales[node] * v);
+}
+
+void transform_hierarchy::update_range(const uint32_t* nodes, size_t count, vector<uint32_t>& children)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		auto node = nodes[i];
+		auto local = compose(_translations[node], _rotations[node], _scales[node]);
+		auto parent = _parents[node];
+
+		if (parent == invalid)
+			_worlds[node] = local;
+		else
+		{
+#if GLM_ARCH & GLM_ARCH_SSE2_BIT
+			// The worlds are in a 64 byte aligned array, the local matrix is on the stack and is loaded unaligned
+			glm_vec4 columns[4] = { _mm_loadu_ps(&local[0][0]), _mm_loadu_ps(&local[1][0]), _mm_loadu_ps(&local[2][0]), _mm_loadu_ps(&local[3][0]) };
+			glm_mat4_mul(reinterpret_cast<const glm_vec4*>(&_worlds[parent]), columns, reinterpret_cast<glm_vec4*>(&_worlds[node]));
+#else
+			_worlds[node] = _worlds[parent] * local;
+#endif
+		}
+
+		// Only this node's parent can list a child, so the flags of the children are not shared between threads
+		for (auto child = _first_children[node]; child != invalid; child = _next_siblings[child])
+		{
+			if (!_dirty[child])
+			{
+				_dirty[child] = 1;
+				children.push_back(child);
+			}
+		}
+
+		_dirty[node] = 0;
+	}
+}
+
+void transform_hierarchy::update()
+{
+	_updated.clear();
+
+	static const size_t thread_count = max(1u, thread::hardware_concurrency());
+
+	for (size_t depth = 0; depth < size(_dirty_levels); depth++)
+	{
+		auto nodes = move(_dirty_levels[depth]);
+		_dirty_levels[depth].clear();
+		if (nodes.empty())
+			continue;
+
+		vector<uint32_t> children;
+
+		if (size(nodes) < parallel_threshold || thread_count == 1)
+			update_range(data(nodes), size(nodes), children);
+		else
+		{
+			// Nodes of a level only read the worlds of the previous levels, so they can be updated in any order
+			vector<vector<uint32_t>> chunk_children(thread_count);
+			vector<future<void>> tasks;
+			auto chunk_size = (size(nodes) + thread_count - 1) / thread_count;
+
+			for (size_t t = 1; t < thread_count; t++)
+			{
+				auto first = min(size(nodes), t * chunk_size);
+				auto count = min(size(nodes), first + chunk_size) - first;
+				tasks.push_back(async(launch::async, [this, &nodes, &chunk_children, first, count, t] { update_range(data(nodes) + first, count, chunk_children[t]); }));
+			}
+			update_range(data(nodes), min(chunk_size, size(nodes)), chunk_children[0]);
+
+			for (auto& task : tasks)
+				task.get();
+			for (auto& c : chunk_children)
+				children.insert(end(children), begin(c), end(c));
+		}
+
+		if (!children.empty())
+		{
+			if (depth + 1 >= size(_dirty_levels))
+				_dirty_levels.resize(depth + 2);
+			auto& next = _dirty_levels[depth + 1];
+			next.insert(end(next), begin(children), end(children));
+		}
+
+		_updated.insert(end(_updated), begin(nodes), end(nodes));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "aligned_allocator.h"
+
+/**
+ * Hierarchy of transforms stored as translation, rotation and scale relative to the parent.
+ * Changing a node marks it dirty, update recomputes the world matrices of the dirty nodes and of their descendants
+ * one depth level at a time, so its cost follows the number of dirty nodes and not the size of the hierarchy
+ */
+class transform_hierarchy
+{
+public:
+
+	static const uint32_t invalid = UINT32_MAX;
+
+	/// Creates a node at the origin, a root when parent is invalid
+	uint32_t create(uint32_t parent = invalid);
+
+	/// Destroys a node without children
+	void destroy(uint32_t node);
+
+	/// Moves a node and its descendants under another parent, or to the roots when parent is invalid
+	void set_parent(uint32_t node, uint32_t parent);
+
+	void set_translation(uint32_t node, const glm::vec3& translation);
+	void set_rotation(uint32_t node, const glm::quat& rotation);
+	void set_scale(uint32_t node, const glm::vec3& scale);
+
+	void translate(uint32_t node, const glm::vec3& v);
+	void rotate(uint32_t node, float a, const glm::vec3& v);
+	void scale(uint32_t node, const glm::vec3& v);
+
+	const glm::vec3& translation(uint32_t node) const { return _translations[node]; }
+	const glm::quat& rotation(uint32_t node) const { return _rotations[node]; }
+	const glm::vec3& scale(uint32_t node) const { return _scales[node]; }
+	uint32_t parent(uint32_t node) const { return _parents[node]; }
+	uint32_t depth(uint32_t node) const { return _depths[node]; }
+
+	/// World matrix of a node, up to date after update
+	const glm::mat4& world(uint32_t node) const { return _worlds[node]; }
+
+	/// Recomputes the world matrices of the dirty nodes and of their descendants
+	void update();
+
+	/// Nodes whose world matrix was recomputed by the last update
+	const std::vector<uint32_t>& updated() const { return _updated; }
+
+	/// Number of node ids, including the destroyed ones
+	size_t capacity() const { return _parents.size(); }
+
+private:
+
+	/// Adds a node to the dirty list of its level
+	void mark_dirty(uint32_t node);
+
+	/// Recomputes the world matrices of dirty nodes and appends their children to the next level
+	void update_range(const uint32_t* nodes, size_t count, std::vector<uint32_t>& children);
+
+	/// Sets the depth of the descendants of a node from its depth
+	void update_depths(uint32_t node);
+
+	aligned_vector<glm::vec3> _translations;
+	aligned_vector<glm::quat> _rotations;
+	aligned_vector<glm::vec3> _scales;
+	aligned_vector<glm::mat4> _worlds;
+	std::vector<uint32_t> _parents;
+	std::vector<uint32_t> _first_children;
+	std::vector<uint32_t> _next_siblings;
+	std::vector<uint32_t> _depths;
+	std::vector<uint8_t> _dirty;
+	std::vector<uint32_t> _free_nodes;
+
+	/// Dirty nodes of every depth
+	std::vector<std::vector<uint32_t>> _dirty_levels;
+	std::vector<uint32_t> _updated;
+};
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include "scene.h"
+
+/**
+ * Uniform block layouts shared by the renderers, every member is a vec4 or a mat4
+ * so the C++ layout matches std140 without any padding
+ */
+
+/// Uniforms that are the same for every object of a frame
+struct frame_uniforms
+{
+	glm::mat4 view;
+	glm::mat4 proj;
+	light point;
+	light sun;
+	light spot;
+	glm::vec4 eye;
+};
+
+/// Uniforms that change for every object
+struct object_uniforms
+{
+	glm::mat4 model;
+	glm::mat4 model_view_projection;
+	/// Inverse transpose of the model matrix
+	glm::mat4 normal;
+	::material material;
+};
+
+/// Push constants of a vulkan draw, the normal matrix is computed by the shader to stay within the 128 bytes every device supports
+struct object_push_constants
+{
+	glm::mat4 model;
+	/// Index of the material in the material buffer
+	uint32_t material;
+};
\ No newline at end of file
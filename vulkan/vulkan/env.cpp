@@ -1,7 +1,7 @@
 #include "env.h"
+#include <cstring>
 #include <iostream>
 #include "util.h"
-#include <GLFW/glfw3native.h>
 
 using namespace vulkan;
 using namespace std;
@@ -18,19 +18,23 @@ static vector<const char*> device_extensions = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
-static vk::Instance create_instance(bool debug)
+/// Creates the instance, properties2 is set if VK_KHR_get_physical_device_properties2 is enabled for the memory budget
+static vk::Instance create_instance(bool debug, bool headless, bool& properties2)
 {
 	vk::ApplicationInfo app_info;
 	vk::InstanceCreateInfo create_info;
 	vector<const char*> extensions, layers;
 
-	// Get GLFW extensions
-	uint32_t glfw_extension_count;
-	const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-	if (glfw_extension_count == 0)
-		throw runtime_error("Can't get glfw extensions");
-	for (uint32_t i = 0; i < glfw_extension_count; i++)
-		extensions.push_back(glfw_extensions[i]);
+	// Get GLFW extensions, a headless instance has no surface
+	if (!headless)
+	{
+		uint32_t glfw_extension_count;
+		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		if (glfw_extension_count == 0)
+			throw runtime_error("Can't get glfw extensions");
+		for (uint32_t i = 0; i < glfw_extension_count; i++)
+			extensions.push_back(glfw_extensions[i]);
+	}
 
 	// Add verification layer and extension if debug
 	if (debug)
@@ -39,6 +43,21 @@ static vk::Instance create_instance(bool debug)
 		layers.insert(end(layers), begin(debug_layers), end(debug_layers));
 	}
 
+#ifdef VK_EXT_memory_budget
+	// The memory budget is queried through the properties2 functions, enabled only when the loader has them
+	properties2 = false;
+	for (auto& extension : vk::enumerateInstanceExtensionProperties())
+	{
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+		{
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			properties2 = true;
+		}
+	}
+#else
+	properties2 = false;
+#endif
+
 	app_info.apiVersion = VK_API_VERSION_1_0;
 	app_info.pApplicationName = "Vulkan";
 
@@ -55,21 +74,40 @@ static vk::Instance create_instance(bool debug)
 	return instance;
 }
 
-env::env(GLFWwindow* window, bool debug)
+env::env(GLFWwindow* window, bool debug, vk::PresentModeKHR preferred_present_mode)
 {
-	instance = create_instance(debug);
+	instance = create_instance(debug, false, properties2_supported);
 	create_debug_callback = nullptr;
 	destroy_debug_callback = nullptr;
 	if (debug)
 		init_instance_debug_callbacks();
+	this->window = window;
 	create_surface(window);
 	choose_device(debug);
-	create_swapchain(window);
+	create_swapchain(preferred_present_mode, vk::SwapchainKHR());
 	create_swapchain_image_views();
 	create_depth_image();
 	create_render_pass();
+	create_framebuffers();
+	create_command_pool();
+	create_semaphores();
+}
+
+env::env(uint32_t width, uint32_t height, uint32_t image_count, bool debug)
+{
+	headless = true;
+	instance = create_instance(debug, true, properties2_supported);
+	create_debug_callback = nullptr;
+	destroy_debug_callback = nullptr;
+	if (debug)
+		init_instance_debug_callbacks();
+	choose_device(debug);
+	create_offscreen_images(width, height, image_count);
+	create_swapchain_image_views();
+	create_depth_image();
+	create_render_pass();
+	create_framebuffers();
 	create_command_pool();
-	create_descriptor_pool();
 	create_semaphores();
 }
 
@@ -83,22 +121,18 @@ env::~env()
 		device.destroySemaphore(render_finished_semaphore);
 	if (render_pass)
 		device.destroyRenderPass(render_pass);
-	if (descriptor_pool)
-		device.destroyDescriptorPool(descriptor_pool);
 	if (render_command_pool)
 		device.destroyCommandPool(render_command_pool);
-	if (depth_image_view)
-		device.destroyImageView(depth_image_view);
-	if (depth_image)
-		device.destroyImage(depth_image);
-	if (depth_memory)
-		device.freeMemory(depth_memory);
-	for (auto fb : framebuffers)
-		device.destroyFramebuffer(fb);
-	for (auto view : swapchain_image_views)
-		device.destroyImageView(view);
+	destroy_swapchain_resources();
 	if (swapchain)
 		device.destroySwapchainKHR(swapchain);
+	if (headless)
+	{
+		for (auto image : swapchain_images)
+			device.destroyImage(image);
+	}
+	for (auto memory : offscreen_memories)
+		device.freeMemory(memory);
 	if (device)
 		device.destroy();
 	if (surface)
@@ -154,10 +188,13 @@ void env::choose_device(bool debug)
 		{
 			render_queue_index = i;
 		}
-		if (physical_device.getSurfaceSupportKHR(i, surface))
+		// Without surface the render queue does the display
+		if (!headless && physical_device.getSurfaceSupportKHR(i, surface))
 		{
 			display_queue_index = i;
 		}
+		if (headless && render_queue_index != -1)
+			display_queue_index = render_queue_index;
 		if (render_queue_index != -1 && display_queue_index != -1)
 			break;
 	}
@@ -186,7 +223,12 @@ void env::choose_device(bool debug)
 		queues_create_info.push_back(display_queue_create_info);
 	}
 
+	// The draws are recorded in the frame command buffer, its queries need no inheritance
+	auto supported = physical_device.getFeatures();
+	pipeline_statistics = supported.pipelineStatisticsQuery;
+
 	vk::PhysicalDeviceFeatures features;
+	features.pipelineStatisticsQuery = pipeline_statistics;
 
 	vk::DeviceCreateInfo create_info;
 	create_info.pQueueCreateInfos = data(queues_create_info);
@@ -194,8 +236,26 @@ void env::choose_device(bool debug)
 	create_info.pEnabledFeatures = &features;
 	create_info.ppEnabledLayerNames = data(debug_layers);
 	create_info.enabledLayerCount = size(debug_layers);
-	create_info.ppEnabledExtensionNames = data(device_extensions);
-	create_info.enabledExtensionCount = size(device_extensions);
+	auto extensions = headless ? vector<const char*>() : device_extensions;
+#ifdef VK_EXT_memory_budget
+	auto device_has = [this](const char* name)
+	{
+		for (auto& extension : physical_device.enumerateDeviceExtensionProperties())
+		{
+			if (strcmp(extension.extensionName, name) == 0)
+				return true;
+		}
+		return false;
+	};
+
+	// The instance enabled properties2 if it could, the device must also have the extension
+	memory_budget_supported = properties2_supported && device_has(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memory_budget_supported)
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#endif
+
+	create_info.ppEnabledExtensionNames = data(extensions);
+	create_info.enabledExtensionCount = size(extensions);
 
 	physical_device.createDevice(&create_info, nullptr, &device);
 
@@ -205,15 +265,8 @@ void env::choose_device(bool debug)
 
 void env::create_surface(GLFWwindow* window)
 {
-	auto create = getProcAddress<PFN_vkCreateWin32SurfaceKHR>(instance, "vkCreateWin32SurfaceKHR");
-	VkWin32SurfaceCreateInfoKHR create_info;
-	create_info.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-	create_info.hwnd = glfwGetWin32Window(window);
-	create_info.hinstance = GetModuleHandle(nullptr);
-	create_info.pNext = nullptr;
-	create_info.flags = 0;
-
-	if (create((VkInstance)instance, &create_info, nullptr, &surface) != VK_SUCCESS)
+	// GLFW picks the Win32, Xlib, XCB or Wayland surface extension it required for the instance
+	if (glfwCreateWindowSurface((VkInstance)instance, window, nullptr, &surface) != VK_SUCCESS)
 		throw runtime_error("Could not create window");
 }
 
@@ -229,22 +282,24 @@ static vk::SurfaceFormatKHR choose_swapchain_format(const vector<vk::SurfaceForm
 	return formats[0];
 }
 
-static vk::PresentModeKHR choose_present_mode(const vector<vk::PresentModeKHR>& modes)
+static vk::PresentModeKHR choose_present_mode(const vector<vk::PresentModeKHR>& modes, vk::PresentModeKHR preferred)
 {
 	if (size(modes) == 0)
 		throw runtime_error("No modes to choose from");
 	for (const auto& m : modes)
 	{
-		if (m == vk::PresentModeKHR::eMailbox)
+		if (m == preferred)
 			return m;
 	}
+	// The only mode every implementation supports
 	return vk::PresentModeKHR::eFifo;
 }
 
-void env::create_swapchain(GLFWwindow* window)
+void env::create_swapchain(vk::PresentModeKHR preferred_present_mode, vk::SwapchainKHR old_swapchain)
 {
+	// The framebuffer size is in pixels, the window size is not on high DPI displays
 	int width, height;
-	glfwGetWindowSize(window, &width, &height);
+	glfwGetFramebufferSize(window, &width, &height);
 	auto capabilities = physical_device.getSurfaceCapabilitiesKHR(surface);
 	swapchain_extent = vk::Extent2D{ uint32_t(width), uint32_t(height) };
 
@@ -252,15 +307,20 @@ void env::create_swapchain(GLFWwindow* window)
 	swapchain_extent.height = max(capabilities.minImageExtent.height, min(capabilities.maxImageExtent.height, swapchain_extent.height));
 
 	auto format = choose_swapchain_format(physical_device.getSurfaceFormatsKHR(surface));
-	auto present_mode = choose_present_mode(physical_device.getSurfacePresentModesKHR(surface));
+	present_mode = choose_present_mode(physical_device.getSurfacePresentModesKHR(surface), preferred_present_mode);
 	
 	swapchain_image_format = format.format;
 
 	vk::SwapchainCreateInfoKHR create_info;
 	create_info.surface = surface;
-	create_info.minImageCount = capabilities.minImageCount + 1;
-	if (capabilities.maxImageCount > 0 && create_info.minImageCount > capabilities.maxImageCount)
-		create_info.minImageCount = capabilities.maxImageCount;
+	// A recreated swapchain asks for as many images as the first one, the driver may still give more
+	if (!old_swapchain)
+	{
+		requested_image_count = capabilities.minImageCount + 1;
+		if (capabilities.maxImageCount > 0 && requested_image_count > capabilities.maxImageCount)
+			requested_image_count = capabilities.maxImageCount;
+	}
+	create_info.minImageCount = max(requested_image_count, capabilities.minImageCount);
 	create_info.imageExtent = swapchain_extent;
 	create_info.imageFormat = swapchain_image_format;
 	create_info.imageColorSpace = format.colorSpace;
@@ -274,11 +334,25 @@ void env::create_swapchain(GLFWwindow* window)
 	create_info.preTransform = capabilities.currentTransform;
 	create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
 	create_info.clipped = VK_TRUE;
+	// The presentation engine may reuse the resources of the old swapchain
+	create_info.oldSwapchain = old_swapchain;
 	if (device.createSwapchainKHR(&create_info, nullptr, &swapchain) != vk::Result::eSuccess)
 		throw runtime_error("Could not create swapchain");
 	swapchain_images = device.getSwapchainImagesKHR(swapchain);
 }
 
+void env::create_offscreen_images(uint32_t width, uint32_t height, uint32_t image_count)
+{
+	swapchain_extent = vk::Extent2D{ width, height };
+	// RGBA so the read back pixels have the same layout as the OpenGL ones
+	swapchain_image_format = vk::Format::eR8G8B8A8Unorm;
+
+	swapchain_images.resize(image_count);
+	offscreen_memories.resize(image_count);
+	for (uint32_t i = 0; i < image_count; i++)
+		create_image(width, height, swapchain_image_format, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eDeviceLocal, swapchain_images[i], offscreen_memories[i]);
+}
+
 void env::create_swapchain_image_views()
 {
 	swapchain_image_views.resize(size(swapchain_images));
@@ -354,7 +428,8 @@ void env::create_render_pass()
 	attachment_description.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
 	attachment_description.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
 	attachment_description.initialLayout = vk::ImageLayout::eUndefined;
-	attachment_description.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+	// Offscreen images are copied to the host after the render pass
+	attachment_description.finalLayout = headless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
 
 	vk::AttachmentReference attachment_reference;
 	attachment_reference.attachment = 0;
@@ -380,12 +455,20 @@ void env::create_render_pass()
 	subpass_description.pColorAttachments = &attachment_reference;
 	subpass_description.pDepthStencilAttachment = &depth_attachment_reference;
 
-	vk::SubpassDependency dependency;
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-	dependency.dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-	dependency.dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+	vk::SubpassDependency dependencies[2];
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependencies[0].dstStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependencies[0].dstAccessMask = vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite;
+
+	// The copy of an offscreen image to the host waits for the color writes and the transition to the transfer layout
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+	dependencies[1].srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+	dependencies[1].dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+	dependencies[1].dstAccessMask = vk::AccessFlagBits::eTransferRead;
 
 	vk::AttachmentDescription attachments[] = { attachment_description, depth_attachment_description };
 
@@ -394,12 +477,15 @@ void env::create_render_pass()
 	render_pass_create_info.pAttachments = attachments;
 	render_pass_create_info.subpassCount = 1;
 	render_pass_create_info.pSubpasses = &subpass_description;
-	render_pass_create_info.dependencyCount = 1;
-	render_pass_create_info.pDependencies = &dependency;
+	render_pass_create_info.dependencyCount = headless ? 2 : 1;
+	render_pass_create_info.pDependencies = dependencies;
 
 	if (device.createRenderPass(&render_pass_create_info, nullptr, &render_pass) != vk::Result::eSuccess)
 		throw runtime_error("Failed to create render pass");
+}
 
+void env::create_framebuffers()
+{
 	framebuffers.resize(size(swapchain_image_views));
 
 	for(size_t i = 0; i < size(swapchain_image_views); i++)
@@ -418,36 +504,56 @@ void env::create_render_pass()
 	}
 }
 
-void env::create_command_pool()
+void env::destroy_swapchain_resources()
 {
-	vk::CommandPoolCreateInfo render_create_info;
-
-	render_create_info.queueFamilyIndex = render_queue_index;
-
-	if (device.createCommandPool(&render_create_info, nullptr, &render_command_pool) != vk::Result::eSuccess)
-		throw runtime_error("Can't create command pool");
+	for (auto fb : framebuffers)
+		device.destroyFramebuffer(fb);
+	framebuffers.clear();
+	for (auto view : swapchain_image_views)
+		device.destroyImageView(view);
+	swapchain_image_views.clear();
+	if (depth_image_view)
+		device.destroyImageView(depth_image_view);
+	depth_image_view = vk::ImageView();
+	if (depth_image)
+		device.destroyImage(depth_image);
+	depth_image = vk::Image();
+	if (depth_memory)
+		device.freeMemory(depth_memory);
+	depth_memory = vk::DeviceMemory();
 }
 
-void env::create_descriptor_pool()
+bool env::recreate_swapchain()
 {
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	if (width == 0 || height == 0)
+		return false;
 
-	vk::DescriptorPoolSize pool_size;
-
-	pool_size.type = vk::DescriptorType::eUniformBuffer;
-	pool_size.descriptorCount = 10;
+	// The render pass only depends on the formats, which do not change
+	auto old_swapchain = swapchain;
+	destroy_swapchain_resources();
+	create_swapchain(present_mode, old_swapchain);
+	device.destroySwapchainKHR(old_swapchain);
 
-	vk::DescriptorPoolCreateInfo create_info;
+	create_swapchain_image_views();
+	create_depth_image();
+	create_framebuffers();
+	return true;
+}
 
-	create_info.poolSizeCount = 1;
-	create_info.pPoolSizes = &pool_size;
-	create_info.maxSets = 10;
+void env::create_command_pool()
+{
+	vk::CommandPoolCreateInfo render_create_info;
 
-	if (device.createDescriptorPool(&create_info, nullptr, &descriptor_pool) != vk::Result::eSuccess)
-		throw runtime_error("Failed to create descriptor pool");
+	render_create_info.queueFamilyIndex = render_queue_index;
+	// The frame command buffers are reset and recorded every frame
+	render_create_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
 
+	if (device.createCommandPool(&render_create_info, nullptr, &render_command_pool) != vk::Result::eSuccess)
+		throw runtime_error("Can't create command pool");
 }
 
-
 void env::create_semaphores()
 {
 	vk::SemaphoreCreateInfo create_info;
@@ -472,8 +578,39 @@ static uint32_t find_memory_type(uint32_t type_filter, vk::MemoryPropertyFlags p
 	throw runtime_error("Failed to find memory type");
 }
 
+uint32_t env::memory_heap(vk::Buffer buffer, vk::MemoryPropertyFlags properties) const
+{
+	vk::MemoryRequirements requirements;
+	device.getBufferMemoryRequirements(buffer, &requirements);
+
+	auto memory_properties = physical_device.getMemoryProperties();
+	return memory_properties.memoryTypes[find_memory_type(requirements.memoryTypeBits, properties, memory_properties)].heapIndex;
+}
+
+bool env::memory_budget(uint32_t heap, vk::DeviceSize& budget, vk::DeviceSize& usage) const
+{
+#ifdef VK_EXT_memory_budget
+	if (!memory_budget_supported)
+		return false;
+
+	auto get_memory_properties = getProcAddress<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(instance, "vkGetPhysicalDeviceMemoryProperties2KHR");
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+	budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2KHR properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	properties.pNext = &budget_properties;
+	get_memory_properties((VkPhysicalDevice)physical_device, &properties);
+
+	budget = budget_properties.heapBudget[heap];
+	usage = budget_properties.heapUsage[heap];
+	return true;
+#else
+	return false;
+#endif
+}
 
-void env::create_memory(size_t size, vk::Buffer& buffer, vk::DeviceMemory& device_memory, void* data, vk::BufferUsageFlagBits usage) const
+void env::create_buffer(size_t size, vk::Buffer& buffer, vk::DeviceMemory& device_memory, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties) const
 {
 	vk::BufferCreateInfo buffer_create_info;
 	buffer_create_info.size = size;
@@ -491,19 +628,24 @@ void env::create_memory(size_t size, vk::Buffer& buffer, vk::DeviceMemory& devic
 
 	vk::MemoryAllocateInfo allocate_info;
 	allocate_info.allocationSize = requirements.size;
-	allocate_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, memory_properties);
+	allocate_info.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, properties, memory_properties);
 
 	if (device.allocateMemory(&allocate_info, nullptr, &device_memory) != vk::Result::eSuccess)
 		throw runtime_error("Failed to allocate memory");
 
 	device.bindBufferMemory(buffer, device_memory, 0);
+}
+
+void env::create_memory(size_t size, vk::Buffer& buffer, vk::DeviceMemory& device_memory, void* data, vk::BufferUsageFlagBits usage) const
+{
+	create_buffer(size, buffer, device_memory, usage, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
 	auto* ptr = device.mapMemory(device_memory, 0, size);
 	memcpy(ptr, data, size);
 	device.unmapMemory(device_memory);
 }
 
-void env::create_image(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling image_tiling, vk::ImageUsageFlagBits usage, vk::MemoryPropertyFlagBits properties, vk::Image& image, vk::DeviceMemory& memory) const
+void env::create_image(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling image_tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlagBits properties, vk::Image& image, vk::DeviceMemory& memory) const
 {
 	vk::ImageCreateInfo create_info;
 	create_info.imageType = vk::ImageType::e2D;
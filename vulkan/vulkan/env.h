@@ -24,22 +24,38 @@ namespace vulkan
 		vk::Queue display_queue;
 		/// Index of the display queue
 		int display_queue_index;
+		/// Whether the device supports pipeline statistics queries
+		bool pipeline_statistics = false;
+		/// Whether the instance enabled VK_KHR_get_physical_device_properties2
+		bool properties2_supported = false;
+		/// Whether VK_EXT_memory_budget is enabled, so memory_budget gives the budget of the heaps
+		bool memory_budget_supported = false;
 		/// Debug callbacks info
 		VkDebugReportCallbackEXT debug_callbacks;
 		/// Create debug callback function pointer
 		PFN_vkCreateDebugReportCallbackEXT create_debug_callback;
 		/// Destroy debug callback function pointer
 		PFN_vkDestroyDebugReportCallbackEXT destroy_debug_callback;
-		/// The surface contained in the GLFW window
-		VkSurfaceKHR surface;
+		/// The window presented to, null when headless
+		GLFWwindow* window = nullptr;
+		/// The surface contained in the GLFW window, null when headless
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
+		/// Whether the images are offscreen images instead of a swapchain
+		bool headless = false;
 		/// The swapchain for triple buffering
 		vk::SwapchainKHR swapchain;
 		/// The size of the swapchain
 		vk::Extent2D swapchain_extent;
 		/// The format of the swapchain
 		vk::Format swapchain_image_format;
-		/// The images of the swapchain
+		/// The present mode of the swapchain
+		vk::PresentModeKHR present_mode = vk::PresentModeKHR::eFifo;
+		/// The number of images asked for when creating the swapchain, the driver may give more
+		uint32_t requested_image_count = 0;
+		/// The images of the swapchain, or the offscreen images when headless
 		std::vector<vk::Image> swapchain_images;
+		/// Memory of the offscreen images
+		std::vector<vk::DeviceMemory> offscreen_memories;
 		/// The views of the swapchain
 		std::vector<vk::ImageView> swapchain_image_views;
 		/// The framebuffer of the swapchain
@@ -59,16 +75,26 @@ namespace vulkan
 		/// Semaphore for GPU synchronization
 		vk::Semaphore image_available_semaphore;
 		vk::Semaphore render_finished_semaphore;
-		/// Pool for the Uniform descriptors
-		vk::DescriptorPool descriptor_pool;
 
-		env(GLFWwindow* window, bool debug);
+		/// Creates an environment presenting to the window, with the preferred present mode if the surface supports it and FIFO otherwise
+		env(GLFWwindow* window, bool debug, vk::PresentModeKHR preferred_present_mode = vk::PresentModeKHR::eMailbox);
+		/// Creates an environment without surface, rendering into image_count offscreen images
+		env(uint32_t width, uint32_t height, uint32_t image_count, bool debug);
 		~env();
 
+		/// Creates a buffer and binds it to new memory with the given properties
+		void create_buffer(size_t size, vk::Buffer& buffer, vk::DeviceMemory& device_memory, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties) const;
 		/// Creates memory
 		void create_memory(size_t size, vk::Buffer& buffer, vk::DeviceMemory& device_memory, void* data, vk::BufferUsageFlagBits usage) const;
+		/// Bytes the process may allocate in a heap and bytes it uses now, false without VK_EXT_memory_budget
+		bool memory_budget(uint32_t heap, vk::DeviceSize& budget, vk::DeviceSize& usage) const;
+		/// Heap of the memory create_buffer gives to the buffer with these properties
+		uint32_t memory_heap(vk::Buffer buffer, vk::MemoryPropertyFlags properties) const;
+		/// Recreates the swapchain for the current size of the window, with its views, depth image and framebuffers.
+		/// The device must be idle, false while the window has no area. The number of images may change
+		bool recreate_swapchain();
 		/// Creates image
-		void create_image(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling image_tiling, vk::ImageUsageFlagBits usage, vk::MemoryPropertyFlagBits properties, vk::Image& image, vk::DeviceMemory& memory) const;
+		void create_image(uint32_t width, uint32_t height, vk::Format format, vk::ImageTiling image_tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlagBits properties, vk::Image& image, vk::DeviceMemory& memory) const;
 
 	private:
 		/// Initializes the debug callback extension
@@ -77,18 +103,22 @@ namespace vulkan
 		void choose_device(bool debug);
 		/// Creates the surface from the GLFWwindow
 		void create_surface(GLFWwindow* window);
-		/// Creates the swapchain from the GLFWwindow
-		void create_swapchain(GLFWwindow* window);
+		/// Creates the swapchain for the size of the window, taking over the old one if any
+		void create_swapchain(vk::PresentModeKHR preferred_present_mode, vk::SwapchainKHR old_swapchain);
+		/// Creates the offscreen images replacing the swapchain
+		void create_offscreen_images(uint32_t width, uint32_t height, uint32_t image_count);
 		/// Creates the swapchain views
 		void create_swapchain_image_views();
 		/// Create the depth image and memory
 		void create_depth_image();
 		/// Creates the render pass
 		void create_render_pass();
+		/// Creates a framebuffer for every image
+		void create_framebuffers();
+		/// Destroys the framebuffers, the image views and the depth image, which depend on the size of the swapchain
+		void destroy_swapchain_resources();
 		/// Creates the command pool
 		void create_command_pool();
-		/// Creates the uniform descriptor set pool
-		void create_descriptor_pool();
 		/// Creates the semaphores
 		void create_semaphores();
 	};
@@ -0,0 +1,187 @@
+#include "vulkan_descriptor_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+#include <profiler.h>
+
+using namespace vulkan;
+using namespace std;
+
+const uint32_t vulkan_descriptor_allocator::first_pool_sets;
+const uint32_t vulkan_descriptor_allocator::max_pool_sets;
+
+/// Descriptors of each type a pool holds for every set
+static const pair<vk::DescriptorType, uint32_t> descriptors_per_set[] =
+{
+	{ vk::DescriptorType::eUniformBuffer, 2 },
+	{ vk::DescriptorType::eStorageBuffer, 2 },
+	{ vk::DescriptorType::eCombinedImageSampler, 4 },
+	{ vk::DescriptorType::eSampledImage, 4 },
+	{ vk::DescriptorType::eSampler, 1 },
+};
+
+vulkan_descriptor_allocator::vulkan_descriptor_allocator(const env& e, uint32_t slot_count)
+	: _env(e), _transient_pools(slot_count)
+{
+	_track = profiler::get().add_track("Descriptors");
+}
+
+vulkan_descriptor_allocator::~vulkan_descriptor_allocator()
+{
+	for (auto pool : _cached_pools.pools)
+		_env.device.destroyDescriptorPool(pool);
+	for (auto& list : _transient_pools)
+	{
+		for (auto pool : list.pools)
+			_env.device.destroyDescriptorPool(pool);
+	}
+}
+
+uint32_t vulkan_descriptor_allocator::pool_sets(size_t index)
+{
+	return index < 8 ? min(first_pool_sets << index, max_pool_sets) : max_pool_sets;
+}
+
+vk::DescriptorPool vulkan_descriptor_allocator::create_pool(uint32_t set_count)
+{
+	vk::DescriptorPoolSize pool_sizes[size(descriptors_per_set)];
+	for (size_t i = 0; i < size(descriptors_per_set); i++)
+	{
+		pool_sizes[i].type = descriptors_per_set[i].first;
+		pool_sizes[i].descriptorCount = descriptors_per_set[i].second * set_count;
+	}
+
+	vk::DescriptorPoolCreateInfo create_info;
+	create_info.poolSizeCount = uint32_t(size(pool_sizes));
+	create_info.pPoolSizes = pool_sizes;
+	create_info.maxSets = set_count;
+
+	vk::DescriptorPool pool;
+	if (_env.device.createDescriptorPool(&create_info, nullptr, &pool) != vk::Result::eSuccess)
+		throw runtime_error("Failed to create descriptor pool");
+
+	_stats.pool_count++;
+	return pool;
+}
+
+vk::DescriptorSet vulkan_descriptor_allocator::allocate(pool_list& list, vk::DescriptorSetLayout layout)
+{
+	vk::DescriptorSetAllocateInfo allocate_info;
+	allocate_info.descriptorSetCount = 1;
+	allocate_info.pSetLayouts = &layout;
+
+	// A failure on a pool that is not new means it ran out of sets or descriptors, or is fragmented, and the next pool is tried
+	for (;;)
+	{
+		if (list.current == size(list.pools))
+			list.pools.push_back(create_pool(pool_sets(list.current)));
+		auto fresh = list.used_sets == 0;
+
+		vk::DescriptorSet set;
+		allocate_info.descriptorPool = list.pools[list.current];
+		if (list.used_sets < pool_sets(list.current) && _env.device.allocateDescriptorSets(&allocate_info, &set) == vk::Result::eSuccess)
+		{
+			list.used_sets++;
+			return set;
+		}
+
+		if (fresh)
+			throw runtime_error("Failed to allocate descriptor set");
+		list.current++;
+		list.used_sets = 0;
+	}
+}
+
+size_t vulkan_descriptor_allocator::hash(vk::DescriptorSetLayout layout, const descriptor_buffer_binding* bindings, size_t count)
+{
+	// FNV-1a over the handles and the ranges
+	uint64_t h = 14695981039346656037ull;
+	auto add = [&h](uint64_t value)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			h ^= (value >> (i * 8)) & 0xff;
+			h *= 1099511628211ull;
+		}
+	};
+
+	add(uint64_t(VkDescriptorSetLayout(layout)));
+	for (size_t i = 0; i < count; i++)
+	{
+		add(bindings[i].binding);
+		add(uint64_t(bindings[i].type));
+		add(uint64_t(VkBuffer(bindings[i].buffer)));
+		add(bindings[i].offset);
+		add(bindings[i].range);
+	}
+	return size_t(h);
+}
+
+vk::DescriptorSet vulkan_descriptor_allocator::get(vk::DescriptorSetLayout layout, const descriptor_buffer_binding* bindings, size_t count)
+{
+	_stats.requests++;
+
+	auto key = hash(layout, bindings, count);
+	auto range = _cache.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		auto& cached = it->second;
+		auto same = cached.layout == layout && equal(begin(cached.bindings), end(cached.bindings), bindings, bindings + count, [](const descriptor_buffer_binding& a, const descriptor_buffer_binding& b)
+		{
+			return a.binding == b.binding && a.type == b.type && a.buffer == b.buffer && a.offset == b.offset && a.range == b.range;
+		});
+		if (same)
+		{
+			_stats.reuses++;
+			return cached.set;
+		}
+	}
+
+	auto set = allocate(_cached_pools, layout);
+
+	vector<vk::DescriptorBufferInfo> buffer_infos(count);
+	vector<vk::WriteDescriptorSet> writes(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		buffer_infos[i].buffer = bindings[i].buffer;
+		buffer_infos[i].offset = bindings[i].offset;
+		buffer_infos[i].range = bindings[i].range;
+
+		writes[i].dstSet = set;
+		writes[i].dstBinding = bindings[i].binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = bindings[i].type;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &buffer_infos[i];
+	}
+	_env.device.updateDescriptorSets(uint32_t(count), data(writes), 0, nullptr);
+
+	_cache.emplace(key, cached_set{ layout, vector<descriptor_buffer_binding>(bindings, bindings + count), set });
+	return set;
+}
+
+vk::DescriptorSet vulkan_descriptor_allocator::allocate_transient(uint32_t slot, vk::DescriptorSetLayout layout)
+{
+	_stats.requests++;
+	return allocate(_transient_pools[slot], layout);
+}
+
+void vulkan_descriptor_allocator::reset(uint32_t slot)
+{
+	auto& list = _transient_pools[slot];
+	if (list.current == 0 && list.used_sets == 0)
+		return;
+
+	// The pools are kept, the next frames of the slot allocate from them again
+	for (size_t i = 0; i <= list.current && i < size(list.pools); i++)
+		_env.device.resetDescriptorPool(list.pools[i], vk::DescriptorPoolResetFlags());
+	list.current = 0;
+	list.used_sets = 0;
+}
+
+void vulkan_descriptor_allocator::record_counters() const
+{
+	auto& p = profiler::get();
+	auto time = p.now();
+	p.counter("descriptor pools", _track, time, double(_stats.pool_count));
+	p.counter("descriptor reuse %", _track, time, _stats.reuse_rate() * 100.);
+}
\ No newline at end of file
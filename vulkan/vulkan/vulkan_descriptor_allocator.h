@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "env.h"
+
+namespace vulkan
+{
+	/// Buffer written to a binding of a descriptor set
+	struct descriptor_buffer_binding
+	{
+		uint32_t binding;
+		vk::DescriptorType type;
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+		vk::DeviceSize range;
+	};
+
+	/// Counts of the allocator, reuses are the allocations answered from the cache
+	struct descriptor_stats
+	{
+		size_t pool_count = 0;
+		uint64_t requests = 0;
+		uint64_t reuses = 0;
+
+		double reuse_rate() const { return requests ? double(reuses) / requests : 0.; }
+	};
+
+	/**
+	 * Allocates descriptor sets from a list of pools that grows when the current one is full, each new pool twice the size of the previous.
+	 * Cached sets live as long as the allocator and are found again by their layout and bindings, transient sets live until their
+	 * frame slot is reset. Sets are never freed one by one, so the pools do not fragment
+	 */
+	class vulkan_descriptor_allocator
+	{
+	public:
+
+		/// Sets of the first pool, the pools grow up to max_pool_sets
+		static const uint32_t first_pool_sets = 64;
+		static const uint32_t max_pool_sets = 16384;
+
+		vulkan_descriptor_allocator(const env& e, uint32_t slot_count);
+		vulkan_descriptor_allocator(const vulkan_descriptor_allocator&) = delete;
+		vulkan_descriptor_allocator& operator=(const vulkan_descriptor_allocator&) = delete;
+		~vulkan_descriptor_allocator();
+
+		/// Set of a layout with these buffers written, allocated and written the first time only.
+		/// The set is found again by the buffer handles, so the buffers must live as long as the allocator
+		vk::DescriptorSet get(vk::DescriptorSetLayout layout, const descriptor_buffer_binding* bindings, size_t count);
+
+		/// Set of a layout valid until its frame slot is reset, the caller writes it.
+		/// The renderer finds all its sets with get, since its buffers do not change between frames, only the descriptor benchmark allocates transient sets
+		vk::DescriptorSet allocate_transient(uint32_t slot, vk::DescriptorSetLayout layout);
+
+		/// Resets the transient pools of a frame slot, its fence must be signaled
+		void reset(uint32_t slot);
+
+		const descriptor_stats& stats() const { return _stats; }
+
+		/// Adds the pool count and the reuse rate to the profiler
+		void record_counters() const;
+
+	private:
+
+		/// Pools of a lifetime, the sets come from the last one until it is full
+		struct pool_list
+		{
+			std::vector<vk::DescriptorPool> pools;
+			/// Pools kept by a reset, used again before new ones are created
+			size_t current = 0;
+			uint32_t used_sets = 0;
+		};
+
+		/// Cached set with the key it was found by, to tell apart equal hashes
+		struct cached_set
+		{
+			vk::DescriptorSetLayout layout;
+			std::vector<descriptor_buffer_binding> bindings;
+			vk::DescriptorSet set;
+		};
+
+		static size_t hash(vk::DescriptorSetLayout layout, const descriptor_buffer_binding* bindings, size_t count);
+
+		/// Allocates a set from the pools of a list, moving to the next pool when the current one is full
+		vk::DescriptorSet allocate(pool_list& list, vk::DescriptorSetLayout layout);
+
+		vk::DescriptorPool create_pool(uint32_t set_count);
+
+		/// Sets of the pool at an index of a list
+		static uint32_t pool_sets(size_t index);
+
+		const env& _env;
+		pool_list _cached_pools;
+		std::vector<pool_list> _transient_pools;
+		std::unordered_multimap<size_t, cached_set> _cache;
+		descriptor_stats _stats;
+		uint32_t _track = 0;
+	};
+}
\ No newline at end of file
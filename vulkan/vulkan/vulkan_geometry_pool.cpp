@@ -0,0 +1,105 @@
+#include "vulkan_geometry_pool.h"
+#include <cstring>
+
+using namespace vulkan;
+using namespace std;
+
+vulkan_geometry_pool::vulkan_geometry_pool(const env& e)
+	: _env(e) {}
+
+vulkan_geometry_pool::~vulkan_geometry_pool()
+{
+	destroy(_vertices);
+	destroy(_indices);
+}
+
+vk::VertexInputBindingDescription vulkan_geometry_pool::binding()
+{
+	vk::VertexInputBindingDescription binding;
+	binding.binding = 0;
+	binding.inputRate = vk::VertexInputRate::eVertex;
+	binding.stride = sizeof(vertex);
+	return binding;
+}
+
+array<vk::VertexInputAttributeDescription, 2> vulkan_geometry_pool::attributes()
+{
+	array<vk::VertexInputAttributeDescription, 2> attributes;
+
+	attributes[0].binding = 0;
+	attributes[0].location = 0;
+	attributes[0].format = vk::Format::eR32G32B32Sfloat;
+	attributes[0].offset = offsetof(vertex, position);
+
+	attributes[1].binding = 0;
+	attributes[1].location = 1;
+	attributes[1].format = vk::Format::eR32G32B32Sfloat;
+	attributes[1].offset = offsetof(vertex, normal);
+
+	return attributes;
+}
+
+uint32_t vulkan_geometry_pool::memory_heap() const
+{
+	return _env.memory_heap(_vertices.buffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+}
+
+void vulkan_geometry_pool::destroy(mapped_buffer& buffer)
+{
+	if (buffer.memory)
+	{
+		_env.device.unmapMemory(buffer.memory);
+		_env.device.freeMemory(buffer.memory);
+	}
+	if (buffer.buffer)
+		_env.device.destroyBuffer(buffer.buffer);
+	buffer = mapped_buffer();
+}
+
+void vulkan_geometry_pool::resize(mapped_buffer& buffer, size_t size, vk::BufferUsageFlagBits usage)
+{
+	if (size == buffer.size)
+		return;
+
+	mapped_buffer resized;
+	resized.size = size;
+	_env.create_buffer(size, resized.buffer, resized.memory, usage, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	resized.data = static_cast<char*>(_env.device.mapMemory(resized.memory, 0, size));
+
+	if (buffer.buffer)
+	{
+		// The old buffer may still be read by submitted command buffers
+		_env.device.waitIdle();
+		memcpy(resized.data, buffer.data, min(buffer.size, size));
+		destroy(buffer);
+	}
+
+	buffer = resized;
+}
+
+void vulkan_geometry_pool::reserve(size_t vertex_capacity, size_t index_capacity)
+{
+	if (vertex_capacity)
+		resize(_vertices, vertex_capacity * sizeof(vertex), vk::BufferUsageFlagBits::eVertexBuffer);
+	if (index_capacity)
+		resize(_indices, index_capacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eIndexBuffer);
+}
+
+void vulkan_geometry_pool::write(const mesh_range& range, const vertex* vertices, const uint32_t* indices)
+{
+	if (range.vertex_count)
+		memcpy(_vertices.data + range.vertex_offset * sizeof(vertex), vertices, range.vertex_count * sizeof(vertex));
+	if (range.index_count)
+		memcpy(_indices.data + range.first_index * sizeof(uint32_t), indices, range.index_count * sizeof(uint32_t));
+}
+
+void vulkan_geometry_pool::relocate(const vector<range_allocator::move>& vertex_moves, const vector<range_allocator::move>& index_moves)
+{
+	_env.device.waitIdle();
+
+	// The moves are sorted and only go towards the start, so they can be applied in place in order
+	for (auto& m : vertex_moves)
+		memmove(_vertices.data + m.to * sizeof(vertex), _vertices.data + m.from * sizeof(vertex), m.size * sizeof(vertex));
+	for (auto& m : index_moves)
+		memmove(_indices.data + m.to * sizeof(uint32_t), _indices.data + m.from * sizeof(uint32_t), m.size * sizeof(uint32_t));
+}
\ No newline at end of file
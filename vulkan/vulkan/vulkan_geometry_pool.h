@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <geometry_pool.h>
+#include "env.h"
+
+namespace vulkan
+{
+	/**
+	 * Geometry pool storing every mesh in one vulkan vertex buffer and one index buffer.
+	 * The buffers are host visible and stay mapped
+	 */
+	class vulkan_geometry_pool : public geometry_pool
+	{
+	public:
+
+		vulkan_geometry_pool(const env& e);
+		vulkan_geometry_pool(const vulkan_geometry_pool&) = delete;
+		vulkan_geometry_pool& operator=(const vulkan_geometry_pool&) = delete;
+		~vulkan_geometry_pool();
+
+		/// Buffer containing the interleaved vertices
+		vk::Buffer vertex_buffer() const { return _vertices.buffer; }
+
+		/// Buffer containing the 32 bits indices
+		vk::Buffer index_buffer() const { return _indices.buffer; }
+
+		/// Bytes of memory of the vertex and index buffers
+		size_t buffer_bytes() const { return _vertices.size + _indices.size; }
+
+		/// Heap the memory of the buffers comes from, once they exist
+		uint32_t memory_heap() const;
+
+		/// Binding description of the vertex buffer
+		static vk::VertexInputBindingDescription binding();
+
+		/// Attribute descriptions of the position and the normal
+		static std::array<vk::VertexInputAttributeDescription, 2> attributes();
+
+	protected:
+
+		void reserve(size_t vertex_capacity, size_t index_capacity) override;
+
+		void write(const mesh_range& range, const vertex* vertices, const uint32_t* indices) override;
+
+		void relocate(const std::vector<range_allocator::move>& vertex_moves, const std::vector<range_allocator::move>& index_moves) override;
+
+	private:
+
+		/// Mapped buffer and its memory
+		struct mapped_buffer
+		{
+			vk::Buffer buffer;
+			vk::DeviceMemory memory;
+			char* data = nullptr;
+			size_t size = 0;
+		};
+
+		/// Replaces the buffer by a buffer of size bytes with the same content
+		void resize(mapped_buffer& buffer, size_t size, vk::BufferUsageFlagBits usage);
+
+		/// Destroys the buffer
+		void destroy(mapped_buffer& buffer);
+
+		const env& _env;
+		mapped_buffer _vertices;
+		mapped_buffer _indices;
+	};
+}
\ No newline at end of file
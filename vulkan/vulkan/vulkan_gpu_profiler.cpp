@@ -0,0 +1,170 @@
+#include "vulkan_gpu_profiler.h"
+#include <profiler.h>
+
+using namespace vulkan;
+using namespace std;
+
+const vk::QueryPipelineStatisticFlags vulkan_gpu_profiler::statistics =
+	vk::QueryPipelineStatisticFlagBits::eInputAssemblyPrimitives |
+	vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+	vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+
+vulkan_gpu_profiler::vulkan_gpu_profiler(const env& e, uint32_t slot_count)
+	: _env(e), _slot_frames(slot_count, UINT64_MAX)
+{
+	auto queues = _env.physical_device.getQueueFamilyProperties();
+	_timestamps = queues[_env.render_queue_index].timestampValidBits > 0;
+	_period = _env.physical_device.getProperties().limits.timestampPeriod;
+	_gpu_track = profiler::get().add_track("GPU");
+
+	if (_timestamps)
+	{
+		vk::QueryPoolCreateInfo create_info;
+		create_info.queryType = vk::QueryType::eTimestamp;
+		create_info.queryCount = slot_count * timestamps_per_slot;
+		if (_env.device.createQueryPool(&create_info, nullptr, &_timestamp_pool) != vk::Result::eSuccess)
+			throw runtime_error("Failed to create timestamp query pool");
+		calibrate();
+	}
+
+	if (_env.pipeline_statistics)
+	{
+		vk::QueryPoolCreateInfo create_info;
+		create_info.queryType = vk::QueryType::ePipelineStatistics;
+		create_info.queryCount = slot_count;
+		create_info.pipelineStatistics = statistics;
+		if (_env.device.createQueryPool(&create_info, nullptr, &_statistics_pool) != vk::Result::eSuccess)
+			throw runtime_error("Failed to create pipeline statistics query pool");
+	}
+}
+
+vulkan_gpu_profiler::~vulkan_gpu_profiler()
+{
+	if (_timestamp_pool)
+		_env.device.destroyQueryPool(_timestamp_pool);
+	if (_statistics_pool)
+		_env.device.destroyQueryPool(_statistics_pool);
+}
+
+void vulkan_gpu_profiler::calibrate()
+{
+	vk::CommandBufferAllocateInfo allocate_info;
+	allocate_info.commandPool = _env.render_command_pool;
+	allocate_info.level = vk::CommandBufferLevel::ePrimary;
+	allocate_info.commandBufferCount = 1;
+
+	vk::CommandBuffer command_buffer;
+	if (_env.device.allocateCommandBuffers(&allocate_info, &command_buffer) != vk::Result::eSuccess)
+		throw runtime_error("Failed to allocate command buffer");
+
+	vk::CommandBufferBeginInfo begin_info;
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+	command_buffer.begin(&begin_info);
+	command_buffer.resetQueryPool(_timestamp_pool, 0, 1);
+	command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, _timestamp_pool, 0);
+	command_buffer.end();
+
+	vk::SubmitInfo submit_info;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	// The idle queue starts the command buffer as soon as it is submitted
+	auto cpu_time = profiler::get().now();
+	if (_env.render_queue.submit(1, &submit_info, vk::Fence()) != vk::Result::eSuccess)
+		throw runtime_error("Failed to submit");
+	_env.render_queue.waitIdle();
+
+	uint64_t gpu_time;
+	if (_env.device.getQueryPoolResults(_timestamp_pool, 0, 1, sizeof(gpu_time), &gpu_time, sizeof(gpu_time), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait) != vk::Result::eSuccess)
+		throw runtime_error("Failed to read the calibration timestamp");
+	_offset = int64_t(cpu_time) - int64_t(gpu_time * _period);
+
+	_env.device.freeCommandBuffers(_env.render_command_pool, 1, &command_buffer);
+}
+
+void vulkan_gpu_profiler::collect(uint32_t slot)
+{
+	auto frame = _slot_frames[slot];
+	if (frame == UINT64_MAX)
+		return;
+	_slot_frames[slot] = UINT64_MAX;
+
+	gpu_frame_stats stats;
+	stats.frame = frame;
+
+	auto& p = profiler::get();
+	if (_timestamps)
+	{
+		uint64_t ticks[timestamps_per_slot];
+		if (_env.device.getQueryPoolResults(_timestamp_pool, slot * timestamps_per_slot, timestamps_per_slot, sizeof(ticks), ticks, sizeof(uint64_t), vk::QueryResultFlagBits::e64) != vk::Result::eSuccess)
+			return;
+
+		uint64_t times[timestamps_per_slot];
+		for (uint32_t i = 0; i < timestamps_per_slot; i++)
+			times[i] = uint64_t(int64_t(ticks[i] * _period) + _offset);
+
+		stats.frame_ms = (times[2] - times[0]) / 1e6;
+		stats.pass_ms = (times[1] - times[0]) / 1e6;
+		p.record("frame", _gpu_track, times[0], times[2]);
+		p.record("render pass", _gpu_track, times[0], times[1]);
+	}
+
+	if (_statistics_pool)
+	{
+		// One value per statistic, in the order of their bits
+		uint64_t values[3];
+		if (_env.device.getQueryPoolResults(_statistics_pool, slot, 1, sizeof(values), values, sizeof(values), vk::QueryResultFlagBits::e64) != vk::Result::eSuccess)
+			return;
+
+		stats.primitives = values[0];
+		stats.vertex_invocations = values[1];
+		stats.fragment_invocations = values[2];
+
+		auto time = p.now();
+		p.counter("vertex invocations", _gpu_track, time, double(stats.vertex_invocations));
+		p.counter("fragment invocations", _gpu_track, time, double(stats.fragment_invocations));
+	}
+
+	_latest = stats;
+	_has_latest = true;
+}
+
+void vulkan_gpu_profiler::begin_frame(vk::CommandBuffer command_buffer, uint32_t slot, uint64_t frame)
+{
+	_slot_frames[slot] = frame;
+
+	if (_statistics_pool)
+		command_buffer.resetQueryPool(_statistics_pool, slot, 1);
+	if (_timestamps)
+	{
+		command_buffer.resetQueryPool(_timestamp_pool, slot * timestamps_per_slot, timestamps_per_slot);
+		command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, _timestamp_pool, slot * timestamps_per_slot);
+	}
+}
+
+void vulkan_gpu_profiler::begin_pass(vk::CommandBuffer command_buffer, uint32_t slot)
+{
+	if (_statistics_pool)
+		command_buffer.beginQuery(_statistics_pool, slot, vk::QueryControlFlags());
+}
+
+void vulkan_gpu_profiler::end_pass(vk::CommandBuffer command_buffer, uint32_t slot)
+{
+	if (_statistics_pool)
+		command_buffer.endQuery(_statistics_pool, slot);
+	if (_timestamps)
+		command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _timestamp_pool, slot * timestamps_per_slot + 1);
+}
+
+void vulkan_gpu_profiler::end_frame(vk::CommandBuffer command_buffer, uint32_t slot)
+{
+	if (_timestamps)
+		command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, _timestamp_pool, slot * timestamps_per_slot + 2);
+}
+
+bool vulkan_gpu_profiler::latest(gpu_frame_stats& stats) const
+{
+	if (_has_latest)
+		stats = _latest;
+	return _has_latest;
+}
\ No newline at end of file
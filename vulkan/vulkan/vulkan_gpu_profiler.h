@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <vector>
+#include <gpu_stats.h>
+#include "env.h"
+
+namespace vulkan
+{
+	/**
+	 * Measures the frames on the GPU with timestamp and pipeline statistics queries, one set of queries per frame slot.
+	 * A slot is read back when it is reused, after the fence of its previous frame, so reading never waits for the GPU.
+	 * The results are added to the GPU track of the profiler
+	 */
+	class vulkan_gpu_profiler
+	{
+	public:
+
+		/// Pipeline statistics counted by the queries, in the order of their results
+		static const vk::QueryPipelineStatisticFlags statistics;
+
+		vulkan_gpu_profiler(const env& e, uint32_t slot_count);
+		vulkan_gpu_profiler(const vulkan_gpu_profiler&) = delete;
+		vulkan_gpu_profiler& operator=(const vulkan_gpu_profiler&) = delete;
+		~vulkan_gpu_profiler();
+
+		/// Reads the results of the previous frame of a slot, its fence must be signaled
+		void collect(uint32_t slot);
+
+		/// Resets the queries of the slot and starts measuring, outside of a render pass
+		void begin_frame(vk::CommandBuffer command_buffer, uint32_t slot, uint64_t frame);
+
+		/// Starts the statistics of the render pass, right before it begins
+		void begin_pass(vk::CommandBuffer command_buffer, uint32_t slot);
+
+		/// Ends the statistics of the render pass, right after it ends
+		void end_pass(vk::CommandBuffer command_buffer, uint32_t slot);
+
+		/// Writes the timestamp of the end of the frame
+		void end_frame(vk::CommandBuffer command_buffer, uint32_t slot);
+
+		/// Statistics of the latest frame read back, false if there is none yet
+		bool latest(gpu_frame_stats& stats) const;
+
+	private:
+
+		/// Timestamps of a slot: frame begin, render pass end, frame end
+		static const uint32_t timestamps_per_slot = 3;
+
+		/// Offset from the GPU timestamps to the profiler time, measured with a timestamp written right after a submit
+		void calibrate();
+
+		const env& _env;
+		bool _timestamps = false;
+		double _period = 1.;
+		int64_t _offset = 0;
+		uint32_t _gpu_track = 0;
+
+		vk::QueryPool _timestamp_pool;
+		vk::QueryPool _statistics_pool;
+		/// Frame measured by every slot, or UINT64_MAX when it has nothing to read
+		std::vector<uint64_t> _slot_frames;
+		gpu_frame_stats _latest;
+		bool _has_latest = false;
+	};
+}
\ No newline at end of file
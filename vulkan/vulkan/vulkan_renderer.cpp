@@ -1,59 +1,131 @@
 #include "vulkan_renderer.h"
+#include <uniforms.h>
+#include <profiler.h>
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
 #include <fstream>
 
 using namespace vulkan;
 using namespace std;
 
-struct uniform_buffer_object {
-	glm::mat4 model;
-	glm::mat4 view;
-	glm::mat4 proj;
-	material material;
-	light point;
-	light sun;
-	light spot;
-	glm::vec4 eye;
-};
-
-struct object_vulkan_data
+vulkan_renderer::vulkan_renderer(bool debug, vk::PresentModeKHR present_mode)
+	: _debug(debug), _present_mode(present_mode) {}
+
+/// Offscreen images of the headless mode, frames rendered while the previous ones are read back
+static const uint32_t headless_images = 3;
+
+void vulkan_renderer::init(GLFWwindow* window)
 {
-	vk::Pipeline pipeline;
-	vk::PipelineLayout pipeline_layout;
-	vector<vk::CommandBuffer> command_buffers;
-	vk::Buffer ubo_buffer;
-	vk::DeviceMemory ubo_memory;
-	vk::DescriptorSetLayout descriptor_set_layout;
-	vk::DescriptorSet descriptor_set;
-};
-
-struct model_vulkan_data
+	_env = std::make_unique<env>(window, _debug, _present_mode);
+	glfwGetFramebufferSize(window, &_window_width, &_window_height);
+	init_frames();
+}
+
+void vulkan_renderer::init_headless(uint32_t width, uint32_t height)
 {
-	vk::VertexInputAttributeDescription vertex;
-	vk::VertexInputAttributeDescription normal;
-	vk::VertexInputBindingDescription vertex_binding;
-	vk::VertexInputBindingDescription normal_binding;
-	vk::Buffer vertex_buffer;
-	vk::Buffer normal_buffer;
-	vk::Buffer index_buffer;
-	vk::DeviceMemory vertex_memory;
-	vk::DeviceMemory normal_memory;
-	vk::DeviceMemory index_memory;
-};
-
-vulkan_renderer::vulkan_renderer(bool debug)
-	: _debug(debug) {}
+	_env = std::make_unique<env>(width, height, headless_images, _debug);
+	init_frames();
+
+	// Host buffers the offscreen images are copied to, mapped for the whole life of the renderer
+	auto image_size = size_t(width) * height * 4;
+	_readback_buffers.resize(headless_images);
+	_readback_memories.resize(headless_images);
+	_readback_data.resize(headless_images);
+	for (uint32_t i = 0; i < headless_images; i++)
+	{
+		_env->create_buffer(image_size, _readback_buffers[i], _readback_memories[i], vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		_readback_data[i] = static_cast<const uint8_t*>(_env->device.mapMemory(_readback_memories[i], 0, image_size));
+	}
+}
 
-void vulkan_renderer::init(GLFWwindow* window)
+void vulkan_renderer::init_frames()
 {
-	_env = std::make_unique<env>(window, _debug);
+	_geometry = std::make_unique<vulkan_geometry_pool>(*_env);
+
+	init_layouts();
+	init_image_resources();
+}
+
+void vulkan_renderer::init_image_resources()
+{
+	_gpu_profiler = std::make_unique<vulkan_gpu_profiler>(*_env, uint32_t(size(_env->framebuffers)));
+	_descriptors = std::make_unique<vulkan_descriptor_allocator>(*_env, uint32_t(size(_env->framebuffers)));
+
+	_frame_command_buffers.resize(size(_env->framebuffers));
+	_image_frame_counts.assign(size(_env->framebuffers), 0);
+
+	vk::CommandBufferAllocateInfo allocate_info;
+	allocate_info.commandPool = _env->render_command_pool;
+	allocate_info.level = vk::CommandBufferLevel::ePrimary;
+	allocate_info.commandBufferCount = size(_frame_command_buffers);
+
+	if (_env->device.allocateCommandBuffers(&allocate_info, data(_frame_command_buffers)) != vk::Result::eSuccess)
+		throw runtime_error("Failed to allocate command buffer");
+
+	// Signaled so the first wait on each image returns immediately
+	vk::FenceCreateInfo fence_create_info;
+	fence_create_info.flags = vk::FenceCreateFlagBits::eSignaled;
+
+	_frame_fences.resize(size(_env->framebuffers));
+	for (auto& fence : _frame_fences)
+	{
+		if (_env->device.createFence(&fence_create_info, nullptr, &fence) != vk::Result::eSuccess)
+			throw runtime_error("Failed to create fence");
+	}
+
+	// Every image has its frame uniforms, written once its fence is signaled, the descriptor sets are found by their buffers when recording
+	auto image_count = size(_env->framebuffers);
+	_frame_uniform_buffers.resize(image_count);
+	_frame_uniform_memories.resize(image_count);
+	_frame_uniforms.resize(image_count);
+
+	for (size_t i = 0; i < image_count; i++)
+	{
+		_env->create_buffer(sizeof(frame_uniforms), _frame_uniform_buffers[i], _frame_uniform_memories[i], vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		_frame_uniforms[i] = static_cast<frame_uniforms*>(_env->device.mapMemory(_frame_uniform_memories[i], 0, sizeof(frame_uniforms)));
+	}
+}
+
+void vulkan_renderer::destroy_image_resources()
+{
+	for (size_t i = 0; i < size(_frame_uniform_buffers); i++)
+	{
+		_env->device.unmapMemory(_frame_uniform_memories[i]);
+		_env->device.destroyBuffer(_frame_uniform_buffers[i]);
+		_env->device.freeMemory(_frame_uniform_memories[i]);
+	}
+	_frame_uniform_buffers.clear();
+	_frame_uniform_memories.clear();
+	_frame_uniforms.clear();
+	_descriptors.reset();
+	_gpu_profiler.reset();
+
+	for (auto fence : _frame_fences)
+		_env->device.destroyFence(fence);
+	_frame_fences.clear();
+	_env->device.freeCommandBuffers(_env->render_command_pool, size(_frame_command_buffers), data(_frame_command_buffers));
+	_frame_command_buffers.clear();
+	_image_frame_counts.clear();
+}
+
+/// Path of glslangValidator, GLSLANG_VALIDATOR overrides the default of the platform
+static string glslang_validator()
+{
+	if (auto* path = getenv("GLSLANG_VALIDATOR"))
+		return path;
+#ifdef _WIN32
+	return "C:/VulkanSDK/1.0.30.0/Bin32/glslangValidator.exe";
+#else
+	return "glslangValidator";
+#endif
 }
 
 static string create_spv(const string& source, const string& stage)
 {
 	string spv = "tmp." + stage + ".spv";
 	ostringstream oss;
-	oss << "C:/VulkanSDK/1.0.30.0/Bin32/glslangValidator.exe " << source << " ";
+	oss << glslang_validator() << " " << source << " ";
 	oss << "-V -S " << stage << " ";
 	oss << "-o " << spv;
 	if (system(oss.str().c_str()) != 0)
@@ -89,278 +161,485 @@ vk::PipelineShaderStageCreateInfo vulkan_renderer::create_shader(const string& s
 	stage_create_info.pName = "main";
 
 	file.close();
-	ostringstream oss;
-	oss << "del " << spv;
-	system(oss.str().c_str());
+	std::remove(spv.c_str());
 
 	return stage_create_info;
 }
 
+void vulkan_renderer::init_layouts()
+{
+	// Binding 0 holds the uniforms of the frame, binding 1 the materials of the scene
+	vk::DescriptorSetLayoutBinding bindings[2];
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = vk::ShaderStageFlagBits::eAllGraphics;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = vk::DescriptorType::eStorageBuffer;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+	vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_create_info;
+	descriptor_set_layout_create_info.bindingCount = 2;
+	descriptor_set_layout_create_info.pBindings = bindings;
+
+	if (_env->device.createDescriptorSetLayout(&descriptor_set_layout_create_info, nullptr, &_descriptor_set_layout) != vk::Result::eSuccess)
+		throw runtime_error("Failed to create descriptor set layout");
+
+	// The model matrix and the material of a draw are pushed, every pipeline shares the layout
+	vk::PushConstantRange push_constant_range;
+	push_constant_range.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(object_push_constants);
+
+	vk::PipelineLayoutCreateInfo pipeline_layout_create_info;
+	pipeline_layout_create_info.setLayoutCount = 1;
+	pipeline_layout_create_info.pSetLayouts = &_descriptor_set_layout;
+	pipeline_layout_create_info.pushConstantRangeCount = 1;
+	pipeline_layout_create_info.pPushConstantRanges = &push_constant_range;
+
+	if (_env->device.createPipelineLayout(&pipeline_layout_create_info, nullptr, &_pipeline_layout) != vk::Result::eSuccess)
+		throw runtime_error("Failed to create pipeline layout");
+}
+
+vk::Pipeline vulkan_renderer::create_pipeline(const pipeline_vulkan_data& pipeline_data)
+{
+	auto vertex_binding = vulkan_geometry_pool::binding();
+	auto vertex_attributes = vulkan_geometry_pool::attributes();
+
+	vk::PipelineVertexInputStateCreateInfo vertex_input_info;
+	vertex_input_info.vertexBindingDescriptionCount = 1;
+	vertex_input_info.pVertexBindingDescriptions = &vertex_binding;
+	vertex_input_info.vertexAttributeDescriptionCount = uint32_t(size(vertex_attributes));
+	vertex_input_info.pVertexAttributeDescriptions = data(vertex_attributes);
+
+	vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info;
+	input_assembly_state_create_info.topology = vk::PrimitiveTopology::eTriangleList;
+	input_assembly_state_create_info.primitiveRestartEnable = false;
+
+	// The viewport and the scissor are set when recording, so the pipelines survive a resize
+	vk::PipelineViewportStateCreateInfo viewport_state_create_info;
+	viewport_state_create_info.viewportCount = 1;
+	viewport_state_create_info.scissorCount = 1;
+
+	vk::DynamicState dynamic_states[] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	vk::PipelineDynamicStateCreateInfo dynamic_state_create_info;
+	dynamic_state_create_info.dynamicStateCount = 2;
+	dynamic_state_create_info.pDynamicStates = dynamic_states;
+
+	vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info;
+	rasterization_state_create_info.depthClampEnable = false;
+	rasterization_state_create_info.rasterizerDiscardEnable = false;
+	rasterization_state_create_info.polygonMode = vk::PolygonMode::eFill;
+	rasterization_state_create_info.lineWidth = 1.f;
+	rasterization_state_create_info.cullMode = vk::CullModeFlagBits::eNone;
+	rasterization_state_create_info.frontFace = vk::FrontFace::eClockwise;
+	rasterization_state_create_info.depthBiasEnable = false;
+
+	vk::PipelineMultisampleStateCreateInfo multisample_state_create_info;
+	multisample_state_create_info.sampleShadingEnable = false;
+	multisample_state_create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
+
+	vk::PipelineColorBlendAttachmentState color_blend_attachment_state;
+	color_blend_attachment_state.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+	color_blend_attachment_state.blendEnable = false;
+
+	vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info;
+	color_blend_state_create_info.logicOpEnable = false;
+	color_blend_state_create_info.attachmentCount = 1;
+	color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
+
+	vk::PipelineDepthStencilStateCreateInfo depth_stencil_state_create_info;
+	depth_stencil_state_create_info.depthTestEnable = true;
+	depth_stencil_state_create_info.depthWriteEnable = true;
+	depth_stencil_state_create_info.depthCompareOp = vk::CompareOp::eLess;
+	depth_stencil_state_create_info.depthBoundsTestEnable = false;
+	depth_stencil_state_create_info.stencilTestEnable = false;
+
+	vk::PipelineShaderStageCreateInfo stages[] = { pipeline_data.vertex_stage, pipeline_data.fragment_stage };
+
+	vk::GraphicsPipelineCreateInfo pipeline_create_info;
+	pipeline_create_info.stageCount = 2;
+	pipeline_create_info.pStages = stages;
+	pipeline_create_info.pVertexInputState = &vertex_input_info;
+	pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
+	pipeline_create_info.pViewportState = &viewport_state_create_info;
+	pipeline_create_info.pRasterizationState = &rasterization_state_create_info;
+	pipeline_create_info.pMultisampleState = &multisample_state_create_info;
+	pipeline_create_info.pDepthStencilState = &depth_stencil_state_create_info;
+	pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
+	pipeline_create_info.pDynamicState = &dynamic_state_create_info;
+	pipeline_create_info.layout = _pipeline_layout;
+	pipeline_create_info.renderPass = _env->render_pass;
+	pipeline_create_info.subpass = 0;
+
+	vk::Pipeline pipeline;
+	if (_env->device.createGraphicsPipelines(vk::PipelineCache(), 1, &pipeline_create_info, nullptr, &pipeline) != vk::Result::eSuccess)
+		throw runtime_error("Failed to create pipeline");
+	return pipeline;
+}
+
 void vulkan_renderer::init_scene(scene& scene)
 {
-	object_vulkan_data object_data;
+	// Growing the pool replaces its buffers, so the space of the boxes and of the streamed meshes is reserved at once.
+	// Welding only removes vertices, the sizes of the models are upper bounds, and the memory budget caps them
+	auto box = create_box(aabb{ glm::vec3(0.f), glm::vec3(0.f) });
+	size_t vertex_count = 0;
+	size_t index_count = 0;
+	size_t box_vertex_count = 0;
+	size_t box_index_count = 0;
+	for (auto& m : scene.objects.meshes())
+	{
+		if (_meshes.valid(m->resource))
+			continue;
+		vertex_count += size(m->vertices);
+		index_count += size(m->indices);
+		box_vertex_count += _upload_budget ? size(box.vertices) : 0;
+		box_index_count += _upload_budget ? size(box.indices) : 0;
+	}
+	if (_upload_budget && _memory_budget)
+	{
+		auto bytes = vertex_count * sizeof(vertex) + index_count * sizeof(uint32_t);
+		auto scale = min(1.0, double(_memory_budget) / max(bytes, size_t(1)));
+		vertex_count = size_t(vertex_count * scale);
+		index_count = size_t(index_count * scale);
+	}
+	_geometry->reserve_more(vertex_count + box_vertex_count, index_count + box_index_count);
 
-	for (auto& obj : scene.objects)
+	// Without an upload budget the meshes are uploaded now, otherwise their boxes are drawn until the streamer prepared them.
+	// Without a memory budget every mesh is requested now, otherwise when it is first visible
+	for (auto& m : scene.objects.meshes())
 	{
-		auto vertex_stage = create_shader(obj.vertex_shader.filename, vk::ShaderStageFlagBits::eVertex);
-		auto fragment_stage = create_shader(obj.fragment_shader.filename, vk::ShaderStageFlagBits::eFragment);
+		if (_meshes.valid(m->resource))
+			continue;
 
-		obj.vertex_shader.user_data = vertex_stage;
-		obj.fragment_shader.user_data = fragment_stage;
+		if (_upload_budget)
+		{
+			m->resource = _meshes.add(model_vulkan_data{ _geometry->add(create_box(m->box)), m->box });
+			_residency.add(m->resource);
+			if (!_residency.budget() && _residency.request(m->resource))
+				_streamer.request(m->resource, m);
+		}
+		else
+		{
+			m->resource = _meshes.add(model_vulkan_data{ _geometry->add(*m), m->box });
+			_residency.add(m->resource, size(m->vertices) * sizeof(vertex) + size(m->indices) * sizeof(uint32_t));
+		}
+	}
 
-		model_vulkan_data model_data;
+	// The shader modules and the pipeline are shared by every object of a scene pipeline
+	for (auto& p : scene.objects.pipelines())
+	{
+		if (_pipelines.valid(p.resource))
+			continue;
+
+		pipeline_vulkan_data pipeline_data;
+		pipeline_data.vertex_stage = create_shader(p.vertex_shader.filename, vk::ShaderStageFlagBits::eVertex);
+		pipeline_data.fragment_stage = create_shader(p.fragment_shader.filename, vk::ShaderStageFlagBits::eFragment);
+		pipeline_data.pipeline = create_pipeline(pipeline_data);
+		p.resource = _pipelines.add(pipeline_data);
+	}
 
-		if (obj.model->user_data.empty())
-		{
+	// The materials of an earlier scene may still be read by frames in flight, and the cached sets refer to their buffer
+	if (_material_buffer)
+	{
+		_env->device.waitIdle();
+		_env->device.destroyBuffer(_material_buffer);
+		_env->device.freeMemory(_material_memory);
+		_descriptors = std::make_unique<vulkan_descriptor_allocator>(*_env, uint32_t(size(_frame_fences)));
+	}
 
-			model_data.vertex_binding.binding = 0;
-			model_data.vertex_binding.inputRate = vk::VertexInputRate::eVertex;
-			model_data.vertex_binding.stride = sizeof(obj.model->vertices[0]);
+	// The objects index the materials with their push constants, an empty scene still binds a buffer
+	auto& materials = scene.objects.materials();
+	auto material_count = max(size(materials), size_t(1));
+	vector<material> material_data(material_count);
+	copy(begin(materials), end(materials), begin(material_data));
+	_env->create_memory(material_count * sizeof(material), _material_buffer, _material_memory, data(material_data), vk::BufferUsageFlagBits::eStorageBuffer);
+}
 
-			model_data.normal_binding.binding = 1;
-			model_data.normal_binding.inputRate = vk::VertexInputRate::eVertex;
-			model_data.normal_binding.stride = sizeof(obj.model->normals[0]);
+void vulkan_renderer::set_memory_budget(size_t bytes)
+{
+	_memory_budget = bytes;
+	_residency.set_budget(bytes);
+}
 
-			model_data.vertex.binding = 0;
-			model_data.vertex.location = 0;
-			model_data.vertex.format = vk::Format::eR32G32B32Sfloat;
-			model_data.vertex.offset = 0;
+/// Frames between two reads of the memory budget of the device
+static const uint64_t memory_budget_interval = 64;
 
-			model_data.normal.binding = 1;
-			model_data.normal.location = 1;
-			model_data.normal.format = vk::Format::eR32G32B32Sfloat;
-			model_data.normal.offset = 0;
+void vulkan_renderer::update_memory_budget()
+{
+	vk::DeviceSize budget, usage;
+	if (!_geometry->vertex_buffer() || !_env->memory_budget(_geometry->memory_heap(), budget, usage))
+		return;
+
+	// The budget of the heap covers every allocation of the process, the meshes get what the others leave with a margin
+	auto others = usage - min(usage, vk::DeviceSize(_geometry->buffer_bytes()));
+	auto available = size_t(budget > others ? (budget - others) / 10 * 9 : 0);
+	available = max(available, size_t(1));
+	_residency.set_budget(_memory_budget ? min(_memory_budget, available) : available);
+}
 
-			_env->create_memory(sizeof(obj.model->vertices[0]) * size(obj.model->vertices), model_data.vertex_buffer, model_data.vertex_memory, data(obj.model->vertices), vk::BufferUsageFlagBits::eVertexBuffer);
-			_env->create_memory(sizeof(obj.model->normals[0]) * size(obj.model->normals), model_data.normal_buffer, model_data.normal_memory, data(obj.model->normals), vk::BufferUsageFlagBits::eVertexBuffer);
-			_env->create_memory(sizeof(obj.model->indices[0]) * size(obj.model->indices), model_data.index_buffer, model_data.index_memory, data(obj.model->indices), vk::BufferUsageFlagBits::eIndexBuffer);
+void vulkan_renderer::stream_meshes(const scene& scene, const vector<uint32_t>& visible)
+{
+	PROFILE_ZONE("stream");
+
+	if (_frame_count % memory_budget_interval == 0)
+		update_memory_budget();
+
+	auto& mesh_ids = scene.objects.mesh_ids();
+	auto& meshes = scene.objects.meshes();
+	for (auto index : visible)
+	{
+		auto& m = meshes[mesh_ids[index]];
+		if (_residency.use(m->resource, _frame_count))
+			_streamer.request(m->resource, m);
+	}
 
-			obj.model->user_data = model_data;
+	// The pool is host visible, uploading is a copy into ranges no frame in flight reads
+	if (_streamer.pending())
+	{
+		_streamer.take(_upload_budget, _streamed);
+		for (auto& m : _streamed)
+		{
+			auto& model_data = _meshes[m.key];
+			_geometry->replace(model_data.mesh, data(m.vertices), size(m.vertices), data(m.indices), size(m.indices), _frame_count);
+			_residency.made_resident(m.key, m.byte_size());
 		}
-		else
-			model_data = any_cast<model_vulkan_data>(obj.model->user_data);
-
-		uniform_buffer_object ubo;
-		ubo.model = obj.trans;
-		ubo.proj = scene.projection;
-		ubo.view = scene.view;
-		ubo.point = scene.point;
-		ubo.material = obj.material;
-		ubo.eye = scene.eye;
-		
-		_env->create_memory(sizeof(uniform_buffer_object), object_data.ubo_buffer, object_data.ubo_memory, &ubo, vk::BufferUsageFlagBits::eUniformBuffer);
-
-		vk::VertexInputAttributeDescription attr[] = { model_data.vertex, model_data.normal };
-		vk::VertexInputBindingDescription bindings[] = { model_data.vertex_binding, model_data.normal_binding };
-
-		vk::PipelineVertexInputStateCreateInfo vertex_input_info;
-		vertex_input_info.vertexBindingDescriptionCount = 2;
-		vertex_input_info.pVertexBindingDescriptions = bindings;
-		vertex_input_info.vertexAttributeDescriptionCount = 2;
-		vertex_input_info.pVertexAttributeDescriptions = attr;
-
-		vk::PipelineInputAssemblyStateCreateInfo input_assembly_state_create_info;
-		input_assembly_state_create_info.topology = vk::PrimitiveTopology::eTriangleList;
-		input_assembly_state_create_info.primitiveRestartEnable = false;
-
-		vk::Viewport viewport;
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-		viewport.width = float(_env->swapchain_extent.width);
-		viewport.height = float(_env->swapchain_extent.height);
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
-
-		vk::Rect2D scissor;
-		scissor.offset = vk::Offset2D{ 0, 0 };
-		scissor.extent = _env->swapchain_extent;
-
-		vk::PipelineViewportStateCreateInfo viewport_state_create_info;
-		viewport_state_create_info.viewportCount = 1;
-		viewport_state_create_info.pViewports = &viewport;
-		viewport_state_create_info.scissorCount = 1;
-		viewport_state_create_info.pScissors = &scissor;
-
-		vk::PipelineRasterizationStateCreateInfo rasterization_state_create_info;
-		rasterization_state_create_info.depthClampEnable = false;
-		rasterization_state_create_info.rasterizerDiscardEnable = false;
-		rasterization_state_create_info.polygonMode = vk::PolygonMode::eFill;
-		rasterization_state_create_info.lineWidth = 1.f;
-		rasterization_state_create_info.cullMode = vk::CullModeFlagBits::eNone;
-		rasterization_state_create_info.frontFace = vk::FrontFace::eClockwise;
-		rasterization_state_create_info.depthBiasEnable = false;
-
-		vk::PipelineMultisampleStateCreateInfo multisample_state_create_info;
-		multisample_state_create_info.sampleShadingEnable = false;
-		multisample_state_create_info.rasterizationSamples = vk::SampleCountFlagBits::e1;
-
-		vk::PipelineColorBlendAttachmentState color_blend_attachment_state;
-		color_blend_attachment_state.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-		color_blend_attachment_state.blendEnable = false;
-
-		vk::PipelineColorBlendStateCreateInfo color_blend_state_create_info;
-		color_blend_state_create_info.logicOpEnable = false;
-		color_blend_state_create_info.attachmentCount = 1;
-		color_blend_state_create_info.pAttachments = &color_blend_attachment_state;
-
-		vk::DescriptorSetLayoutBinding descriptor_set_layout_binding;
-		descriptor_set_layout_binding.binding = 0;
-		descriptor_set_layout_binding.descriptorType = vk::DescriptorType::eUniformBuffer;
-		descriptor_set_layout_binding.descriptorCount = 1;
-		descriptor_set_layout_binding.stageFlags = vk::ShaderStageFlagBits::eAllGraphics;
-
-		vk::DescriptorSetLayoutCreateInfo descriptor_set_layout_create_info;
-		descriptor_set_layout_create_info.bindingCount = 1;
-		descriptor_set_layout_create_info.pBindings = &descriptor_set_layout_binding;
-
-		if (_env->device.createDescriptorSetLayout(&descriptor_set_layout_create_info, nullptr, &object_data.descriptor_set_layout) != vk::Result::eSuccess)
-			throw runtime_error("Failed to create descriptor set layout");
-
-		vk::DescriptorSetAllocateInfo descriptor_set_allocate_info;
-		descriptor_set_allocate_info.descriptorPool = _env->descriptor_pool;
-		descriptor_set_allocate_info.descriptorSetCount = 1;
-		descriptor_set_allocate_info.pSetLayouts = &object_data.descriptor_set_layout;
-
-		if (_env->device.allocateDescriptorSets(&descriptor_set_allocate_info, &object_data.descriptor_set) != vk::Result::eSuccess)
-			throw runtime_error("Failed to allocate descriptor set");
-
-		vk::DescriptorBufferInfo buffer_info;
-		buffer_info.buffer = object_data.ubo_buffer;
-		buffer_info.offset = 0;
-		buffer_info.range = sizeof(uniform_buffer_object);
-
-		vk::WriteDescriptorSet write_descriptor_set;
-		write_descriptor_set.dstSet = object_data.descriptor_set;
-		write_descriptor_set.dstBinding = 0;
-		write_descriptor_set.dstArrayElement = 0;
-		write_descriptor_set.descriptorType = vk::DescriptorType::eUniformBuffer;
-		write_descriptor_set.descriptorCount = 1;
-		write_descriptor_set.pBufferInfo = &buffer_info;
-		_env->device.updateDescriptorSets(1, &write_descriptor_set, 0, nullptr);
-
-		vk::PipelineLayoutCreateInfo pipeline_layout_create_info;
-		pipeline_layout_create_info.setLayoutCount = 1;
-		pipeline_layout_create_info.pSetLayouts = &object_data.descriptor_set_layout;
-
-		if (_env->device.createPipelineLayout(&pipeline_layout_create_info, nullptr, &object_data.pipeline_layout) != vk::Result::eSuccess)
-			throw runtime_error("Failed to create pipeline layout");
-
-		vk::PipelineDepthStencilStateCreateInfo depth_stencil_state_create_info;
-		depth_stencil_state_create_info.depthTestEnable = true;
-		depth_stencil_state_create_info.depthWriteEnable = true;
-		depth_stencil_state_create_info.depthCompareOp = vk::CompareOp::eLess;
-		depth_stencil_state_create_info.depthBoundsTestEnable = false;
-		depth_stencil_state_create_info.stencilTestEnable = false;
-
-		vk::PipelineShaderStageCreateInfo stages[] = { vertex_stage, fragment_stage };
-
-		vk::GraphicsPipelineCreateInfo pipeline_create_info;
-		pipeline_create_info.stageCount = 2;
-		pipeline_create_info.pStages = stages;
-		pipeline_create_info.pVertexInputState = &vertex_input_info;
-		pipeline_create_info.pInputAssemblyState = &input_assembly_state_create_info;
-		pipeline_create_info.pViewportState = &viewport_state_create_info;
-		pipeline_create_info.pRasterizationState = &rasterization_state_create_info;
-		pipeline_create_info.pMultisampleState = &multisample_state_create_info;
-		pipeline_create_info.pDepthStencilState = &depth_stencil_state_create_info;
-		pipeline_create_info.pColorBlendState = &color_blend_state_create_info;
-		pipeline_create_info.pDynamicState = nullptr;
-		pipeline_create_info.layout = object_data.pipeline_layout;
-		pipeline_create_info.renderPass = _env->render_pass;
-		pipeline_create_info.subpass = 0;
-
-		if (_env->device.createGraphicsPipelines(vk::PipelineCache(), 1, &pipeline_create_info, nullptr, &object_data.pipeline) != vk::Result::eSuccess)
-			throw runtime_error("Failed to create pipeline");
-
-		object_data.command_buffers.resize(size(_env->framebuffers));
-
-		vk::CommandBufferAllocateInfo allocate_info;
-		allocate_info.commandPool = _env->render_command_pool;
-		allocate_info.level = vk::CommandBufferLevel::ePrimary;
-		allocate_info.commandBufferCount = size(object_data.command_buffers);
-
-		if (_env->device.allocateCommandBuffers(&allocate_info, data(object_data.command_buffers)) != vk::Result::eSuccess)
-			throw runtime_error("Failed to allocate command buffer");
-
-		for (size_t i = 0; i < size(object_data.command_buffers); i++)
+		_streamed.clear();
+	}
+
+	if (_residency.evict(_frame_count, _evicted))
+	{
+		for (auto mesh : _evicted)
 		{
-			vk::CommandBufferBeginInfo begin_info;
-			begin_info.flags = vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+			auto& model_data = _meshes[mesh];
+			_geometry->replace(model_data.mesh, create_box(model_data.box), _frame_count);
+		}
+		_evicted.clear();
+	}
 
-			object_data.command_buffers[i].begin(&begin_info);
+	// Once the last replaced ranges are freed, the holes they left are packed
+	_geometry->free_retired(_completed_frames);
+	if (_geometry->compact())
+		_residency.compacted();
+	_residency.record_counters();
+}
 
-			vk::RenderPassBeginInfo render_pass_begin_info;
-			render_pass_begin_info.renderPass = _env->render_pass;
-			render_pass_begin_info.framebuffer = _env->framebuffers[i];
-			render_pass_begin_info.renderArea.offset = vk::Offset2D{ 0, 0 };
-			render_pass_begin_info.renderArea.extent = _env->swapchain_extent;
-			vk::ClearValue black;
-			vk::ClearValue depth;
-			depth.depthStencil.depth = 1.f;
-			black.color.float32[0] = 0.f;
-			black.color.float32[1] = 0.f;
-			black.color.float32[2] = 0.f;
-			black.color.float32[3] = 1.f;
-			vk::ClearValue clear_values[] = { black, depth };
+void vulkan_renderer::record_frame(vk::CommandBuffer command_buffer, uint32_t image_index, const vector<uint32_t>& visible, const object_push_constants* constants, const scene& scene)
+{
+	auto& mesh_ids = scene.objects.mesh_ids();
+	auto& meshes = scene.objects.meshes();
+	auto& pipeline_ids = scene.objects.pipeline_ids();
+	auto& pipelines = scene.objects.pipelines();
+
+	command_buffer.reset(vk::CommandBufferResetFlags());
+
+	vk::CommandBufferBeginInfo begin_info;
+	begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+
+	command_buffer.begin(&begin_info);
+
+	_gpu_profiler->begin_frame(command_buffer, image_index, _frame_count);
+	_gpu_profiler->begin_pass(command_buffer, image_index);
+
+	vk::RenderPassBeginInfo render_pass_begin_info;
+	render_pass_begin_info.renderPass = _env->render_pass;
+	render_pass_begin_info.framebuffer = _env->framebuffers[image_index];
+	render_pass_begin_info.renderArea.offset = vk::Offset2D{ 0, 0 };
+	render_pass_begin_info.renderArea.extent = _env->swapchain_extent;
+	vk::ClearValue black;
+	vk::ClearValue depth;
+	depth.depthStencil.depth = 1.f;
+	black.color.float32[0] = 0.f;
+	black.color.float32[1] = 0.f;
+	black.color.float32[2] = 0.f;
+	black.color.float32[3] = 1.f;
+	vk::ClearValue clear_values[] = { black, depth };
+
+	render_pass_begin_info.clearValueCount = 2;
+	render_pass_begin_info.pClearValues = clear_values;
+
+	command_buffer.beginRenderPass(&render_pass_begin_info, vk::SubpassContents::eInline);
+
+	vk::Viewport viewport;
+	viewport.x = 0.f;
+	viewport.y = 0.f;
+	viewport.width = float(_env->swapchain_extent.width);
+	viewport.height = float(_env->swapchain_extent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+	command_buffer.setViewport(0, 1, &viewport);
+
+	vk::Rect2D scissor;
+	scissor.offset = vk::Offset2D{ 0, 0 };
+	scissor.extent = _env->swapchain_extent;
+	command_buffer.setScissor(0, 1, &scissor);
+
+	// The draws read the current ranges of the meshes, streaming and eviction need no recording of their own
+	auto vertex_buffer = _geometry->vertex_buffer();
+	vk::DeviceSize offset = 0;
+	command_buffer.bindVertexBuffers(0, 1, &vertex_buffer, &offset);
+	command_buffer.bindIndexBuffer(_geometry->index_buffer(), 0, vk::IndexType::eUint32);
+
+	// The set of each image is allocated and written by the first frame, the next ones find it in the cache
+	descriptor_buffer_binding bindings[] =
+	{
+		{ 0, vk::DescriptorType::eUniformBuffer, _frame_uniform_buffers[image_index], 0, sizeof(frame_uniforms) },
+		{ 1, vk::DescriptorType::eStorageBuffer, _material_buffer, 0, VK_WHOLE_SIZE },
+	};
+	auto descriptor_set = _descriptors->get(_descriptor_set_layout, bindings, size(bindings));
+	command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, _pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+
+	vk::Pipeline bound;
+	for (size_t i = 0; i < size(visible); i++)
+	{
+		auto index = visible[i];
+		auto pipeline = _pipelines[pipelines[pipeline_ids[index]].resource].pipeline;
+		if (pipeline != bound)
+		{
+			command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+			bound = pipeline;
+		}
 
-			render_pass_begin_info.clearValueCount = 2;
-			render_pass_begin_info.pClearValues = clear_values;
+		command_buffer.pushConstants(_pipeline_layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, 0, sizeof(object_push_constants), &constants[i]);
 
-			object_data.command_buffers[i].beginRenderPass(&render_pass_begin_info, vk::SubpassContents::eInline);
+		auto& range = _geometry->range(_meshes[meshes[mesh_ids[index]]->resource].mesh);
+		command_buffer.drawIndexed(range.index_count, 1, range.first_index, range.vertex_offset, 0);
+	}
 
-			object_data.command_buffers[i].bindPipeline(vk::PipelineBindPoint::eGraphics, object_data.pipeline);
+	command_buffer.endRenderPass();
 
-			vk::Buffer buffers[] = { model_data.vertex_buffer, model_data.normal_buffer };
-			vk::DeviceSize offsets[] = { 0, 0 };
+	_gpu_profiler->end_pass(command_buffer, image_index);
 
-			object_data.command_buffers[i].bindVertexBuffers(0, 2, buffers, offsets);
+	if (_env->headless)
+		record_read_back(command_buffer, image_index);
 
-			object_data.command_buffers[i].bindIndexBuffer(model_data.index_buffer, 0, vk::IndexType::eUint32);
+	_gpu_profiler->end_frame(command_buffer, image_index);
 
-			object_data.command_buffers[i].bindDescriptorSets(vk::PipelineBindPoint::eGraphics, object_data.pipeline_layout, 0, 1, &object_data.descriptor_set, 0, nullptr);
+	command_buffer.end();
+}
 
-			object_data.command_buffers[i].drawIndexed(size(obj.model->indices), 1, 0, 0, 0);
+void vulkan_renderer::render(const scene& scene)
+{
+	using clock = chrono::steady_clock;
+	auto acquire_begin = clock::now();
 
-			object_data.command_buffers[i].endRenderPass();
+	uint32_t image_index;
+	{
+		PROFILE_ZONE("acquire");
 
-			object_data.command_buffers[i].end();
+		// A resize may not make the swapchain out of date on every platform, the size of the window is checked too
+		if (!_env->headless && !_swapchain_outdated)
+		{
+			int width, height;
+			glfwGetFramebufferSize(_env->window, &width, &height);
+			_swapchain_outdated = width != _window_width || height != _window_height;
 		}
+		if (_swapchain_outdated && !recreate_swapchain())
+			return;
 
-		obj.user_data = object_data;
-	}
-}
+		// Headless frames use the offscreen images in turn
+		if (_env->headless)
+			image_index = uint32_t(_frame_count % size(_frame_fences));
+		else
+		{
+			// A suboptimal image is still presented, the swapchain is recreated after it
+			auto result = _env->device.acquireNextImageKHR(_env->swapchain, 1000000000ull, _env->image_available_semaphore, vk::Fence(), &image_index);
+			if (result == vk::Result::eErrorOutOfDateKHR)
+			{
+				_swapchain_outdated = true;
+				return;
+			}
+			if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
+				throw runtime_error("Failed to acquire image");
+			_swapchain_outdated = result == vk::Result::eSuboptimalKHR;
+		}
 
+		// The frame command buffer of this image may still be executing
+		if (_env->device.getFenceStatus(_frame_fences[image_index]) != vk::Result::eSuccess)
+			_cpu_stalls++;
+		if (_env->device.waitForFences(1, &_frame_fences[image_index], true, 1000000000ull) != vk::Result::eSuccess)
+			throw runtime_error("Failed to wait for the frame fence");
+		_env->device.resetFences(1, &_frame_fences[image_index]);
 
-void vulkan_renderer::render(const scene& scene)
-{
+		// A fence also covers the frames submitted before its own
+		_completed_frames = max(_completed_frames, _image_frame_counts[image_index]);
+	}
 
-	uint32_t image_index;
-	if (_env->device.acquireNextImageKHR(_env->swapchain, 1000000000ull, _env->image_available_semaphore, vk::Fence(), &image_index) != vk::Result::eSuccess)
-		throw runtime_error("Failed to acquire image");
+	// The previous frame of this image is done, its queries are read without waiting and its transient sets are free
+	_gpu_profiler->collect(image_index);
+	_descriptors->reset(image_index);
 
-	vk::SubmitInfo submit_info;
+	_frame_arena.reset();
 
-	vk::PipelineStageFlags wait_stages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+	{
+		PROFILE_ZONE("cull");
+		_culler.update(scene.objects);
+		_culler.cull(extract_frustum(scene.projection * scene.view));
+	}
+	auto& visible = _culler.visible();
 
-	submit_info.waitSemaphoreCount = 1;
-	submit_info.pWaitSemaphores = &_env->image_available_semaphore;
-	submit_info.pWaitDstStageMask = wait_stages;
-	submit_info.signalSemaphoreCount = 1;
-	submit_info.pSignalSemaphores = &_env->render_finished_semaphore;
+	stream_meshes(scene, visible);
+
+	object_push_constants* constants;
+	{
+		PROFILE_ZONE("uniforms");
+
+		// The fence of the image was waited, its frame uniforms are not read anymore
+		auto& frame = *_frame_uniforms[image_index];
+		frame.view = scene.view;
+		frame.proj = scene.projection;
+		frame.point = scene.point;
+		frame.sun = scene.sun;
+		frame.spot = scene.spot;
+		frame.eye = scene.eye;
+
+		auto& transforms = scene.objects.transforms();
+		auto& material_ids = scene.objects.material_ids();
+		constants = _frame_arena.allocate<object_push_constants>(size(visible));
+		for (size_t i = 0; i < size(visible); i++)
+		{
+			constants[i].model = transforms[visible[i]];
+			constants[i].material = material_ids[visible[i]];
+		}
+	}
 
-	vector<vk::CommandBuffer> command_buffers;
+	auto& command_buffer = _frame_command_buffers[image_index];
+	{
+		PROFILE_ZONE("record");
+		record_frame(command_buffer, image_index, visible, constants, scene);
+	}
+	_descriptors->record_counters();
 
-	for(auto& obj : scene.objects)
 	{
-		object_vulkan_data obj_data = any_cast<object_vulkan_data>(obj.user_data);
-		command_buffers.push_back(obj_data.command_buffers[image_index]);
+		PROFILE_ZONE("submit");
+
+		vk::SubmitInfo submit_info;
+
+		vk::PipelineStageFlags wait_stages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
+
+		// Offscreen images are not acquired nor presented
+		if (!_env->headless)
+		{
+			submit_info.waitSemaphoreCount = 1;
+			submit_info.pWaitSemaphores = &_env->image_available_semaphore;
+			submit_info.pWaitDstStageMask = wait_stages;
+			submit_info.signalSemaphoreCount = 1;
+			submit_info.pSignalSemaphores = &_env->render_finished_semaphore;
+		}
+		submit_info.commandBufferCount = 1;
+		submit_info.pCommandBuffers = &command_buffer;
+
+		if (_env->display_queue.submit(1, &submit_info, _frame_fences[image_index]) != vk::Result::eSuccess)
+			throw runtime_error("Failed to display");
 	}
 
-	submit_info.commandBufferCount = size(command_buffers);
-	submit_info.pCommandBuffers = data(command_buffers);
+	_frame_count++;
+	_image_frame_counts[image_index] = _frame_count;
+	if (_env->headless)
+		return;
 
-	if (_env->display_queue.submit(1, &submit_info, vk::Fence()) != vk::Result::eSuccess)
-		throw runtime_error("Failed to display");
+	PROFILE_ZONE("present");
 
 	vk::PresentInfoKHR present_info;
 	present_info.waitSemaphoreCount = 1;
@@ -369,40 +648,154 @@ void vulkan_renderer::render(const scene& scene)
 	present_info.pSwapchains = &_env->swapchain;
 	present_info.pImageIndices = &image_index;
 
-	if (_env->display_queue.presentKHR(&present_info) != vk::Result::eSuccess)
+	auto result = _env->display_queue.presentKHR(&present_info);
+	if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR)
+		_swapchain_outdated = true;
+	else if (result != vk::Result::eSuccess)
 		throw runtime_error("Failed to present");
+
+	// Measured on the CPU, the 1.0.30 headers have no VK_GOOGLE_display_timing to know when the image reached the display.
+	// The present mode shows in where the time goes: FIFO blocks in the acquire or the present, immediate and mailbox do not
+	auto present_end = clock::now();
+	_present_ms = chrono::duration<double, milli>(present_end - acquire_begin).count();
+	_present_interval_ms = _presents ? chrono::duration<double, milli>(present_end - _last_present).count() : 0.;
+	_last_present = present_end;
+	_presents++;
+	_total_present_ms += _present_ms;
+}
+
+bool vulkan_renderer::recreate_swapchain()
+{
+	PROFILE_ZONE("recreate swapchain");
+
+	// The frames in flight render into the old framebuffers
+	_env->device.waitIdle();
+	glfwGetFramebufferSize(_env->window, &_window_width, &_window_height);
+	if (!_env->recreate_swapchain())
+		return false;
+
+	// The driver may give a different number of images, the resources of each image follow it
+	if (size(_env->framebuffers) != size(_frame_fences))
+	{
+		destroy_image_resources();
+		init_image_resources();
+	}
+
+	_completed_frames = _frame_count;
+	_swapchain_outdated = false;
+	return true;
+}
+
+void vulkan_renderer::record_read_back(vk::CommandBuffer command_buffer, uint32_t image_index)
+{
+	vk::BufferImageCopy region;
+	region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent = vk::Extent3D{ _env->swapchain_extent.width, _env->swapchain_extent.height, 1 };
+
+	// The render pass left the image in the transfer source layout, its external dependency orders the copy after the color writes
+	command_buffer.copyImageToBuffer(_env->swapchain_images[image_index], vk::ImageLayout::eTransferSrcOptimal, _readback_buffers[image_index], 1, &region);
+
+	// Makes the copy visible to the host once the frame fence is signaled
+	vk::BufferMemoryBarrier barrier;
+	barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+	barrier.dstAccessMask = vk::AccessFlagBits::eHostRead;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = _readback_buffers[image_index];
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::DependencyFlags(), 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+bool vulkan_renderer::gpu_stats(gpu_frame_stats& stats)
+{
+	if (!_gpu_profiler->latest(stats))
+		return false;
+	stats.cpu_stalls = _cpu_stalls;
+	stats.present_ms = _present_ms;
+	stats.present_interval_ms = _present_interval_ms;
+	stats.presents = _presents;
+	stats.total_present_ms = _total_present_ms;
+	return true;
+}
+
+bool vulkan_renderer::read_back(frame_pixels& pixels)
+{
+	if (!_env->headless)
+		return false;
+
+	// Frames older than the images were overwritten
+	auto image_count = uint64_t(size(_frame_fences));
+	if (_frame_count > image_count)
+		_read_count = max(_read_count, _frame_count - image_count);
+	if (_read_count == _frame_count)
+		return false;
+
+	auto image_index = uint32_t(_read_count % image_count);
+	auto& fence = _frame_fences[image_index];
+	if (_read_count + image_count == _frame_count)
+	{
+		// The next render waits for this image anyway, waiting here adds no stall and keeps the frame
+		if (_env->device.waitForFences(1, &fence, true, 1000000000ull) != vk::Result::eSuccess)
+			throw runtime_error("Failed to wait for the frame fence");
+	}
+	else if (_env->device.getFenceStatus(fence) != vk::Result::eSuccess)
+		return false;
+
+	pixels.width = _env->swapchain_extent.width;
+	pixels.height = _env->swapchain_extent.height;
+	pixels.bottom_up = false;
+	pixels.frame = _read_count++;
+	pixels.data = _readback_data[image_index];
+	return true;
 }
 
 void vulkan_renderer::cleanup(scene& scene)
 {
+	_streamer.clear();
 	_env->device.waitIdle();
-	for(auto& obj : scene.objects)
+	_geometry->free_retired(_frame_count);
+	for (auto& m : scene.objects.meshes())
 	{
-		if(!obj.model->user_data.empty())
+		if (_meshes.valid(m->resource))
 		{
-			auto model_data = any_cast<model_vulkan_data>(obj.model->user_data);
-
-			_env->device.freeMemory(model_data.vertex_memory);
-			_env->device.freeMemory(model_data.normal_memory);
-			_env->device.freeMemory(model_data.index_memory);
-			_env->device.destroyBuffer(model_data.vertex_buffer);
-			_env->device.destroyBuffer(model_data.normal_buffer);
-			_env->device.destroyBuffer(model_data.index_buffer);
+			_geometry->remove(_meshes[m->resource].mesh);
+			_residency.remove(m->resource);
+			_meshes.remove(m->resource);
 		}
-		obj.model->user_data.clear();
+		m->resource = resource_handle();
+	}
+
+	for (auto& p : scene.objects.pipelines())
+	{
+		auto& pipeline_data = _pipelines[p.resource];
+		_env->device.destroyShaderModule(pipeline_data.vertex_stage.module);
+		_env->device.destroyShaderModule(pipeline_data.fragment_stage.module);
+		_env->device.destroyPipeline(pipeline_data.pipeline);
+		_pipelines.remove(p.resource);
+		p.resource = resource_handle();
+	}
 
-		auto object_data = any_cast<object_vulkan_data>(obj.user_data);
+	if (_material_buffer)
+	{
+		_env->device.destroyBuffer(_material_buffer);
+		_env->device.freeMemory(_material_memory);
+		_material_buffer = vk::Buffer();
+	}
 
-		_env->device.destroyDescriptorSetLayout(object_data.descriptor_set_layout);
-		_env->device.freeMemory(object_data.ubo_memory);
-		_env->device.destroyBuffer(object_data.ubo_buffer);
-		_env->device.freeCommandBuffers(_env->render_command_pool, size(object_data.command_buffers), data(object_data.command_buffers));
-		_env->device.destroyPipelineLayout(object_data.pipeline_layout);
-		_env->device.destroyPipeline(object_data.pipeline);
+	destroy_image_resources();
+	_env->device.destroyPipelineLayout(_pipeline_layout);
+	_env->device.destroyDescriptorSetLayout(_descriptor_set_layout);
 
-		auto vsm = any_cast<vk::PipelineShaderStageCreateInfo>(obj.vertex_shader.user_data);
-		_env->device.destroyShaderModule(vsm.module);
-		auto fsm = any_cast<vk::PipelineShaderStageCreateInfo>(obj.fragment_shader.user_data);
-		_env->device.destroyShaderModule(fsm.module);
+	for (size_t i = 0; i < size(_readback_buffers); i++)
+	{
+		_env->device.unmapMemory(_readback_memories[i]);
+		_env->device.destroyBuffer(_readback_buffers[i]);
+		_env->device.freeMemory(_readback_memories[i]);
 	}
+	_readback_buffers.clear();
+	_readback_memories.clear();
+	_readback_data.clear();
 }
@@ -2,11 +2,38 @@
 
 #include <renderer.h>
 #include <vulkan/vulkan.hpp>
+#include <chrono>
 #include <memory>
+#include <culling.h>
+#include <frame_arena.h>
+#include <mesh_streamer.h>
+#include <residency_manager.h>
+#include <resource_table.h>
+#include <uniforms.h>
 #include "env.h"
+#include "vulkan_descriptor_allocator.h"
+#include "vulkan_geometry_pool.h"
+#include "vulkan_gpu_profiler.h"
 
 namespace vulkan
 {
+	/// Resources of a model
+	struct model_vulkan_data
+	{
+		/// Id of the mesh in the geometry pool
+		uint32_t mesh;
+		/// Bounds of the mesh, drawn as a box while the mesh is not resident
+		aabb box;
+	};
+
+	/// Resources of a pipeline, shared by its objects
+	struct pipeline_vulkan_data
+	{
+		vk::PipelineShaderStageCreateInfo vertex_stage;
+		vk::PipelineShaderStageCreateInfo fragment_stage;
+		vk::Pipeline pipeline;
+	};
+
 	/**
 	 * Renderer for Vulkan
 	 */
@@ -14,24 +41,135 @@ namespace vulkan
 	{
 	public:
 
-		vulkan_renderer(bool debug = false);
+		/// The present mode is used if the surface supports it, FIFO otherwise
+		vulkan_renderer(bool debug = false, vk::PresentModeKHR present_mode = vk::PresentModeKHR::eMailbox);
 
 		virtual ~vulkan_renderer() = default;
 
 		void init(GLFWwindow* window) override;
 
+		void init_headless(uint32_t width, uint32_t height) override;
+
 		void init_scene(scene& scene) override;
 
+		void set_upload_budget(size_t bytes) override { _upload_budget = bytes; }
+
+		size_t pending_uploads() const override { return _streamer.pending(); }
+
+		void set_memory_budget(size_t bytes) override;
+
+		const residency_stats& memory_stats() const override { return _residency.stats(); }
+
 		void render(const scene& scene) override;
 
+		bool read_back(frame_pixels& pixels) override;
+
+		bool gpu_stats(gpu_frame_stats& stats) override;
+
 		void cleanup(scene& scene) override;
 
 	private:
 
+		/// Creates the geometry pool, the layouts and the resources of the environment images
+		void init_frames();
+
+		/// Allocates the command buffer, the fence, the frame uniforms, the descriptor slot and the queries of every environment image
+		void init_image_resources();
+
+		/// Destroys the resources of the images, the device must be idle
+		void destroy_image_resources();
+
+		/// Creates the layouts shared by the pipelines
+		void init_layouts();
+
+		/// Creates a pipeline with the shared layout
+		vk::Pipeline create_pipeline(const pipeline_vulkan_data& pipeline_data);
+
+		/// Requests the visible meshes that are not resident, uploads the prepared ones within the upload budget
+		/// and evicts the least recently drawn ones beyond the memory budget
+		void stream_meshes(const scene& scene, const std::vector<uint32_t>& visible);
+
+		/// Lowers the memory budget to what VK_EXT_memory_budget leaves for the geometry pool, headers older than the extension leave the budget of the application
+		void update_memory_budget();
+
+		/// Records the frame command buffer drawing the visible objects with their push constants
+		void record_frame(vk::CommandBuffer command_buffer, uint32_t image_index, const std::vector<uint32_t>& visible, const object_push_constants* constants, const scene& scene);
+
+		/// Recreates the swapchain for the size of the window once the frames in flight completed, false while it has no area.
+		/// The pipelines do not depend on the size and are kept, the image resources are recreated when the number of images changes
+		bool recreate_swapchain();
+
+		/// Copies an offscreen image to its read back buffer
+		void record_read_back(vk::CommandBuffer command_buffer, uint32_t image_index);
+
 		/// Creates a shader from a source file
 		vk::PipelineShaderStageCreateInfo create_shader(const std::string& source, vk::ShaderStageFlagBits stage);
 
 		bool _debug;
+		vk::PresentModeKHR _present_mode;
 		std::unique_ptr<env> _env;
+		/// Geometry of every model, destroyed before the environment
+		std::unique_ptr<vulkan_geometry_pool> _geometry;
+		/// Queries measuring the frames on the GPU, destroyed before the environment
+		std::unique_ptr<vulkan_gpu_profiler> _gpu_profiler;
+		/// Descriptor sets of the frames, destroyed before the environment
+		std::unique_ptr<vulkan_descriptor_allocator> _descriptors;
+		/// Command buffer recorded each frame for every swapchain image, drawing the visible objects
+		std::vector<vk::CommandBuffer> _frame_command_buffers;
+		/// Signaled when the frame command buffer of a swapchain image has finished executing
+		std::vector<vk::Fence> _frame_fences;
+		/// Layout of the descriptor set of a frame, the frame uniforms and the materials
+		vk::DescriptorSetLayout _descriptor_set_layout;
+		/// Layout shared by every pipeline, the descriptor set of the frame and the push constants of a draw
+		vk::PipelineLayout _pipeline_layout;
+		/// Frame uniforms of every swapchain image, mapped for the whole life of the renderer
+		std::vector<vk::Buffer> _frame_uniform_buffers;
+		std::vector<vk::DeviceMemory> _frame_uniform_memories;
+		std::vector<frame_uniforms*> _frame_uniforms;
+		/// Materials of the scene, indexed by the push constants
+		vk::Buffer _material_buffer;
+		vk::DeviceMemory _material_memory;
+		/// Number of frames submitted
+		uint64_t _frame_count = 0;
+		/// Number of frames submitted when the frame of each swapchain image was submitted, including it
+		std::vector<uint64_t> _image_frame_counts;
+		/// Number of frames that waited for the fence of their image
+		uint64_t _cpu_stalls = 0;
+		/// Acquire to present times of the presented frames, given with the GPU statistics
+		double _present_ms = 0.;
+		double _present_interval_ms = 0.;
+		uint64_t _presents = 0;
+		double _total_present_ms = 0.;
+		std::chrono::steady_clock::time_point _last_present;
+		/// Number of frames the GPU is known to have finished
+		uint64_t _completed_frames = 0;
+		/// Whether the swapchain no longer matches the window and is recreated before the next frame
+		bool _swapchain_outdated = false;
+		/// Size of the window when the swapchain was created, the swapchain may be clamped to another size
+		int _window_width = 0;
+		int _window_height = 0;
+		/// Number of frames read back or skipped
+		uint64_t _read_count = 0;
+		/// Host buffers receiving the offscreen images when headless
+		std::vector<vk::Buffer> _readback_buffers;
+		std::vector<vk::DeviceMemory> _readback_memories;
+		std::vector<const uint8_t*> _readback_data;
+		/// Transient data of the frame being recorded
+		frame_arena _frame_arena;
+		/// Frustum culling of the objects
+		culler _culler;
+		/// Prepares the meshes on worker threads while their bounding boxes are drawn
+		mesh_streamer _streamer;
+		size_t _upload_budget = default_upload_budget;
+		/// Meshes taken from the streamer this frame, kept to reuse its storage
+		std::vector<streamed_mesh> _streamed;
+		/// Decides which meshes are requested and evicted
+		residency_manager _residency;
+		/// Memory budget set by the application, 0 for none
+		size_t _memory_budget = 0;
+		/// Meshes evicted this frame
+		std::vector<resource_handle> _evicted;
+		resource_table<model_vulkan_data> _meshes;
+		resource_table<pipeline_vulkan_data> _pipelines;
 	};
 }